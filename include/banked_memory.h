@@ -0,0 +1,59 @@
+#ifndef _BANKED_MEMORY_H
+#define _BANKED_MEMORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cpu.h"
+#include "ports.h"
+
+/* where bankedMemoryMapPort usually puts the bank select port */
+#define BANK_SELECT_PORT	0x40
+
+/* the address space is remapped in 4k windows */
+#define BANK_WINDOW_SHIFT	12
+#define BANK_WINDOW_SIZE	(1 << BANK_WINDOW_SHIFT)
+#define BANK_WINDOWS		(0x10000 >> BANK_WINDOW_SHIFT)
+
+/* more than 64k of physical memory seen through a page table of window
+ * pointers. bank 0 is the first 64k of storage, every other bank replaces
+ * the banked windows (the rest is common memory) with its own part of
+ * storage:
+ *
+ *	storage:	[64k, bank 0][bank 1]...[bank n - 1]
+ *
+ * a bank switch only rewrites the pointers of the banked windows. writing
+ * the bank to the select port switches, reading it returns the selected
+ * bank. a bank that doesn't exist is ignored.
+ *
+ * cpu->memory points at the bankedMemory itself, the banked callbacks cast
+ * it back. that isn't a flat 64k, so everything else has to reach it
+ * through the cpu's callbacks too */
+struct bankedMemory {
+	uint8_t		*windows[BANK_WINDOWS];
+
+	uint8_t		*storage;
+	size_t		size;
+
+	uint8_t		firstBanked,		/* banked windows */
+			nBanked,
+			nBanks,
+			bank;			/* selected bank */
+
+	struct portDevice	select;
+};
+
+struct bankedMemory *bankedMemoryCreate(uint8_t nBanks, uint8_t firstBanked, uint8_t nBanked);
+void bankedMemoryDestroy(struct bankedMemory *banked);
+bool bankedMemoryMap(struct bankedMemory *banked, uint8_t window, size_t offset);
+bool bankedMemorySelect(struct bankedMemory *banked, uint8_t bank);
+size_t bankedMemoryBankOffset(struct bankedMemory *banked, uint8_t bank);
+void bankedMemoryMapPort(struct bankedMemory *banked, struct portTable *table, uint8_t port);
+
+uint8_t		bankedReadMemory(uint8_t *memory, uint16_t address);
+uint16_t	bankedReadMemoryWord(uint8_t *memory, uint16_t address);
+void		bankedWriteMemory(uint8_t *memory, uint16_t address, uint8_t data);
+void		bankedWriteMemoryWord(uint8_t *memory, uint16_t address, uint16_t data);
+
+#endif /* #ifndef _BANKED_MEMORY_H */
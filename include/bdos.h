@@ -0,0 +1,59 @@
+#ifndef _BDOS_H
+#define _BDOS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <dirent.h>
+
+#include "cpu.h"
+#include "console.h"
+#include "device_thread.h"
+
+#define BDOS_ENTRY		0x0005
+#define BDOS_BASE		0xFE00	/* top of the tpa, what 0x0006 points at */
+#define BDOS_DEFAULT_DMA	0x0080
+#define BDOS_RECORD_SIZE	128
+
+#define BDOS_MAX_FILES		16
+#define BDOS_INPUT_POLL_US	1000
+
+/* a host file opened through a file control block, cp/m programs don't
+ * close files they only read so slots are reused by fcb address */
+struct bdosFile {
+        FILE            *file;
+        uint16_t        fcb;
+};
+
+/* high level emulation of the cp/m 2.2 bdos, calls to BDOS_ENTRY are
+ * handled natively against files in a host directory */
+struct bdos {
+        const char      *directory;
+
+        FILE            *input;
+        struct console  *console;
+        /* reads input off the emulation thread when set, input isn't used
+         * then */
+        struct deviceThread *inputThread;
+
+        uint16_t        dma;
+        uint8_t         drive,
+                        user;
+
+        struct bdosFile files[BDOS_MAX_FILES];
+
+        DIR             *search;
+        uint8_t         searchPattern[11];
+
+        uint64_t        inputRead;      /* console input the guest took */
+};
+
+void bdosInit(struct bdos *bdos, const char *directory, FILE *input, struct console *console);
+void bdosDestroy(struct bdos *bdos);
+void bdosInstall(struct bdos *bdos, struct cpu8080 *cpu);
+void bdosCall(struct bdos *bdos, struct cpu8080 *cpu);
+bool bdosTrap(struct bdos *bdos, struct cpu8080 *cpu);
+void bdosFlush(struct bdos *bdos);
+bool bdosHostState(struct bdos *bdos);
+
+#endif /* #ifndef _BDOS_H */
@@ -0,0 +1,47 @@
+#ifndef _CFG_H
+#define _CFG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "opcodes.h"
+
+#define CFG_ADDRESSES	0x10000
+
+/* what recovery found out about an address, several can be set */
+enum _cfgMarks {
+	cfgLoaded = 1 << 0,		/* part of the image */
+	cfgInstruction = 1 << 1,	/* an instruction starts here */
+	cfgCode = 1 << 2,		/* part of an instruction */
+	cfgLeader = 1 << 3,		/* a basic block starts here */
+	cfgEntry = 1 << 4,		/* given as an entry point */
+	cfgCallTarget = 1 << 5,		/* called or restarted to */
+	cfgIndirect = 1 << 6,		/* leaves by RET or PCHL, the target isn't known */
+	cfgOverlap = 1 << 7,		/* decoded as part of two different instructions */
+};
+
+/* the control flow graph of an image, recovered statically by following
+ * every jump, call and fall through from the entry points. only what's
+ * loaded is followed, so code in ram the image copies or builds itself
+ * stays unknown. a call is assumed to return to the instruction after it.
+ *
+ * blocks are kept implicitly: a block starts at every leader and runs to
+ * the first instruction that isn't sequential or is followed by another
+ * leader */
+struct cfg {
+	uint8_t		marks[CFG_ADDRESSES];
+
+	size_t		nInstructions,
+			nBlocks,
+			nCallTargets,
+			nLoaded,
+			nCode;
+};
+
+void cfgInit(struct cfg *cfg);
+void cfgMarkLoaded(struct cfg *cfg, uint16_t address, size_t length);
+void cfgRecover(struct cfg *cfg, const uint8_t *memory, const uint16_t *entries, size_t nEntries);
+uint16_t cfgBlockEnd(struct cfg *cfg, const uint8_t *memory, uint16_t leader);
+
+#endif /* #ifndef _CFG_H */
@@ -0,0 +1,68 @@
+#ifndef _CONSOLE_H
+#define _CONSOLE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define CONSOLE_INITIAL_CAPACITY	4096
+#define CONSOLE_FLUSH_THRESHOLD		65536
+
+enum _consoleModes {
+	consoleFd,		/* flushed with write(2) in large chunks */
+	consoleCallback,	/* flushed by handing the buffer to the host */
+	consoleCapture,		/* kept in memory until the host takes it */
+};
+
+/* where a guest's console output goes. output is appended to a growable
+ * buffer and only leaves it in large pieces, so printing a character costs
+ * a store and an increment */
+struct console {
+	uint8_t		*buffer;
+	size_t		length,
+			capacity;
+
+	uint8_t		mode;
+
+	int		fd;
+	/* gets a pointer into the buffer, valid only during the call */
+	void		(*sink)(void *, const uint8_t *, size_t);
+	void		*context;
+};
+
+bool consoleInitFd(struct console *console, int fd);
+bool consoleInitCallback(struct console *console,
+		void (*sink)(void *, const uint8_t *, size_t), void *context);
+bool consoleInitStream(struct console *console, FILE *stream);
+bool consoleInitCapture(struct console *console);
+void consoleDestroy(struct console *console);
+
+bool consoleReserve(struct console *console, size_t length);
+void consoleFlush(struct console *console);
+const uint8_t *consoleCaptured(struct console *console, size_t *length);
+void consoleClear(struct console *console);
+
+static inline void consoleWrite(struct console *console, const void *data, size_t length) {
+	if(console->length + length > console->capacity && !consoleReserve(console, length))
+		return;
+
+	memcpy(console->buffer + console->length, data, length);
+	console->length += length;
+
+	if(console->mode != consoleCapture && console->length >= CONSOLE_FLUSH_THRESHOLD)
+		consoleFlush(console);
+}
+
+static inline void consolePutc(struct console *console, uint8_t c) {
+	if(console->length == console->capacity && !consoleReserve(console, 1))
+		return;
+
+	console->buffer[console->length++] = c;
+
+	if(console->mode != consoleCapture && console->length >= CONSOLE_FLUSH_THRESHOLD)
+		consoleFlush(console);
+}
+
+#endif /* #ifndef _CONSOLE_H */
@@ -0,0 +1,61 @@
+#ifndef _COVERAGE_H
+#define _COVERAGE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define COVERAGE_ADDRESSES	0x10000
+#define COVERAGE_EDGES		0x10000
+
+/* guest code coverage, kept by the core when it is built with CPU_COVERAGE
+ * and a struct coverage is attached to the cpu. without CPU_COVERAGE the
+ * hooks below expand to nothing */
+struct coverage {
+	/* one bit per address an instruction was fetched from */
+	uint8_t		executed[COVERAGE_ADDRESSES / 8];
+	/* afl style hit counters indexed by a hash of branch source and
+	 * target, wrapping on overflow */
+	uint8_t		edges[COVERAGE_EDGES];
+
+	uint16_t	current;	/* address of the executing instruction */
+};
+
+struct coverageSymbol {
+	uint16_t	address;
+	char		name[32];
+};
+
+static inline void coverageExecute(struct coverage *coverage, uint16_t address) {
+	coverage->executed[address >> 3] |= 1 << (address & 7);
+	coverage->current = address;
+}
+
+static inline void coverageBranch(struct coverage *coverage, uint16_t target) {
+	coverage->edges[(uint16_t)(coverage->current * 33 ^ target)]++;
+}
+
+static inline bool coverageWasExecuted(struct coverage *coverage, uint16_t address) {
+	return coverage->executed[address >> 3] & (1 << (address & 7));
+}
+
+#ifdef CPU_COVERAGE
+#define COVERAGE_EXECUTE(cpu, address) \
+	do { if((cpu)->coverage != NULL) coverageExecute((cpu)->coverage, (address)); } while(0)
+#define COVERAGE_BRANCH(cpu, target) \
+	do { if((cpu)->coverage != NULL) coverageBranch((cpu)->coverage, (target)); } while(0)
+#else
+#define COVERAGE_EXECUTE(cpu, address)
+#define COVERAGE_BRANCH(cpu, target)
+#endif /* #ifdef CPU_COVERAGE */
+
+void coverageReset(struct coverage *coverage);
+void coverageMerge(struct coverage *destination, const struct coverage *source);
+size_t coverageCountExecuted(const struct coverage *coverage);
+size_t coverageCountEdges(const struct coverage *coverage);
+
+size_t coverageReadSymbols(const char *path, struct coverageSymbol **symbols);
+void coverageWriteLcov(struct coverage *coverage, FILE *stream, const char *sourceName,
+		struct coverageSymbol *symbols, size_t nSymbols);
+
+#endif /* #ifndef _COVERAGE_H */
@@ -27,6 +27,7 @@ enum _flags {
 enum _Signals {
         noSignal,
         exitSignal,
+        breakpointSignal,       /* a debugger stopped the cpu, see debugger.h */
 };
 
 struct cpu8080 {
@@ -36,10 +37,12 @@ struct cpu8080 {
         void            (*writeMemory)(uint8_t *, uint16_t, uint8_t);
         void            (*writeMemoryWord)(uint8_t *, uint16_t, uint16_t);
 
-        void            (*portOut)(struct cpu8080 *, uint8_t);
+        /* port, data. pc points past the instruction when they are called */
+        void            (*portOut)(struct cpu8080 *, uint8_t, uint8_t);
         uint8_t         (*portIn)(struct cpu8080 *, uint8_t);
 
         uint8_t		*memory;
+        struct portTable *ports;        /* for portTableIn/portTableOut */
 
         uint8_t         registers[totalR];
         uint16_t        programCounter,
@@ -48,9 +51,38 @@ struct cpu8080 {
         size_t          cycleCounter;
 
         uint8_t         signalBuffer;
+
+        /* interrupts are requested with cpuInterrupt and taken between
+         * instructions while they are enabled */
+        bool            interruptEnable,
+                        interruptDelay,         /* EI waits one instruction */
+                        interruptPending,
+                        halted;
+        uint8_t         interruptOpcode;        /* the RST a device puts on the bus */
+
+        /* only set while the debugger has to look at every instruction */
+        struct debugger *debugger;
+
+        /* guest routines run by the host instead, NULL when there are none */
+        struct hooks    *hooks;
+
+#ifdef CPU_COVERAGE
+        struct coverage *coverage;      /* NULL when not collecting */
+#endif
+
+#ifdef CPU_HEATMAP
+        struct heatmap  *heatmap;       /* NULL when not collecting */
+#endif
 };
 
 void cpuExecuteInstruction(struct cpu8080 *cpu);
+void cpuTurboStep(struct cpu8080 *cpu);
+void cpuTurboRun(struct cpu8080 *cpu, size_t cycles);
+#ifdef CPU_AOT
+void cpuAotRun(struct cpu8080 *cpu, size_t cycles);
+#endif
+void cpuInterrupt(struct cpu8080 *cpu, uint8_t opcode);
+bool cpuAcceptInterrupt(struct cpu8080 *cpu);
 void printCpuState(struct cpu8080 cpu);
 
 #endif /* #ifndef _CPU_H */
@@ -0,0 +1,11 @@
+#ifndef _CPU_MODEL_H
+#define _CPU_MODEL_H
+
+#include "cpu.h"
+#include "engine.h"
+
+extern const struct cpuEngine modelEngine;
+
+void cpuModelExecuteInstruction(struct cpu8080 *cpu);
+
+#endif /* #ifndef _CPU_MODEL_H */
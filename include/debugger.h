@@ -0,0 +1,146 @@
+#ifndef _DEBUGGER_H
+#define _DEBUGGER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cpu.h"
+
+#define DEBUGGER_MAX_POINTS	64
+#define DEBUGGER_MAX_CONDITIONS	4
+#define DEBUGGER_PAGE_SHIFT	8
+#define DEBUGGER_PAGES		(0x10000 >> DEBUGGER_PAGE_SHIFT)
+
+/* what a point stops on, watchpoints may combine them */
+enum _debugAccesses {
+	debugExecute = 1 << 0,
+	debugRead = 1 << 1,
+	debugWrite = 1 << 2,
+	debugPortIn = 1 << 3,
+	debugPortOut = 1 << 4,
+};
+
+enum _debugAccessKinds {
+	debugKindExecute,
+	debugKindRead,
+	debugKindWrite,
+	debugKindPortIn,
+	debugKindPortOut,
+	debugKinds,
+};
+
+/* left hand side of a condition */
+enum _debugOperands {
+	debugOperandRegister,	/* index is one of _registers */
+	debugOperandPair,	/* index is rB, rD, rH or debugPairSP, debugPairPC */
+	debugOperandFlag,	/* index is one of _flags */
+	debugOperandData,	/* the byte read or written */
+	debugOperandAddress,	/* the address or port accessed */
+};
+
+enum _debugPairs {
+	debugPairSP = totalR,
+	debugPairPC,
+};
+
+enum _debugComparisons {
+	debugEqual,
+	debugNotEqual,
+	debugLess,
+	debugLessEqual,
+	debugGreater,
+	debugGreaterEqual,
+	debugMask,		/* any of the bits set */
+};
+
+/* e.g. "A==0x41", "HL>=0x8000", "Z==1", "data&0x80" */
+struct debugCondition {
+	uint8_t		operand,
+			index,
+			comparison;
+	uint16_t	value;
+};
+
+/* stops when any of the accesses hits first..last (ports use the low byte)
+ * and every condition holds */
+struct debugPoint {
+	bool			used;
+	uint8_t			accesses;
+	uint16_t		first,
+				last;
+
+	struct debugCondition	conditions[DEBUGGER_MAX_CONDITIONS];
+	size_t			nConditions;
+
+	uint64_t		hits;
+};
+
+/* why the cpu stopped */
+struct debugHit {
+	size_t		point;		/* DEBUGGER_MAX_POINTS when single stepping */
+	uint8_t		access;
+	uint16_t	address;
+	uint8_t		data;
+};
+
+/* breakpoints on the program counter and watchpoints on memory and port
+ * accesses. a hit raises breakpointSignal, so every engine's run stops;
+ * breakpoints stop before the instruction, watchpoints after the one that
+ * made the access. debuggerResume goes on from there. the wrappers find
+ * the debugger in the header of the cpu's guestMemory.
+ *
+ * nothing is looked at while nothing is armed. every kind of access keeps
+ * a count of points per page (per port for i/o) and only an access to a
+ * page with points goes on to compare them. memory and port watchpoints
+ * wrap the cpu's callbacks while they are armed, breakpoints and single
+ * stepping set cpu->debugger, which the reference engine checks before
+ * every instruction. the turbo engine never stops on breakpoints, a cpu on
+ * it has to be moved to the reference first (see engineSwitch) */
+struct debugger {
+	struct cpu8080		*cpu;
+
+	struct debugPoint	points[DEBUGGER_MAX_POINTS];
+	uint8_t			pages[debugKinds][DEBUGGER_PAGES];
+	size_t			armed[debugKinds];
+
+	bool			stepping,
+				skip;		/* the next instruction doesn't stop */
+	struct debugHit		hit;
+
+	/* the callbacks that were installed before the debugger wrapped them */
+	uint8_t			(*readMemory)(uint8_t *, uint16_t);
+	uint16_t		(*readMemoryWord)(uint8_t *, uint16_t);
+	void			(*writeMemory)(uint8_t *, uint16_t, uint8_t);
+	void			(*writeMemoryWord)(uint8_t *, uint16_t, uint16_t);
+	void			(*portOut)(struct cpu8080 *, uint8_t, uint8_t);
+	uint8_t			(*portIn)(struct cpu8080 *, uint8_t);
+};
+
+void debuggerAttach(struct debugger *debugger, struct cpu8080 *cpu);
+void debuggerDetach(struct debugger *debugger);
+int debuggerAdd(struct debugger *debugger, uint8_t accesses, uint16_t first, uint16_t last,
+		const struct debugCondition *conditions, size_t nConditions);
+bool debuggerRemove(struct debugger *debugger, size_t point);
+void debuggerStep(struct debugger *debugger, bool stepping);
+void debuggerResume(struct debugger *debugger);
+bool debuggerStopAtExecute(struct debugger *debugger, struct cpu8080 *cpu);
+bool debuggerParseCondition(const char *text, struct debugCondition *condition);
+bool debuggerCommand(struct debugger *debugger, const char *line, FILE *out);
+void debuggerPrompt(struct debugger *debugger, FILE *in, FILE *out);
+
+/* called by the reference engine before every instruction while
+ * cpu->debugger is set, true if the cpu stopped */
+static inline bool debuggerCheckExecute(struct debugger *debugger, struct cpu8080 *cpu) {
+	if(debugger->skip) {
+		debugger->skip = false;
+		return false;
+	}
+
+	if(!debugger->stepping && debugger->pages[debugKindExecute][cpu->programCounter >> DEBUGGER_PAGE_SHIFT] == 0)
+		return false;
+
+	return debuggerStopAtExecute(debugger, cpu);
+}
+
+#endif /* #ifndef _DEBUGGER_H */
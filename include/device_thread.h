@@ -0,0 +1,60 @@
+#ifndef _DEVICE_THREAD_H
+#define _DEVICE_THREAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "spsc.h"
+
+#define DEVICE_THREAD_BUFFER	4096
+
+/* the host side of a device on its own thread. it moves bytes from readFd
+ * into the input queue and from the output queue to writeFd, so the cpu
+ * thread only ever touches the queues and never blocks on the host. either
+ * fd may be -1. the fds stay owned by the caller and are made non-blocking */
+struct deviceThread {
+	struct spscQueue	input,		/* host to guest */
+				output;		/* guest to host */
+
+	int			readFd,
+				writeFd,
+				wakeFd,		/* eventfd, output was queued or stop */
+				epollFd;
+
+	pthread_t		thread;
+	atomic_bool		stop,
+				eof;		/* readFd has no more to give */
+
+	/* thread side, read but not queued yet and popped but not written */
+	uint8_t			stash[DEVICE_THREAD_BUFFER],
+				pending[DEVICE_THREAD_BUFFER];
+	size_t			stashOffset,
+				stashLength,
+				pendingOffset,
+				pendingLength;
+	bool			reading,
+				writing;
+};
+
+bool deviceThreadStart(struct deviceThread *device, int readFd, int writeFd, size_t queueSize);
+void deviceThreadStop(struct deviceThread *device);
+size_t deviceThreadWrite(struct deviceThread *device, const uint8_t *data, size_t length);
+void deviceThreadWake(struct deviceThread *device);
+
+/* cpu side, never block */
+static inline bool deviceThreadRead(struct deviceThread *device, uint8_t *byte) {
+	return spscPopByte(&device->input, byte);
+}
+
+static inline bool deviceThreadReadable(struct deviceThread *device) {
+	return !spscEmpty(&device->input);
+}
+
+static inline bool deviceThreadWritable(struct deviceThread *device) {
+	return !spscFull(&device->output);
+}
+
+#endif /* #ifndef _DEVICE_THREAD_H */
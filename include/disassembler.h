@@ -0,0 +1,43 @@
+#ifndef _DISASSEMBLER_H
+#define _DISASSEMBLER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cpu.h"
+#include "opcodes.h"
+
+/* longest instruction text and its terminator, "LXI SP,0FFFFH" */
+#define DISASSEMBLY_TEXT_SIZE	16
+/* most a listing line takes, address, text and newline */
+#define DISASSEMBLY_LINE_SIZE	(6 + DISASSEMBLY_TEXT_SIZE)
+/* lines in a cache, a power of two */
+#define DISASSEMBLY_CACHE_SIZE	4096
+
+/* a decoded instruction, valid while memory still holds bytes */
+struct disassemblyLine {
+	uint16_t	address;
+	uint8_t		bytes[3],
+			length;
+	bool		valid;
+	char		text[DISASSEMBLY_TEXT_SIZE];
+};
+
+/* direct mapped on the address. a lookup reads the instruction's bytes and
+ * only decodes again when they aren't the ones the line was made from, so
+ * it stays right under self modifying code and bank switches alike */
+struct disassemblyCache {
+	struct disassemblyLine	lines[DISASSEMBLY_CACHE_SIZE];
+	uint64_t		hits,
+				misses;
+};
+
+size_t disassemble(const uint8_t *bytes, char *text);
+size_t disassembleBlock(const uint8_t *bytes, size_t size, uint16_t origin, char *out);
+
+void disassemblyCacheInit(struct disassemblyCache *cache);
+const struct disassemblyLine *disassemblyCacheLookup(struct disassemblyCache *cache, struct cpu8080 *cpu,
+		uint16_t address);
+
+#endif /* #ifndef _DISASSEMBLER_H */
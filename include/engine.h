@@ -0,0 +1,57 @@
+#ifndef _ENGINE_H
+#define _ENGINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "cpu.h"
+
+/* longest a switch requested from another thread waits */
+#define ENGINE_SWITCH_QUANTUM	0x10000
+/* a request is one word, the engine's index plus one below the cycle */
+#define ENGINE_SWITCH_INDEX_BITS	8
+#define ENGINE_SWITCH_MAX_CYCLE		(UINT64_MAX >> ENGINE_SWITCH_INDEX_BITS)
+
+/* an execution engine is anything that can advance a struct cpu8080, every
+ * engine must leave the cpu in exactly the state the reference interpreter
+ * (cpuExecuteInstruction) would */
+struct cpuEngine {
+        const char      *name;
+
+        /* executes exactly one instruction */
+        void            (*step)(struct cpu8080 *);
+
+        /* executes whole instructions until at least the given amount of
+         * cycles has passed or a signal is raised */
+        void            (*run)(struct cpu8080 *, size_t);
+};
+
+extern const struct cpuEngine referenceEngine,
+                              turboEngine;
+
+/* runs a cpu on one engine at a time. every engine keeps all of its state
+ * in the struct cpu8080, so the cpu moves to another one at any instruction
+ * boundary without losing anything. a switch can be requested from any
+ * thread (or a signal handler) and happens once the cpu reaches the given
+ * cycle, e.g. to fast forward a boot on the turbo engine and trace only
+ * what comes after it. engine and cycle of a request are stored as one
+ * word, so the cpu never sees the engine of one request with the cycle of
+ * another */
+struct engineSwitch {
+        const struct cpuEngine  *current;
+
+        _Atomic uint64_t        requested;      /* 0 when there's none */
+
+        size_t                  switches;
+};
+
+const struct cpuEngine *cpuFindEngine(const char *name);
+const struct cpuEngine *cpuEngineAt(size_t index);
+void cpuListEngines(FILE *stream);
+
+void engineSwitchInit(struct engineSwitch *engineSwitch, const struct cpuEngine *engine);
+bool engineSwitchRequest(struct engineSwitch *engineSwitch, const struct cpuEngine *engine, size_t cycle);
+void engineSwitchRun(struct engineSwitch *engineSwitch, struct cpu8080 *cpu, size_t cycles);
+
+#endif /* #ifndef _ENGINE_H */
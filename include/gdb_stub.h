@@ -0,0 +1,72 @@
+#ifndef _GDB_STUB_H
+#define _GDB_STUB_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cpu.h"
+#include "debugger.h"
+#include "engine.h"
+
+/* largest packet either side sends, hex encoded memory included */
+#define GDB_STUB_PACKET_SIZE	4096
+/* cycles run between looks at the socket while the cpu runs */
+#define GDB_STUB_SLICE		100000
+
+/* registers in the order of the first six of gdb's z80 target, each one
+ * 16 bits little endian. the 8080's flags sit where the z80 has them */
+enum _gdbRegisters {
+	gdbRegisterAF,
+	gdbRegisterBC,
+	gdbRegisterDE,
+	gdbRegisterHL,
+	gdbRegisterSP,
+	gdbRegisterPC,
+	gdbRegisters,
+};
+
+enum _gdbStubStates {
+	gdbStubDetached,	/* no connection, the cpu runs */
+	gdbStubStopped,		/* gdb has the cpu */
+	gdbStubRunning,		/* continued by gdb */
+};
+
+/* a gdb remote serial protocol server on a local tcp port for one cpu.
+ * without a connection the cpu runs on the given engine, a connecting gdb
+ * stops it wherever it is. while breakpoints are set it runs on the
+ * reference engine, which checks them, otherwise on the given one.
+ * breakpoints and watchpoints (Z0-Z4) go to the debugger, so all of it
+ * costs nothing once gdb detaches.
+ *
+ * service is called between slices, with the cpu stopped at an instruction
+ * boundary, to run the machine's devices */
+struct gdbStub {
+	struct cpu8080		*cpu;
+	const struct cpuEngine	*engine;
+	struct debugger		debugger;
+
+	void			(*service)(struct cpu8080 *, void *);
+	void			*serviceContext;
+
+	int			listenFd,
+				fd;
+	uint8_t			state;
+
+	/* received bytes not handled yet */
+	char			input[GDB_STUB_PACKET_SIZE];
+	size_t			inputOffset,
+				inputLength;
+
+	char			packet[GDB_STUB_PACKET_SIZE + 1],
+				reply[GDB_STUB_PACKET_SIZE + 1];
+};
+
+bool gdbStubInit(struct gdbStub *stub, struct cpu8080 *cpu, const struct cpuEngine *engine,
+		void (*service)(struct cpu8080 *, void *), void *serviceContext);
+bool gdbStubListen(struct gdbStub *stub, const char *address);
+bool gdbStubWait(struct gdbStub *stub);
+void gdbStubRun(struct gdbStub *stub);
+void gdbStubDestroy(struct gdbStub *stub);
+
+#endif /* #ifndef _GDB_STUB_H */
@@ -0,0 +1,117 @@
+#ifndef _GUEST_MEMORY_H
+#define _GUEST_MEMORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "loader.h"
+#include "heatmap.h"
+
+struct debugger;
+
+#define GUEST_MEMORY_SIZE	0x10000
+/* room reserved in front of the address space for the guestMemory struct,
+ * only the pages that are used get backed */
+#define GUEST_HEADER_SIZE	0x10000
+
+/* write policies are kept per 256 byte page, sharing works on host pages */
+#define GUEST_PAGE_SHIFT	8
+#define GUEST_PAGES		(GUEST_MEMORY_SIZE >> GUEST_PAGE_SHIFT)
+#define GUEST_HOST_PAGE_SIZE	0x1000
+#define GUEST_HOST_PAGES	(GUEST_MEMORY_SIZE / GUEST_HOST_PAGE_SIZE)
+
+enum _guestPagePolicies {
+	guestPageRam,
+	guestPageRom,		/* writes are ignored */
+	guestPageCow,		/* shared, the first write makes the host page private */
+};
+
+enum _guestHostPages {
+	guestHostPageEmpty,	/* all zero, nothing to copy */
+	guestHostPagePrivate,
+	guestHostPageShared,
+};
+
+/* the initial contents of a fleet of instances, loaded once into a memfd.
+ * host pages made only of rom and cow segments are mapped from it by every
+ * instance, the rest is copied */
+struct guestImage {
+	int		fd;
+	const uint8_t	*data;
+
+	uint8_t		policies[GUEST_PAGES],
+			hostPages[GUEST_HOST_PAGES];
+};
+
+/* the 64k address space is a memfd mapped twice back to back, so a word at
+ * 0xFFFF reads its high byte from the mirror of 0x0000 and every 16 bit
+ * access is a single unaligned load or store without masking. the struct
+ * itself lives in the header right below base, which lets the memory
+ * callbacks (which only get base) find it.
+ *
+ * shared pages are mapped read-only, host code has to write guest memory
+ * through the callbacks or guestMemoryPoke. the write callbacks mark the
+ * pages they touch dirty for guestMemoryReset, host code writing to base
+ * directly has to call guestMemoryMarkDirty */
+struct guestMemory {
+	uint8_t			*base;
+	int			fd;
+
+	struct guestImage	*image;
+	uint8_t			policies[GUEST_PAGES];
+	bool			shared[GUEST_HOST_PAGES],
+				dirty[GUEST_PAGES];
+
+	struct debugger		*debugger;	/* the one attached to the cpu */
+
+#ifdef CPU_HEATMAP
+	struct heatmap		*heatmap;	/* NULL when not collecting */
+#endif
+};
+
+struct guestMemory *guestMemoryCreate(void);
+void guestMemoryDestroy(struct guestMemory *memory);
+
+struct guestImage *guestImageCreate(struct loaderManifest *manifest, uint8_t *error);
+void guestImageDestroy(struct guestImage *image);
+bool guestMemoryMapImage(struct guestMemory *memory, struct guestImage *image);
+void guestMemoryReset(struct guestMemory *memory);
+void guestMemoryMarkDirty(struct guestMemory *memory, size_t address, size_t length);
+bool guestMemoryWritable(struct guestMemory *memory, uint16_t address);
+void guestMemoryPoke(struct guestMemory *memory, uint16_t address, uint8_t data);
+void guestMemoryRead(struct guestMemory *memory, uint16_t address, void *destination, size_t length);
+void guestMemoryWrite(struct guestMemory *memory, uint16_t address, const void *source, size_t length);
+
+uint8_t		guestReadMemory(uint8_t *memory, uint16_t address);
+uint16_t	guestReadMemoryWord(uint8_t *memory, uint16_t address);
+void		guestWriteMemory(uint8_t *memory, uint16_t address, uint8_t data);
+void		guestWriteMemoryWord(uint8_t *memory, uint16_t address, uint16_t data);
+
+static inline struct guestMemory *guestMemoryFromBase(uint8_t *base) {
+	return (struct guestMemory *)(base - GUEST_HEADER_SIZE);
+}
+
+/* the guest is little endian, so is nearly every host */
+static inline uint16_t guestLoadWord(const uint8_t *base, uint16_t address) {
+	uint16_t word;
+
+	memcpy(&word, base + address, sizeof(word));
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	word = __builtin_bswap16(word);
+#endif
+
+	return word;
+}
+
+static inline void guestStoreWord(uint8_t *base, uint16_t address, uint16_t word) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	word = __builtin_bswap16(word);
+#endif
+
+	memcpy(base + address, &word, sizeof(word));
+}
+
+#endif /* #ifndef _GUEST_MEMORY_H */
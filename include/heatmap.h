@@ -0,0 +1,53 @@
+#ifndef _HEATMAP_H
+#define _HEATMAP_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define HEATMAP_PAGE_SHIFT	8
+#define HEATMAP_PAGES		(0x10000 >> HEATMAP_PAGE_SHIFT)
+
+/* read, write and execute counters per 256 byte page, kept when the
+ * emulator is built with CPU_HEATMAP and a struct heatmap is attached with
+ * heatmapAttach. reads and writes are counted by the guest memory
+ * callbacks (reads include instruction fetches), executes by the core at
+ * every instruction it starts. without CPU_HEATMAP the hooks below expand
+ * to nothing */
+struct heatmap {
+	uint64_t	reads[HEATMAP_PAGES],
+			writes[HEATMAP_PAGES],
+			executes[HEATMAP_PAGES];
+};
+
+static inline void heatmapRead(struct heatmap *heatmap, uint16_t address) {
+	heatmap->reads[address >> HEATMAP_PAGE_SHIFT]++;
+}
+
+static inline void heatmapWrite(struct heatmap *heatmap, uint16_t address) {
+	heatmap->writes[address >> HEATMAP_PAGE_SHIFT]++;
+}
+
+static inline void heatmapExecute(struct heatmap *heatmap, uint16_t address) {
+	heatmap->executes[address >> HEATMAP_PAGE_SHIFT]++;
+}
+
+#ifdef CPU_HEATMAP
+#define HEATMAP_READ(heatmap, address) \
+	do { if((heatmap) != NULL) heatmapRead((heatmap), (address)); } while(0)
+#define HEATMAP_WRITE(heatmap, address) \
+	do { if((heatmap) != NULL) heatmapWrite((heatmap), (address)); } while(0)
+#define HEATMAP_EXECUTE(heatmap, address) \
+	do { if((heatmap) != NULL) heatmapExecute((heatmap), (address)); } while(0)
+#else
+#define HEATMAP_READ(heatmap, address)
+#define HEATMAP_WRITE(heatmap, address)
+#define HEATMAP_EXECUTE(heatmap, address)
+#endif /* #ifdef CPU_HEATMAP */
+
+struct cpu8080;
+
+void heatmapAttach(struct heatmap *heatmap, struct cpu8080 *cpu);
+void heatmapReset(struct heatmap *heatmap);
+void heatmapDump(struct heatmap *heatmap, FILE *stream, uint64_t cycle);
+
+#endif /* #ifndef _HEATMAP_H */
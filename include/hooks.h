@@ -0,0 +1,83 @@
+#ifndef _HOOKS_H
+#define _HOOKS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cpu.h"
+
+#define HOOKS_MAX		32
+#define HOOK_MAX_LENGTH		64
+#define HOOKS_PAGE_SHIFT	8
+#define HOOKS_PAGES		(0x10000 >> HOOKS_PAGE_SHIFT)
+
+struct hook;
+
+/* a guest routine the host runs instead. it's recognized by the fnv-1a
+ * hash of its first length bytes, with the targets of jumps and calls
+ * taken relative to the routine so a copy of it elsewhere matches too.
+ *
+ * run is called with the cpu on the routine's first instruction. it makes
+ * every memory access the guest code would, in the same order and through
+ * the cpu's callbacks, leaves registers and flags as the guest code would
+ * and charges the cycles of every instruction the guest would have run, up
+ * to and including the RET. cycles, if there is one, works out once what
+ * doesn't depend on the data from the code and is kept in the hook */
+struct hookRoutine {
+	const char	*name;
+	uint16_t	length;
+	uint32_t	signature;
+	void		(*run)(struct cpu8080 *, const struct hook *);
+	size_t		(*cycles)(const uint8_t *);
+};
+
+/* the code a routine was recognized in is kept, a call compares it instead
+ * of hashing again */
+struct hook {
+	const struct hookRoutine	*routine;
+	uint16_t			address;
+	uint8_t				code[HOOK_MAX_LENGTH];
+	size_t				cycles;
+
+	uint64_t			calls,
+					misses;		/* the code didn't match any more */
+};
+
+/* host implementations of guest routines, keyed on the address the routine
+ * starts at. the cpu's engine looks at hooks before it fetches an
+ * instruction and, on a page with hooks on it, runs the routine when the
+ * code at the program counter is still the code that was recognized. a
+ * routine runs as one instruction: interrupts are taken before or after
+ * it, never in the middle.
+ *
+ * only flat guest memories are hooked, the code is compared in place.
+ * nothing is hooked while the debugger looks at the cpu, so stepping and
+ * breakpoints see the guest code. the model engine and translated blocks
+ * of the aot engine run the guest code */
+struct hooks {
+	struct hook	hooks[HOOKS_MAX];
+	size_t		nHooks;
+	uint8_t		pages[HOOKS_PAGES];
+};
+
+/* every routine the host knows, NULL terminated */
+extern const struct hookRoutine *hookLibrary[];
+
+void hooksInit(struct hooks *hooks);
+bool hooksAdd(struct hooks *hooks, const uint8_t *memory, uint16_t address, const struct hookRoutine *routine);
+size_t hooksScan(struct hooks *hooks, const uint8_t *memory, size_t size);
+void hooksPrint(struct hooks *hooks, FILE *stream);
+uint32_t hookSignature(const uint8_t *code, uint16_t address, uint16_t length);
+bool hooksRun(struct hooks *hooks, struct cpu8080 *cpu);
+
+/* called by the engine before every fetch while cpu->hooks is set, true if
+ * a routine ran */
+static inline bool hooksCheck(struct hooks *hooks, struct cpu8080 *cpu) {
+	if(hooks->pages[cpu->programCounter >> HOOKS_PAGE_SHIFT] == 0)
+		return false;
+
+	return hooksRun(hooks, cpu);
+}
+
+#endif /* #ifndef _HOOKS_H */
@@ -0,0 +1,69 @@
+#ifndef _LOADER_H
+#define _LOADER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define LOADER_MAX_SEGMENTS	32
+#define LOADER_MAX_PATH		256
+
+enum _loaderErrors {
+	loaderOk,
+	loaderOpenFailed,
+	loaderMapFailed,
+	loaderOutOfBounds,
+	loaderBadManifest,
+	loaderBadHex,
+	loaderOutOfMemory,
+	loaderNoMemfd,
+	loaderPathTooLong,
+};
+
+enum _segmentKinds {
+	segmentRam,		/* private to every instance */
+	segmentRom,		/* shared, writes are ignored */
+	segmentCow,		/* shared until an instance writes to it */
+};
+
+/* a file mapped read-only. images are cached by path so every instance that
+ * loads the same rom copies out of one shared mapping instead of reading the
+ * file again. the cache isn't thread safe, load before starting threads */
+struct romImage {
+	char		path[LOADER_MAX_PATH];
+	const uint8_t	*data;
+	size_t		size;
+
+	unsigned	references;
+	struct romImage	*next;
+};
+
+/* part of a file placed in the address space. rom and cow segments can be
+ * shared between instances, see guestImageCreate */
+struct loaderSegment {
+	char		path[LOADER_MAX_PATH];
+	size_t		offset,
+			length;		/* 0 means up to the end of the file */
+	uint16_t	address;
+	uint8_t		kind;
+};
+
+struct loaderManifest {
+	struct loaderSegment	segments[LOADER_MAX_SEGMENTS];
+	size_t			nSegments;
+};
+
+const char *loaderErrorString(uint8_t error);
+
+uint8_t loaderMapImage(const char *path, struct romImage **image);
+void loaderReleaseImage(struct romImage *image);
+void loaderFlushCache(void);
+
+uint8_t loaderLoadBinary(const char *path, uint8_t *memory, size_t memorySize, uint16_t address);
+uint8_t loaderLoadHex(const char *path, uint8_t *memory, size_t memorySize);
+uint8_t loaderReadManifest(const char *path, struct loaderManifest *manifest);
+uint8_t loaderLoadSegment(struct loaderSegment *segment, uint8_t *memory, size_t memorySize);
+uint8_t loaderLoadManifest(struct loaderManifest *manifest, uint8_t *memory, size_t memorySize);
+uint8_t loaderLoad(const char *path, uint8_t *memory, size_t memorySize, uint16_t address);
+
+#endif /* #ifndef _LOADER_H */
@@ -0,0 +1,94 @@
+#ifndef _LOCKSTEP_H
+#define _LOCKSTEP_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "cpu.h"
+#include "engine.h"
+
+/* max memory writes a single instruction (or block) may do before the log
+ * overflows, the overflow itself is reported as a divergence */
+#define LOCKSTEP_MAX_WRITES	4096
+#define LOCKSTEP_MAX_PORT_IO	64
+
+enum _lockstepResults {
+	lockstepRunning,
+	lockstepFinished,	/* the reference raised a signal */
+	lockstepDiverged,
+};
+
+struct lockstepWrite {
+	uint16_t	address;
+	uint8_t		data;
+};
+
+/* port handlers may change registers (bdos calls through OUT) or raise
+ * signals, what the reference's handler left behind is replayed into the
+ * candidate at the same OUT if both sides had the same registers going
+ * into it (before). memory the handler writes isn't replayed */
+struct lockstepPortOut {
+	uint8_t		port,
+			data,
+			signal,
+			before[totalR],
+			registers[totalR];
+};
+
+struct lockstepSide {
+	const struct cpuEngine	*engine;
+	struct cpu8080		*cpu;
+
+	/* the callbacks that were installed before the harness wrapped them */
+	void			(*writeMemory)(uint8_t *, uint16_t, uint8_t);
+	void			(*writeMemoryWord)(uint8_t *, uint16_t, uint16_t);
+	void			(*portOut)(struct cpu8080 *, uint8_t, uint8_t);
+	uint8_t			(*portIn)(struct cpu8080 *, uint8_t);
+
+	struct lockstepWrite	writes[LOCKSTEP_MAX_WRITES];
+	size_t			nWrites;
+	struct lockstepPortOut	portOuts[LOCKSTEP_MAX_PORT_IO];
+	size_t			nPortOuts;
+	bool			overflow;
+};
+
+/* sides[0] is the reference, its i/o reaches the host while the i/o of
+ * sides[1] is only recorded (port inputs are replayed from the reference) */
+struct lockstep {
+	struct lockstepSide	sides[2];
+
+	/* 0 compares after every instruction, otherwise after every block of
+	 * at least this many cycles */
+	size_t			blockCycles;
+	/* every n comparisons the whole address space is compared too,
+	 * 0 disables it */
+	size_t			memoryCheckInterval;
+
+	size_t			memorySize;
+	/* status register bits that have to match, engines that are known to
+	 * differ in some flags can still be compared on everything else. in
+	 * single steps the status a PUSH PSW stores is compared the same way
+	 * and the candidate's copy is set to the reference's, so the bits
+	 * don't turn up again in memory */
+	uint8_t			statusMask;
+
+	size_t			comparisons;
+
+	uint8_t			portIns[LOCKSTEP_MAX_PORT_IO];
+	size_t			nPortIns,
+				portInsReplayed;
+
+	/* state of the reference right before the diverging step */
+	struct cpu8080		before;
+	uint8_t			result;
+};
+
+void lockstepInit(struct lockstep *ls,
+		const struct cpuEngine *reference, struct cpu8080 *referenceCpu,
+		const struct cpuEngine *candidate, struct cpu8080 *candidateCpu);
+void lockstepDestroy(struct lockstep *ls);
+uint8_t lockstepStep(struct lockstep *ls);
+uint8_t lockstepRun(struct lockstep *ls, size_t maxSteps);
+void lockstepPrintDivergence(struct lockstep *ls);
+
+#endif /* #ifndef _LOCKSTEP_H */
@@ -0,0 +1,44 @@
+#ifndef _OPCODES_H
+#define _OPCODES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cpu.h"
+
+#define OPCODE_FLAGS_NONE	0
+#define OPCODE_FLAG_CY		(1 << carryF)
+#define OPCODE_FLAGS_SZAP	(1 << signF | 1 << zeroF | 1 << auxCarryF | 1 << parityF)
+#define OPCODE_FLAGS_ALL	(OPCODE_FLAGS_SZAP | OPCODE_FLAG_CY)
+
+/* states a taken conditional call or return takes over cyclesNotTaken */
+#define OPCODE_TAKEN_CYCLES	6
+
+enum _opcodeFlows {
+	opcodeSequential,	/* on to the next instruction */
+	opcodeJump,
+	opcodeJumpIf,
+	opcodeJumpIndirect,	/* PCHL */
+	opcodeCall,
+	opcodeCallIf,
+	opcodeReturn,
+	opcodeReturnIf,
+	opcodeRestart,
+	opcodeHalt,		/* stays at the next instruction until an interrupt */
+};
+
+/* what there is to know about an opcode, from opcodes.def */
+struct opcodeInfo {
+	char		mnemonic[9];	/* padded so it can be copied whole */
+	uint8_t		mnemonicLength,
+			length,
+			cycles,
+			cyclesNotTaken,
+			flags,
+			flow;
+	bool		undocumented;
+};
+
+extern const struct opcodeInfo opcodeTable[256];
+
+#endif /* #ifndef _OPCODES_H */
@@ -0,0 +1,48 @@
+#ifndef _PACER_H
+#define _PACER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#define PACER_NS		1000000000ULL
+/* default time a quantum of cycles stands for */
+#define PACER_QUANTUM_NS	1000000
+/* the end of a wait is spun instead of slept, sleeps overshoot by about
+ * this much */
+#define PACER_SPIN_NS		50000
+/* a cpu behind by more than this after a stall doesn't try to catch up
+ * further, it's dropped */
+#define PACER_MAX_LAG_NS	20000000
+/* highest clock rate taken, far beyond what any host keeps up with */
+#define PACER_MAX_RATE		1e12
+
+/* ties cycleCounter to wall time at a clock rate. the cpu runs a quantum
+ * of cycles flat out, pacerWait then sleeps until the wall clock reaches
+ * the time those cycles stand for, which keeps the error within a quantum
+ * without spinning a core. the deadline is derived from the first cycle
+ * every time so rounding doesn't drift, after a stall the cpu runs ahead
+ * to catch up but never by more than maxLag */
+struct pacer {
+	uint64_t	hz,
+			quantum,	/* cycles per quantum */
+			spin,		/* ns */
+			maxLag;		/* ns */
+
+	struct timespec	start;		/* wall time of startCycle */
+	uint64_t	startCycle;
+
+	/* statistics */
+	uint64_t	waits,
+			late,		/* quanta that ended after their deadline */
+			dropped,	/* ns given up after stalls */
+			maxLateness;	/* ns */
+};
+
+void pacerInit(struct pacer *pacer, uint64_t hz, uint64_t quantumNs, uint64_t cycle);
+void pacerWait(struct pacer *pacer, uint64_t cycle);
+void pacerRebase(struct pacer *pacer, uint64_t cycle);
+uint64_t pacerParseRate(const char *text);
+
+#endif /* #ifndef _PACER_H */
@@ -0,0 +1,36 @@
+#ifndef _POOL_H
+#define _POOL_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "cpu.h"
+#include "guest_memory.h"
+
+/* instances start on their own cache lines */
+#define POOL_ALIGNMENT		64
+
+/* pre-built instances for short-lived jobs. an instance is any struct that
+ * starts with a struct cpu8080, the pool hands it out zeroed with a fresh
+ * address space (the image if the pool has one) and the guest memory
+ * callbacks set. everything is allocated up front, acquire and release
+ * don't allocate. the pool isn't thread safe */
+struct instancePool {
+	uint8_t			*arena;
+	size_t			instanceSize,
+				capacity;
+
+	struct guestMemory	**memories;
+	struct guestImage	*image;
+
+	size_t			*free,		/* stack of free instance indices */
+				nFree;
+};
+
+bool instancePoolInit(struct instancePool *pool, size_t capacity, size_t instanceSize,
+		struct guestImage *image);
+void instancePoolDestroy(struct instancePool *pool);
+void *instancePoolAcquire(struct instancePool *pool);
+void instancePoolRelease(struct instancePool *pool, void *instance);
+
+#endif /* #ifndef _POOL_H */
@@ -0,0 +1,64 @@
+#ifndef _PORTS_H
+#define _PORTS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cpu.h"
+
+#define PORTS			256
+#define PORT_BATCH_SIZE		4096
+/* oldest a batch gets before it's delivered, 10ms at 2MHz */
+#define PORT_BATCH_CYCLES	20000
+
+/* something on the i/o bus. the handlers get the port they were reached
+ * through, so one device can sit on several ports. either handler may be
+ * NULL, reads then return 0xFF (an open bus) and writes are dropped.
+ *
+ * a device with outBatch gets its writes in batches instead of through out:
+ * consecutive writes to the same port are collected and handed over when
+ * the port table sees an access to any other port or a read, when the
+ * batch is full or PORT_BATCH_CYCLES old, or on portTableFlush. a batch
+ * that got old without another write is only seen by portTableAge, run
+ * loops call it between slices (serialPoll does). that keeps
+ * the order against every other port, but the device sees the writes late,
+ * so it's only for devices whose output doesn't feed back into the cpu */
+struct portDevice {
+	const char	*name;
+
+	uint8_t		(*in)(struct portDevice *, struct cpu8080 *, uint8_t port);
+	void		(*out)(struct portDevice *, struct cpu8080 *, uint8_t port, uint8_t data);
+	void		(*outBatch)(struct portDevice *, struct cpu8080 *, uint8_t port,
+				const uint8_t *data, size_t length);
+
+	void		*context;
+};
+
+/* every port points at a device, unmapped ports at the default one, so a
+ * lookup is a single index. a cpu uses a table by pointing cpu->ports at it
+ * and setting portTableIn and portTableOut as its port callbacks.
+ *
+ * there's at most one open batch, any access to another port closes it */
+struct portTable {
+	struct portDevice	*devices[PORTS];
+	struct portDevice	*unmapped;
+
+	struct portDevice	*batchDevice;	/* NULL when no batch is open */
+	struct cpu8080		*batchCpu;
+	uint8_t			batchPort;
+	size_t			batchStart,	/* cycle of the first write */
+				batchLength;
+	uint8_t			batch[PORT_BATCH_SIZE];
+};
+
+void portTableInit(struct portTable *table, struct portDevice *unmapped);
+void portTableMap(struct portTable *table, uint8_t port, struct portDevice *device);
+void portTableMapRange(struct portTable *table, uint8_t first, unsigned count, struct portDevice *device);
+void portTableUnmap(struct portTable *table, uint8_t port);
+void portTableFlush(struct portTable *table);
+void portTableAge(struct portTable *table, size_t cycle);
+
+uint8_t portTableIn(struct cpu8080 *cpu, uint8_t port);
+void portTableOut(struct cpu8080 *cpu, uint8_t port, uint8_t data);
+
+#endif /* #ifndef _PORTS_H */
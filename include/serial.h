@@ -0,0 +1,70 @@
+#ifndef _SERIAL_H
+#define _SERIAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cpu.h"
+#include "ports.h"
+#include "device_thread.h"
+
+/* the ports of the first channel of an altair 88-2sio */
+#define SERIAL_STATUS_PORT	0x10
+#define SERIAL_DATA_PORT	0x11
+/* RST 7 */
+#define SERIAL_VECTOR		0xFF
+#define SERIAL_QUEUE_SIZE	4096
+
+/* status port, as on a 6850 acia */
+enum _serialStatus {
+	serialRxReady = 1 << 0,
+	serialTxEmpty = 1 << 1,
+	serialInterruptRequest = 1 << 7,
+};
+
+/* bit 7 of a write to the status port enables the receive interrupt, the
+ * other control bits (clock divider, word format) mean nothing here */
+#define SERIAL_CONTROL_RX_INTERRUPT	(1 << 7)
+#define SERIAL_CONTROL_RESET		0x03
+
+/* a 6850 like serial port. the host side is a pair of queues served by
+ * another thread, so reading the status port is a look at a queue and the
+ * cpu never waits on the host. serialOpenPty puts a device thread and a
+ * pseudo-terminal behind them, serialInit takes the queues of any other
+ * host side.
+ *
+ * output is batched through the port table, wake is called when the host
+ * side went to sleep on the output queue with spscSleep. input raises an
+ * interrupt with vector when the guest enabled it, serialPoll has to be
+ * called between slices of the cpu loop for that */
+struct serialDevice {
+	struct portDevice	status,
+				data;
+
+	struct spscQueue	*input,		/* the cpu is its consumer */
+				*output;	/* and this one's producer */
+	void			(*wake)(void *);
+	void			*wakeContext;
+
+	/* only used by serialOpenPty */
+	struct deviceThread	thread;
+	int			master,
+				slave;		/* held open, the master reads EIO without it */
+	char			name[64];	/* of the slave */
+
+	uint8_t			control,
+				received,	/* what the data port reads when the queue is empty */
+				vector;
+	uint64_t		dropped,	/* output lost to a full queue */
+				transfers,	/* bytes through the data port */
+				emptyPolls;	/* status reads with nothing to do */
+};
+
+void serialInit(struct serialDevice *serial, struct spscQueue *input, struct spscQueue *output,
+		void (*wake)(void *), void *wakeContext, uint8_t vector);
+bool serialOpenPty(struct serialDevice *serial, uint8_t vector);
+void serialClose(struct serialDevice *serial);
+void serialMap(struct serialDevice *serial, struct portTable *table, uint8_t statusPort, uint8_t dataPort);
+void serialPoll(struct serialDevice *serial, struct cpu8080 *cpu);
+
+#endif /* #ifndef _SERIAL_H */
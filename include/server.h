@@ -0,0 +1,103 @@
+#ifndef _SERVER_H
+#define _SERVER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "cpu.h"
+#include "engine.h"
+#include "guest_memory.h"
+#include "pool.h"
+#include "ports.h"
+#include "serial.h"
+#include "spsc.h"
+
+/* cycles a session runs before it goes back to the run queue, 10ms at 2MHz */
+#define SERVER_SLICE		20000
+#define SERVER_QUEUE_SIZE	1024
+#define SERVER_MAX_WORKERS	64
+/* a slice that only polled the empty receiver this often is idle */
+#define SERVER_IDLE_POLLS	256
+
+enum _sessionStates {
+	sessionIdle,		/* waits for input, on no queue */
+	sessionQueued,
+	sessionRunning,
+};
+
+/* a connection and the machine behind it: a cpu with a serial port on the
+ * 88-2sio ports. the cpu comes first so it can be handed out by the pool.
+ *
+ * the i/o thread is the producer of input and the consumer of output, the
+ * worker running the session the other side of both */
+struct serverSession {
+	struct cpu8080		cpu;
+	struct portTable	ports;
+	struct serialDevice	serial;
+	struct spscQueue	input,
+				output;
+
+	struct server		*server;
+	int			fd;
+
+	atomic_int		state;
+	atomic_bool		closed,		/* the connection is gone */
+				inputStalled;	/* the input queue filled up */
+	atomic_size_t		arrivals;	/* times input was queued */
+
+	/* i/o thread side, popped but not written yet */
+	uint8_t			pending[SERVER_QUEUE_SIZE];
+	size_t			pendingOffset,
+				pendingLength;
+
+	struct serverSession	*next,		/* on the run queue */
+				*previousLive,
+				*nextLive;
+};
+
+/* runs one session per connection on a local tcp or unix socket. one
+ * thread moves bytes between the sockets and the sessions' queues with
+ * epoll, a pool of workers runs the sessions that have something to do a
+ * slice at a time. a session whose cpu is halted with no interrupt to come,
+ * or that only polls an empty receiver, isn't scheduled again before input
+ * arrives, so idle sessions cost nothing but their memory.
+ *
+ * every session starts from the same image, rom and cow pages are shared */
+struct server {
+	const struct cpuEngine	*engine;
+	uint16_t		entry;
+
+	struct guestImage	*image;
+	struct instancePool	pool;		/* under lock */
+	struct serverSession	*live;		/* under lock */
+
+	int			listenFd,
+				wakeFd,
+				epollFd;
+	bool			unixSocket;
+	char			path[108];
+
+	pthread_t		ioThread,
+				workers[SERVER_MAX_WORKERS];
+	size_t			nWorkers;
+
+	pthread_mutex_t		lock;
+	pthread_cond_t		runnable;
+	struct serverSession	*runHead,	/* under lock */
+				*runTail;
+	atomic_bool		stop;
+
+	atomic_size_t		sessions;
+};
+
+bool serverInit(struct server *server, const char *rom, uint16_t entry, size_t maxSessions,
+		const struct cpuEngine *engine, uint8_t *error);
+bool serverListen(struct server *server, const char *address);
+bool serverStart(struct server *server, size_t nWorkers);
+void serverStop(struct server *server);
+void serverDestroy(struct server *server);
+
+#endif /* #ifndef _SERVER_H */
@@ -0,0 +1,132 @@
+#ifndef _SPSC_H
+#define _SPSC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#define SPSC_CACHE_LINE		64
+
+/* lock-free byte queue between exactly one producer and one consumer
+ * thread. head only moves in the consumer, tail only in the producer, each
+ * on its own cache line. both sides keep a private copy of the other
+ * side's index and only reload it when the queue looks full or empty.
+ *
+ * a consumer that waits for more raises sleeping with spscSleep, a
+ * producer finds out with spscWakeNeeded after its push whether it has to
+ * wake it. each side stores, fences and then loads what the other stored,
+ * so at least one of them sees the other and no wakeup is lost */
+struct spscQueue {
+	_Alignas(SPSC_CACHE_LINE) atomic_size_t	head;
+	size_t					cachedTail;	/* consumer's */
+
+	_Alignas(SPSC_CACHE_LINE) atomic_size_t	tail;
+	size_t					cachedHead;	/* producer's */
+
+	_Alignas(SPSC_CACHE_LINE) uint8_t	*buffer;
+	size_t					mask;
+
+	_Alignas(SPSC_CACHE_LINE) atomic_bool	sleeping;	/* the consumer waits for a wake */
+};
+
+bool spscInit(struct spscQueue *queue, size_t capacity);
+void spscDestroy(struct spscQueue *queue);
+size_t spscPush(struct spscQueue *queue, const uint8_t *data, size_t length);
+size_t spscPop(struct spscQueue *queue, uint8_t *data, size_t length);
+
+/* producer side */
+static inline bool spscPushByte(struct spscQueue *queue, uint8_t byte) {
+	size_t tail;
+
+	tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+
+	if(tail - queue->cachedHead > queue->mask) {
+		queue->cachedHead = atomic_load_explicit(&queue->head, memory_order_acquire);
+
+		if(tail - queue->cachedHead > queue->mask)
+			return false;
+	}
+
+	queue->buffer[tail & queue->mask] = byte;
+	atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+
+	return true;
+}
+
+/* consumer side, never blocks */
+static inline bool spscPopByte(struct spscQueue *queue, uint8_t *byte) {
+	size_t head;
+
+	head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+
+	if(head == queue->cachedTail) {
+		queue->cachedTail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+
+		if(head == queue->cachedTail)
+			return false;
+	}
+
+	*byte = queue->buffer[head & queue->mask];
+	atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+
+	return true;
+}
+
+/* consumer side */
+static inline bool spscEmpty(struct spscQueue *queue) {
+	size_t head;
+
+	head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+
+	if(head != queue->cachedTail)
+		return false;
+
+	queue->cachedTail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+
+	return head == queue->cachedTail;
+}
+
+/* consumer side, found the queue empty and is about to wait. false if
+ * something was pushed meanwhile, the consumer pops it instead of waiting */
+static inline bool spscSleep(struct spscQueue *queue) {
+	atomic_store_explicit(&queue->sleeping, true, memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+
+	return spscEmpty(queue);
+}
+
+/* producer side, after a push. true once per spscSleep, the consumer has
+ * to be woken then */
+static inline bool spscWakeNeeded(struct spscQueue *queue) {
+	atomic_thread_fence(memory_order_seq_cst);
+
+	return atomic_load_explicit(&queue->sleeping, memory_order_relaxed)
+		&& atomic_exchange_explicit(&queue->sleeping, false, memory_order_relaxed);
+}
+
+/* producer side, how much can be pushed */
+static inline size_t spscSpace(struct spscQueue *queue) {
+	size_t tail;
+
+	tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+	queue->cachedHead = atomic_load_explicit(&queue->head, memory_order_acquire);
+
+	return queue->mask + 1 - (tail - queue->cachedHead);
+}
+
+/* producer side */
+static inline bool spscFull(struct spscQueue *queue) {
+	size_t tail;
+
+	tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+
+	if(tail - queue->cachedHead <= queue->mask)
+		return false;
+
+	queue->cachedHead = atomic_load_explicit(&queue->head, memory_order_acquire);
+
+	return tail - queue->cachedHead > queue->mask;
+}
+
+#endif /* #ifndef _SPSC_H */
@@ -0,0 +1,81 @@
+#ifndef _STATELOG_H
+#define _STATELOG_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cpu.h"
+#include "engine.h"
+#include "bdos.h"
+
+#define STATELOG_MEMORY_SIZE	0x10000
+
+/* one entry of a state log, written at the first instruction boundary at or
+ * after every interval cycles */
+struct stateLogRecord {
+	uint64_t	cycle;
+	/* rolling hash over this and every earlier record, so once two logs
+	 * differ they differ for good and can be binary searched */
+	uint64_t	rollingHash;
+	uint64_t	cpuHash,
+			memoryHash;
+};
+
+/* full machine state, checkpoints are written every checkpointInterval
+ * records into their own file. of the bdos only what it keeps itself is
+ * saved, a checkpoint taken while the guest had host state (see
+ * bdosHostState) is marked and can't be restarted from */
+struct stateCheckpoint {
+	uint64_t	cycle;
+	uint8_t		registers[totalR];
+	uint16_t	programCounter,
+			stackPointer;
+	bool		interruptEnable,
+			interruptDelay,
+			interruptPending,
+			halted;
+	uint8_t		interruptOpcode;
+
+	uint16_t	dma;
+	uint8_t		drive,
+			user;
+	bool		hostState;
+
+	uint8_t		memory[STATELOG_MEMORY_SIZE];
+};
+
+struct stateLog {
+	FILE		*log,
+			*checkpoints;
+
+	size_t		interval,
+			checkpointInterval;
+
+	size_t		nextCycle,
+			records;
+
+	uint64_t	rollingHash;
+
+	struct bdos	*bdos;		/* saved into checkpoints, NULL without one */
+};
+
+uint64_t cpuStateHash(struct cpu8080 *cpu);
+uint64_t memoryHash(const uint8_t *memory, size_t size);
+
+bool stateLogOpen(struct stateLog *log, const char *path, const char *checkpointPath,
+		size_t interval, size_t checkpointInterval);
+void stateLogClose(struct stateLog *log);
+void stateLogUpdate(struct stateLog *log, struct cpu8080 *cpu);
+void stateLogRun(struct stateLog *log, const struct cpuEngine *engine, struct cpu8080 *cpu);
+
+size_t stateLogRead(const char *path, struct stateLogRecord **records);
+size_t stateLogFirstDifference(struct stateLogRecord *a, size_t nA,
+		struct stateLogRecord *b, size_t nB);
+
+bool stateCheckpointFind(const char *path, uint64_t cycle, struct stateCheckpoint *checkpoint);
+void stateCheckpointSave(struct stateCheckpoint *checkpoint, struct cpu8080 *cpu, struct bdos *bdos);
+void stateCheckpointRestore(struct stateCheckpoint *checkpoint, struct cpu8080 *cpu, struct bdos *bdos);
+
+#endif /* #ifndef _STATELOG_H */
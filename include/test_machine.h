@@ -0,0 +1,29 @@
+#ifndef _TEST_MACHINE_H
+#define _TEST_MACHINE_H
+
+#include "cpu.h"
+#include "bdos.h"
+#include "console.h"
+#include "guest_memory.h"
+#include "ports.h"
+
+/* size of the address space a test machine runs in */
+#define TEST_MEMORY_SIZE	GUEST_MEMORY_SIZE
+
+/* a cp/m like machine that runs one of the cpu tests. the cpu comes first so
+ * it can be handed out by an instance pool */
+struct testMachine {
+	struct cpu8080		cpu;
+	struct bdos		bdos;
+
+	struct portTable	ports;
+	struct portDevice	exitDevice,
+				bdosDevice;
+};
+
+uint8_t testMachineInit(struct testMachine *machine, struct guestMemory *memory, const char *testPath,
+		struct console *console);
+bool testMachineTrap(struct testMachine *machine);
+void testMachineFinish(struct testMachine *machine);
+
+#endif /* #ifndef _TEST_MACHINE_H */
@@ -1,16 +1,14 @@
 workspace "i8080-emulator"
-        configurations { "Debug", "DebugNoTest", "Release" }
+        configurations { "Debug", "DebugNoTest", "Release", "Coverage", "Heatmap" }
 
         kind "ConsoleApp"
         language "C"
 
 	includedirs { "include/" }
+	links { "pthread" }
 
-project "i8080-emulator"
         targetdir "bin/%{cfg.buildcfg}"
 
-        files { "include/*.h", "src/*.c" }
-
         filter "configurations:Debug"
                 defines { "DEBUG", "_CPU_TEST" }
 		buildoptions { "-g" }
@@ -24,3 +22,53 @@ project "i8080-emulator"
 	filter "configurations:Release"
 		defines { "_CPU_TEST" }
 		optimize "Speed"
+
+	filter "configurations:Coverage"
+		defines { "_CPU_TEST", "CPU_COVERAGE" }
+		optimize "Speed"
+
+	filter "configurations:Heatmap"
+		defines { "_CPU_TEST", "CPU_HEATMAP" }
+		optimize "Speed"
+
+	filter {}
+
+project "i8080-emulator"
+        files { "include/*.h", "src/*.c" }
+
+-- tools link the emulator core but bring their own main()
+project "i8080-lockstep"
+        files { "include/*.h", "src/*.c", "tools/lockstep.c" }
+        removefiles { "src/main_test.c" }
+
+project "i8080-bisect"
+        files { "include/*.h", "src/*.c", "tools/bisect.c" }
+        removefiles { "src/main_test.c" }
+
+project "i8080-fuzz"
+        files { "include/*.h", "src/*.c", "tools/fuzz.c" }
+        removefiles { "src/main_test.c" }
+
+project "i8080-terminal"
+        files { "include/*.h", "src/*.c", "tools/terminal.c" }
+        removefiles { "src/main_test.c" }
+
+project "i8080-server"
+        files { "include/*.h", "src/*.c", "tools/server.c" }
+        removefiles { "src/main_test.c" }
+
+project "i8080-gdbserver"
+        files { "include/*.h", "src/*.c", "tools/gdbserver.c" }
+        removefiles { "src/main_test.c" }
+
+project "i8080-disasm"
+        files { "include/*.h", "src/*.c", "tools/disasm.c" }
+        removefiles { "src/main_test.c" }
+
+project "i8080-aot"
+        files { "include/*.h", "src/*.c", "tools/aot.c" }
+        removefiles { "src/main_test.c" }
+
+project "i8080-banks"
+        files { "include/*.h", "src/*.c", "tools/banks.c" }
+        removefiles { "src/main_test.c" }
@@ -0,0 +1,151 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "banked_memory.h"
+
+#define BANK_OFFSET(address)	((address) & (BANK_WINDOW_SIZE - 1))
+
+static uint8_t bankedSelectIn(struct portDevice *device, struct cpu8080 *cpu, uint8_t port) {
+	struct bankedMemory *banked;
+
+	banked = device->context;
+
+	return banked->bank;
+}
+
+static void bankedSelectOut(struct portDevice *device, struct cpu8080 *cpu, uint8_t port, uint8_t data) {
+	bankedMemorySelect(device->context, data);
+}
+
+/* all of storage is zeroed, bank 0 is selected */
+struct bankedMemory *bankedMemoryCreate(uint8_t nBanks, uint8_t firstBanked, uint8_t nBanked) {
+	struct bankedMemory *banked;
+	size_t i;
+
+	if(nBanks == 0 || firstBanked + nBanked > BANK_WINDOWS)
+		return NULL;
+
+	banked = calloc(1, sizeof(*banked));
+
+	if(banked == NULL)
+		return NULL;
+
+	banked->size = 0x10000 + (size_t)(nBanks - 1) * nBanked * BANK_WINDOW_SIZE;
+	banked->storage = calloc(banked->size, 1);
+
+	if(banked->storage == NULL) {
+		free(banked);
+		return NULL;
+	}
+
+	banked->firstBanked = firstBanked;
+	banked->nBanked = nBanked;
+	banked->nBanks = nBanks;
+	banked->bank = 0;
+
+	for(i = 0; i < BANK_WINDOWS; i++)
+		banked->windows[i] = banked->storage + i * BANK_WINDOW_SIZE;
+
+	banked->select = (struct portDevice){ .name = "bank select", .in = bankedSelectIn,
+		.out = bankedSelectOut, .context = banked };
+
+	return banked;
+}
+
+void bankedMemoryDestroy(struct bankedMemory *banked) {
+	free(banked->storage);
+	free(banked);
+}
+
+/* where a bank's first banked window lives in storage */
+size_t bankedMemoryBankOffset(struct bankedMemory *banked, uint8_t bank) {
+	if(bank == 0)
+		return (size_t)banked->firstBanked * BANK_WINDOW_SIZE;
+
+	return 0x10000 + (size_t)(bank - 1) * banked->nBanked * BANK_WINDOW_SIZE;
+}
+
+void bankedMemoryMapPort(struct bankedMemory *banked, struct portTable *table, uint8_t port) {
+	portTableMap(table, port, &banked->select);
+}
+
+/* points a window at a window sized part of storage */
+bool bankedMemoryMap(struct bankedMemory *banked, uint8_t window, size_t offset) {
+	if(window >= BANK_WINDOWS || offset > banked->size - BANK_WINDOW_SIZE
+			|| BANK_OFFSET(offset) != 0)
+		return false;
+
+	banked->windows[window] = banked->storage + offset;
+
+	return true;
+}
+
+/* what a write to the bank select port does */
+bool bankedMemorySelect(struct bankedMemory *banked, uint8_t bank) {
+	size_t offset;
+	uint8_t i;
+
+	if(bank >= banked->nBanks)
+		return false;
+
+	if(bank == banked->bank)
+		return true;
+
+	offset = bankedMemoryBankOffset(banked, bank);
+
+	for(i = 0; i < banked->nBanked; i++)
+		bankedMemoryMap(banked, banked->firstBanked + i, offset + (size_t)i * BANK_WINDOW_SIZE);
+
+	banked->bank = bank;
+
+	return true;
+}
+
+uint8_t bankedReadMemory(uint8_t *memory, uint16_t address) {
+	struct bankedMemory *banked;
+
+	banked = (struct bankedMemory *)memory;
+
+	return banked->windows[address >> BANK_WINDOW_SHIFT][BANK_OFFSET(address)];
+}
+
+/* a word at the end of a window can continue in an unrelated one */
+uint16_t bankedReadMemoryWord(uint8_t *memory, uint16_t address) {
+	struct bankedMemory *banked;
+	const uint8_t *data;
+
+	banked = (struct bankedMemory *)memory;
+
+	if(BANK_OFFSET(address) == BANK_WINDOW_SIZE - 1)
+		return bankedReadMemory(memory, address + 1) << 8 | bankedReadMemory(memory, address);
+
+	data = banked->windows[address >> BANK_WINDOW_SHIFT] + BANK_OFFSET(address);
+
+	return data[1] << 8 | data[0];
+}
+
+void bankedWriteMemory(uint8_t *memory, uint16_t address, uint8_t data) {
+	struct bankedMemory *banked;
+
+	banked = (struct bankedMemory *)memory;
+
+	banked->windows[address >> BANK_WINDOW_SHIFT][BANK_OFFSET(address)] = data;
+}
+
+void bankedWriteMemoryWord(uint8_t *memory, uint16_t address, uint16_t data) {
+	struct bankedMemory *banked;
+	uint8_t *destination;
+
+	banked = (struct bankedMemory *)memory;
+
+	if(BANK_OFFSET(address) == BANK_WINDOW_SIZE - 1) {
+		bankedWriteMemory(memory, address, data & 0xFF);
+		bankedWriteMemory(memory, address + 1, data >> 8);
+		return;
+	}
+
+	destination = banked->windows[address >> BANK_WINDOW_SHIFT] + BANK_OFFSET(address);
+
+	destination[0] = data & 0xFF;
+	destination[1] = data >> 8;
+}
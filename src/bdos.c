@@ -0,0 +1,776 @@
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <poll.h>
+
+#include "bdos.h"
+#include "guest_memory.h"
+
+/* fcb layout */
+#define FCB_DRIVE	0
+#define FCB_NAME	1
+#define FCB_EXTENT	12
+#define FCB_S2		14
+#define FCB_RECORDS	15
+#define FCB_RENAME	16
+#define FCB_CURRENT	32
+#define FCB_RANDOM	33
+#define FCB_SIZE	36
+
+#define BDOS_EOF	0x1A
+
+/* what cp/m doesn't allow in a file name besides control characters and
+ * spaces, with the host's path separators */
+#define BDOS_NAME_RESERVED	"<>.,;:=?*[]/\\"
+
+enum _bdosFunctions {
+	bdosReset		= 0,
+	bdosConsoleInput	= 1,
+	bdosConsoleOutput	= 2,
+	bdosDirectIO		= 6,
+	bdosPrintString		= 9,
+	bdosReadBuffer		= 10,
+	bdosConsoleStatus	= 11,
+	bdosVersion		= 12,
+	bdosResetDisks		= 13,
+	bdosSelectDisk		= 14,
+	bdosOpen		= 15,
+	bdosClose		= 16,
+	bdosSearchFirst		= 17,
+	bdosSearchNext		= 18,
+	bdosDelete		= 19,
+	bdosReadSequential	= 20,
+	bdosWriteSequential	= 21,
+	bdosMake		= 22,
+	bdosRename		= 23,
+	bdosLoginVector		= 24,
+	bdosCurrentDisk		= 25,
+	bdosSetDMA		= 26,
+	bdosUserCode		= 32,
+	bdosReadRandom		= 33,
+	bdosWriteRandom		= 34,
+	bdosFileSize		= 35,
+	bdosSetRandom		= 36,
+};
+
+void bdosInit(struct bdos *bdos, const char *directory, FILE *input, struct console *console) {
+	bdos->directory = directory;
+	bdos->input = input;
+	bdos->console = console;
+	bdos->inputThread = NULL;
+
+	bdos->dma = BDOS_DEFAULT_DMA;
+	bdos->drive = 0;
+	bdos->user = 0;
+
+	memset(bdos->files, 0, sizeof(bdos->files));
+
+	bdos->search = NULL;
+	bdos->inputRead = 0;
+}
+
+void bdosDestroy(struct bdos *bdos) {
+	size_t i;
+
+	bdosFlush(bdos);
+
+	for(i = 0; i < BDOS_MAX_FILES; i++) {
+		if(bdos->files[i].file != NULL)
+			fclose(bdos->files[i].file);
+
+		bdos->files[i].file = NULL;
+	}
+
+	if(bdos->search != NULL)
+		closedir(bdos->search);
+
+	bdos->search = NULL;
+}
+
+/* 0x0005 jumps to a stub at BDOS_BASE so programs find the top of the tpa at
+ * 0x0006, the stub does OUT 1; RET for engines that don't trap. the cpu's
+ * memory callbacks have to be set */
+void bdosInstall(struct bdos *bdos, struct cpu8080 *cpu) {
+	cpu->writeMemory(cpu->memory, BDOS_ENTRY, 0xC3);
+	cpu->writeMemoryWord(cpu->memory, BDOS_ENTRY + 1, BDOS_BASE);
+
+	cpu->writeMemory(cpu->memory, BDOS_BASE, 0xD3);
+	cpu->writeMemory(cpu->memory, BDOS_BASE + 1, 0x01);
+	cpu->writeMemory(cpu->memory, BDOS_BASE + 2, 0xC9);
+}
+
+void bdosFlush(struct bdos *bdos) {
+	consoleFlush(bdos->console);
+}
+
+/* whether the guest got anything from the host that isn't in guest memory
+ * or the bdos struct and can't be saved: open files, a directory search
+ * or console input */
+bool bdosHostState(struct bdos *bdos) {
+	size_t i;
+
+	for(i = 0; i < BDOS_MAX_FILES; i++) {
+		if(bdos->files[i].file != NULL)
+			return true;
+	}
+
+	return bdos->search != NULL || bdos->inputRead != 0;
+}
+
+/* copies between the host and guest memory. flat guest memory is copied in
+ * bulk, anything else (a wrapped or banked memory) goes through the cpu's
+ * callbacks. either way rom stays read-only and written pages are marked
+ * dirty. wraps at 64k */
+static void bdosCopyFromGuest(struct cpu8080 *cpu, void *destination, uint16_t address, size_t length) {
+	uint8_t *bytes;
+	size_t i;
+
+	if(cpu->readMemory == guestReadMemory) {
+		guestMemoryRead(guestMemoryFromBase(cpu->memory), address, destination, length);
+		return;
+	}
+
+	bytes = destination;
+
+	for(i = 0; i < length; i++)
+		bytes[i] = cpu->readMemory(cpu->memory, address + i);
+}
+
+static void bdosCopyToGuest(struct cpu8080 *cpu, uint16_t address, const void *source, size_t length) {
+	const uint8_t *bytes;
+	size_t i;
+
+	if(cpu->writeMemory == guestWriteMemory) {
+		guestMemoryWrite(guestMemoryFromBase(cpu->memory), address, source, length);
+		return;
+	}
+
+	bytes = source;
+
+	for(i = 0; i < length; i++)
+		cpu->writeMemory(cpu->memory, address + i, bytes[i]);
+}
+
+/* console input the guest waits for. with an input thread the wait is on
+ * its queue, console input is typed so polling it now and then is enough */
+static int bdosGetc(struct bdos *bdos) {
+	uint8_t byte;
+
+	bdosFlush(bdos);
+
+	if(bdos->inputThread == NULL) {
+		bdos->inputRead++;
+		return fgetc(bdos->input);
+	}
+
+	while(!deviceThreadRead(bdos->inputThread, &byte)) {
+		if(atomic_load(&bdos->inputThread->eof) && !deviceThreadReadable(bdos->inputThread))
+			return EOF;
+
+		usleep(BDOS_INPUT_POLL_US);
+	}
+
+	bdos->inputRead++;
+
+	return byte;
+}
+
+static bool bdosInputReady(struct bdos *bdos) {
+	struct pollfd pfd;
+
+	if(bdos->inputThread != NULL)
+		return deviceThreadReadable(bdos->inputThread);
+
+	pfd.fd = fileno(bdos->input);
+	pfd.events = POLLIN;
+
+	return poll(&pfd, 1, 0) > 0;
+}
+
+/* writes the string at address up to the '$', straight out of flat guest
+ * memory or a chunk at a time */
+static void bdosPrintStringAt(struct bdos *bdos, struct cpu8080 *cpu, uint16_t address) {
+	uint8_t chunk[BDOS_RECORD_SIZE];
+	const uint8_t *end;
+	size_t length, total;
+
+	if(cpu->readMemory == guestReadMemory) {
+		/* the mirror holds the part past the wrap */
+		end = memchr(cpu->memory + address, '$', 0x10000);
+		length = end != NULL ? (size_t)(end - (cpu->memory + address)) : 0x10000;
+
+		consoleWrite(bdos->console, cpu->memory + address, length);
+		return;
+	}
+
+	for(total = 0, length = 0; total < 0x10000; total++, address++) {
+		chunk[length] = cpu->readMemory(cpu->memory, address);
+
+		if(chunk[length] == '$')
+			break;
+
+		if(++length == sizeof(chunk)) {
+			consoleWrite(bdos->console, chunk, length);
+			length = 0;
+		}
+	}
+
+	consoleWrite(bdos->console, chunk, length);
+}
+
+static void bdosReadConsoleBuffer(struct bdos *bdos, struct cpu8080 *cpu, uint16_t address) {
+	uint8_t line[256], maximum;
+	size_t length;
+	int c;
+
+	maximum = cpu->readMemory(cpu->memory, address);
+
+	for(length = 0; length < maximum; ) {
+		c = bdosGetc(bdos);
+
+		if(c == EOF || c == '\n' || c == '\r')
+			break;
+
+		line[length++] = c;
+	}
+
+	cpu->writeMemory(cpu->memory, address + 1, length);
+	bdosCopyToGuest(cpu, address + 2, line, length);
+}
+
+static bool bdosNameCharacter(uint8_t c) {
+	return c > ' ' && c < 0x7F && strchr(BDOS_NAME_RESERVED, c) == NULL;
+}
+
+/* "NAME    TYP" from an fcb into "NAME.TYP", attribute bits are dropped.
+ * false if it isn't a cp/m file name, a name never leaves the directory */
+static bool bdosFcbToName(const uint8_t *fcb, char *name) {
+	size_t i, n;
+
+	for(i = 0, n = 0; i < 8 && (fcb[FCB_NAME + i] & 0x7F) != ' '; i++) {
+		if(!bdosNameCharacter(fcb[FCB_NAME + i] & 0x7F))
+			return false;
+
+		name[n++] = fcb[FCB_NAME + i] & 0x7F;
+	}
+
+	if(n == 0)
+		return false;
+
+	if((fcb[FCB_NAME + 8] & 0x7F) != ' ')
+		name[n++] = '.';
+
+	for(i = 8; i < 11 && (fcb[FCB_NAME + i] & 0x7F) != ' '; i++) {
+		if(!bdosNameCharacter(fcb[FCB_NAME + i] & 0x7F))
+			return false;
+
+		name[n++] = fcb[FCB_NAME + i] & 0x7F;
+	}
+
+	name[n] = '\0';
+
+	return true;
+}
+
+/* a host file name as an 11 character 8.3 name, false if it isn't one */
+static bool bdosNameToFcb(const char *name, uint8_t *fcbName) {
+	const char *dot;
+	size_t length, i;
+
+	dot = strchr(name, '.');
+	length = dot != NULL ? (size_t)(dot - name) : strlen(name);
+
+	if(length == 0 || length > 8 || (dot != NULL && (strlen(dot + 1) > 3 || strchr(dot + 1, '.'))))
+		return false;
+
+	memset(fcbName, ' ', 11);
+
+	for(i = 0; i < length; i++)
+		fcbName[i] = toupper((unsigned char)name[i]);
+
+	for(i = 0; dot != NULL && dot[1 + i] != '\0'; i++)
+		fcbName[8 + i] = toupper((unsigned char)dot[1 + i]);
+
+	return true;
+}
+
+static bool bdosMatch(const uint8_t *pattern, const uint8_t *name) {
+	size_t i;
+
+	for(i = 0; i < 11; i++) {
+		if(pattern[i] != '?' && (pattern[i] & 0x7F) != name[i])
+			return false;
+	}
+
+	return true;
+}
+
+/* host path of the file an fcb names, matched case insensitively against
+ * the directory so both "FOO.COM" and "foo.com" are found. if there is no
+ * such file the upper case name is used. false if the fcb doesn't hold a
+ * file name */
+static bool bdosHostPath(struct bdos *bdos, const uint8_t *fcb, char *path, size_t size) {
+	uint8_t wanted[11], found[11];
+	char name[13];
+	struct dirent *entry;
+	DIR *directory;
+	size_t i;
+
+	if(!bdosFcbToName(fcb, name))
+		return false;
+
+	memcpy(wanted, fcb + FCB_NAME, 11);
+
+	for(i = 0; i < 11; i++)
+		wanted[i] &= 0x7F;
+
+	directory = opendir(bdos->directory);
+
+	while(directory != NULL && (entry = readdir(directory)) != NULL) {
+		if(bdosNameToFcb(entry->d_name, found) && memcmp(found, wanted, 11) == 0) {
+			snprintf(path, size, "%s/%s", bdos->directory, entry->d_name);
+			closedir(directory);
+			return true;
+		}
+	}
+
+	if(directory != NULL)
+		closedir(directory);
+
+	snprintf(path, size, "%s/%s", bdos->directory, name);
+
+	return true;
+}
+
+static struct bdosFile *bdosFindFile(struct bdos *bdos, uint16_t fcb) {
+	size_t i;
+
+	for(i = 0; i < BDOS_MAX_FILES; i++) {
+		if(bdos->files[i].file != NULL && bdos->files[i].fcb == fcb)
+			return &bdos->files[i];
+	}
+
+	return NULL;
+}
+
+static struct bdosFile *bdosNewFile(struct bdos *bdos, uint16_t fcb) {
+	struct bdosFile *file;
+	size_t i;
+
+	file = bdosFindFile(bdos, fcb);
+
+	if(file != NULL) {
+		fclose(file->file);
+		file->file = NULL;
+		return file;
+	}
+
+	for(i = 0; i < BDOS_MAX_FILES; i++) {
+		if(bdos->files[i].file == NULL)
+			return &bdos->files[i];
+	}
+
+	/* out of slots, the first one goes */
+	fclose(bdos->files[0].file);
+	bdos->files[0].file = NULL;
+
+	return &bdos->files[0];
+}
+
+static uint32_t bdosFileRecords(FILE *file) {
+	long position, size;
+
+	position = ftell(file);
+	fseek(file, 0, SEEK_END);
+	size = ftell(file);
+	fseek(file, position, SEEK_SET);
+
+	return (size + BDOS_RECORD_SIZE - 1) / BDOS_RECORD_SIZE;
+}
+
+/* the sequential record of an fcb is (s2 * 32 + extent) * 128 + current */
+static uint32_t bdosSequentialRecord(const uint8_t *fcb) {
+	return ((uint32_t)(fcb[FCB_S2] & 0x3F) * 32 + (fcb[FCB_EXTENT] & 0x1F)) * 128 + fcb[FCB_CURRENT];
+}
+
+static void bdosSetSequentialRecord(uint8_t *fcb, uint32_t record, uint32_t fileRecords) {
+	uint32_t extentStart;
+
+	fcb[FCB_CURRENT] = record % 128;
+	fcb[FCB_EXTENT] = record / 128 % 32;
+	fcb[FCB_S2] = record / 128 / 32;
+
+	extentStart = record - record % 128;
+	fcb[FCB_RECORDS] = fileRecords > extentStart ?
+		(fileRecords - extentStart > 128 ? 128 : fileRecords - extentStart) : 0;
+}
+
+static uint32_t bdosRandomRecord(const uint8_t *fcb) {
+	return fcb[FCB_RANDOM] | fcb[FCB_RANDOM + 1] << 8 | (fcb[FCB_RANDOM + 2] & 0x03) << 16;
+}
+
+static uint8_t bdosOpenFile(struct bdos *bdos, struct cpu8080 *cpu, uint16_t address, const char *mode) {
+	uint8_t fcb[FCB_SIZE];
+	struct bdosFile *file;
+	char path[FILENAME_MAX];
+
+	bdosCopyFromGuest(cpu, fcb, address, FCB_SIZE);
+
+	if(!bdosHostPath(bdos, fcb, path, sizeof(path)))
+		return 0xFF;
+
+	file = bdosNewFile(bdos, address);
+	file->file = fopen(path, mode);
+
+	if(file->file == NULL)
+		return 0xFF;
+
+	file->fcb = address;
+
+	fcb[FCB_S2] = 0;
+	fcb[FCB_EXTENT] = 0;
+	bdosSetSequentialRecord(fcb, 0, bdosFileRecords(file->file));
+	bdosCopyToGuest(cpu, address, fcb, FCB_SIZE);
+
+	return 0;
+}
+
+/* reads or writes the record of an fcb through the dma buffer */
+static uint8_t bdosTransfer(struct bdos *bdos, struct cpu8080 *cpu, uint16_t address,
+		bool write, bool random) {
+	uint8_t fcb[FCB_SIZE], record[BDOS_RECORD_SIZE];
+	struct bdosFile *file;
+	uint32_t number;
+	size_t length;
+
+	bdosCopyFromGuest(cpu, fcb, address, FCB_SIZE);
+
+	file = bdosFindFile(bdos, address);
+
+	/* programs may move an fcb around, reopen it on demand */
+	if(file == NULL) {
+		if(bdosOpenFile(bdos, cpu, address, "r+b") != 0)
+			return random ? 6 : 1;
+
+		file = bdosFindFile(bdos, address);
+	}
+
+	number = random ? bdosRandomRecord(fcb) : bdosSequentialRecord(fcb);
+
+	if(fseek(file->file, (long)number * BDOS_RECORD_SIZE, SEEK_SET) != 0)
+		return random ? 6 : 1;
+
+	if(write) {
+		bdosCopyFromGuest(cpu, record, bdos->dma, BDOS_RECORD_SIZE);
+
+		if(fwrite(record, 1, BDOS_RECORD_SIZE, file->file) != BDOS_RECORD_SIZE)
+			return 2;
+
+		fflush(file->file);
+	}
+	else {
+		length = fread(record, 1, BDOS_RECORD_SIZE, file->file);
+
+		if(length == 0)
+			return 1;
+
+		memset(record + length, BDOS_EOF, BDOS_RECORD_SIZE - length);
+		bdosCopyToGuest(cpu, bdos->dma, record, BDOS_RECORD_SIZE);
+	}
+
+	/* random access leaves the sequential position on the record, a
+	 * sequential access moves past it */
+	bdosSetSequentialRecord(fcb, random ? number : number + 1, bdosFileRecords(file->file));
+	bdosCopyToGuest(cpu, address, fcb, FCB_SIZE);
+
+	return 0;
+}
+
+/* fills the dma buffer with the next directory entry matching the pattern */
+static uint8_t bdosSearch(struct bdos *bdos, struct cpu8080 *cpu) {
+	uint8_t entry[32], name[11];
+	struct dirent *hostEntry;
+	char path[FILENAME_MAX];
+	FILE *file;
+
+	while(bdos->search != NULL && (hostEntry = readdir(bdos->search)) != NULL) {
+		if(!bdosNameToFcb(hostEntry->d_name, name) || !bdosMatch(bdos->searchPattern, name))
+			continue;
+
+		memset(entry, 0, sizeof(entry));
+		entry[0] = bdos->user;
+		memcpy(entry + 1, name, 11);
+
+		snprintf(path, sizeof(path), "%s/%s", bdos->directory, hostEntry->d_name);
+		file = fopen(path, "rb");
+
+		if(file != NULL) {
+			entry[FCB_RECORDS] = bdosFileRecords(file) > 128 ? 128 : bdosFileRecords(file);
+			fclose(file);
+		}
+
+		bdosCopyToGuest(cpu, bdos->dma, entry, sizeof(entry));
+
+		return 0;
+	}
+
+	return 0xFF;
+}
+
+static uint8_t bdosSearchStart(struct bdos *bdos, struct cpu8080 *cpu, uint16_t address) {
+	if(bdos->search != NULL)
+		closedir(bdos->search);
+
+	bdos->search = opendir(bdos->directory);
+	bdosCopyFromGuest(cpu, bdos->searchPattern, address + FCB_NAME, 11);
+
+	return bdosSearch(bdos, cpu);
+}
+
+static uint8_t bdosDeleteFiles(struct bdos *bdos, struct cpu8080 *cpu, uint16_t address) {
+	uint8_t pattern[11], name[11], result;
+	struct dirent *entry;
+	char path[FILENAME_MAX];
+	DIR *directory;
+
+	bdosCopyFromGuest(cpu, pattern, address + FCB_NAME, 11);
+
+	directory = opendir(bdos->directory);
+	result = 0xFF;
+
+	while(directory != NULL && (entry = readdir(directory)) != NULL) {
+		if(bdosNameToFcb(entry->d_name, name) && bdosMatch(pattern, name)) {
+			snprintf(path, sizeof(path), "%s/%s", bdos->directory, entry->d_name);
+
+			if(remove(path) == 0)
+				result = 0;
+		}
+	}
+
+	if(directory != NULL)
+		closedir(directory);
+
+	return result;
+}
+
+static uint8_t bdosRenameFile(struct bdos *bdos, struct cpu8080 *cpu, uint16_t address) {
+	uint8_t fcb[FCB_SIZE];
+	char from[FILENAME_MAX], to[FILENAME_MAX];
+
+	bdosCopyFromGuest(cpu, fcb, address, FCB_SIZE);
+
+	if(!bdosHostPath(bdos, fcb, from, sizeof(from)) || !bdosHostPath(bdos, fcb + FCB_RENAME, to, sizeof(to)))
+		return 0xFF;
+
+	return rename(from, to) == 0 ? 0 : 0xFF;
+}
+
+static void bdosComputeFileSize(struct bdos *bdos, struct cpu8080 *cpu, uint16_t address) {
+	uint8_t fcb[FCB_SIZE];
+	char path[FILENAME_MAX];
+	uint32_t records;
+	FILE *file;
+
+	bdosCopyFromGuest(cpu, fcb, address, FCB_SIZE);
+
+	file = bdosHostPath(bdos, fcb, path, sizeof(path)) ? fopen(path, "rb") : NULL;
+	records = 0;
+
+	if(file != NULL) {
+		records = bdosFileRecords(file);
+		fclose(file);
+	}
+
+	fcb[FCB_RANDOM] = records & 0xFF;
+	fcb[FCB_RANDOM + 1] = records >> 8 & 0xFF;
+	fcb[FCB_RANDOM + 2] = records >> 16 & 0x03;
+
+	bdosCopyToGuest(cpu, address, fcb, FCB_SIZE);
+}
+
+static void bdosSetRandomRecord(struct cpu8080 *cpu, uint16_t address) {
+	uint8_t fcb[FCB_SIZE];
+	uint32_t record;
+
+	bdosCopyFromGuest(cpu, fcb, address, FCB_SIZE);
+
+	record = bdosSequentialRecord(fcb);
+
+	fcb[FCB_RANDOM] = record & 0xFF;
+	fcb[FCB_RANDOM + 1] = record >> 8 & 0xFF;
+	fcb[FCB_RANDOM + 2] = record >> 16 & 0x03;
+
+	bdosCopyToGuest(cpu, address, fcb, FCB_SIZE);
+}
+
+/* performs the bdos function in C with the parameter in E or DE, results are
+ * returned in A and L (and B and H for word results) */
+void bdosCall(struct bdos *bdos, struct cpu8080 *cpu) {
+	struct bdosFile *file;
+	uint16_t de, result;
+	uint8_t e;
+	int input;
+
+	e = cpu->registers[rE];
+	de = cpu->registers[rD] << 8 | e;
+	result = 0;
+
+	switch(cpu->registers[rC]) {
+		case bdosReset:
+			bdosFlush(bdos);
+			cpu->signalBuffer = exitSignal;
+			break;
+
+		case bdosConsoleInput:
+			input = bdosGetc(bdos);
+			result = input == EOF ? BDOS_EOF : input;
+
+			consolePutc(bdos->console, result);
+			break;
+
+		case bdosConsoleOutput:
+			consolePutc(bdos->console, e);
+			break;
+
+		case bdosDirectIO:
+			if(e == 0xFF) {
+				bdosFlush(bdos);
+
+				if(bdosInputReady(bdos)) {
+					input = bdosGetc(bdos);
+					result = input == EOF ? 0 : input;
+				}
+			}
+			else
+				consolePutc(bdos->console, e);
+			break;
+
+		case bdosPrintString:
+			bdosPrintStringAt(bdos, cpu, de);
+			break;
+
+		case bdosReadBuffer:
+			bdosReadConsoleBuffer(bdos, cpu, de);
+			break;
+
+		case bdosConsoleStatus:
+			bdosFlush(bdos);
+			result = bdosInputReady(bdos) ? 0xFF : 0;
+			break;
+
+		case bdosVersion:
+			result = 0x0022;
+			break;
+
+		case bdosResetDisks:
+			bdos->dma = BDOS_DEFAULT_DMA;
+			bdos->drive = 0;
+			break;
+
+		case bdosSelectDisk:
+			bdos->drive = e;
+			break;
+
+		case bdosOpen:
+			result = bdosOpenFile(bdos, cpu, de, "r+b");
+
+			if(result != 0)
+				result = bdosOpenFile(bdos, cpu, de, "rb");
+			break;
+
+		case bdosClose:
+			file = bdosFindFile(bdos, de);
+
+			if(file != NULL) {
+				fclose(file->file);
+				file->file = NULL;
+			}
+			break;
+
+		case bdosSearchFirst:
+			result = bdosSearchStart(bdos, cpu, de);
+			break;
+
+		case bdosSearchNext:
+			result = bdosSearch(bdos, cpu);
+			break;
+
+		case bdosDelete:
+			result = bdosDeleteFiles(bdos, cpu, de);
+			break;
+
+		case bdosReadSequential:
+			result = bdosTransfer(bdos, cpu, de, false, false);
+			break;
+
+		case bdosWriteSequential:
+			result = bdosTransfer(bdos, cpu, de, true, false);
+			break;
+
+		case bdosMake:
+			result = bdosOpenFile(bdos, cpu, de, "w+b");
+			break;
+
+		case bdosRename:
+			result = bdosRenameFile(bdos, cpu, de);
+			break;
+
+		case bdosLoginVector:
+			result = 1 << bdos->drive;
+			break;
+
+		case bdosCurrentDisk:
+			result = bdos->drive;
+			break;
+
+		case bdosSetDMA:
+			bdos->dma = de;
+			break;
+
+		case bdosUserCode:
+			if(e == 0xFF)
+				result = bdos->user;
+			else
+				bdos->user = e & 0x0F;
+			break;
+
+		case bdosReadRandom:
+			result = bdosTransfer(bdos, cpu, de, false, true);
+			break;
+
+		case bdosWriteRandom:
+			result = bdosTransfer(bdos, cpu, de, true, true);
+			break;
+
+		case bdosFileSize:
+			bdosComputeFileSize(bdos, cpu, de);
+			break;
+
+		case bdosSetRandom:
+			bdosSetRandomRecord(cpu, de);
+			break;
+
+		/* unsupported functions fail */
+		default:
+			result = 0xFF;
+			break;
+	}
+
+	cpu->registers[rA] = cpu->registers[rL] = result & 0xFF;
+	cpu->registers[rB] = cpu->registers[rH] = result >> 8;
+}
+
+/* has to be called before every instruction, returns true if the cpu was at
+ * the bdos entry and the call was handled (including its return) */
+bool bdosTrap(struct bdos *bdos, struct cpu8080 *cpu) {
+	if(cpu->programCounter != BDOS_ENTRY)
+		return false;
+
+	bdosCall(bdos, cpu);
+
+	cpu->programCounter = cpu->readMemoryWord(cpu->memory, cpu->stackPointer);
+	cpu->stackPointer += 2;
+	cpu->cycleCounter += 10;
+
+	return true;
+}
@@ -0,0 +1,160 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "cfg.h"
+
+void cfgInit(struct cfg *cfg) {
+	memset(cfg, 0, sizeof(*cfg));
+}
+
+void cfgMarkLoaded(struct cfg *cfg, uint16_t address, size_t length) {
+	size_t i;
+
+	for(i = 0; i < length && i < CFG_ADDRESSES; i++)
+		cfg->marks[(uint16_t)(address + i)] |= cfgLoaded;
+}
+
+/* every byte of the instruction at address is part of the image */
+static bool cfgFits(struct cfg *cfg, const uint8_t *memory, uint16_t address) {
+	uint8_t i, length;
+
+	if(!(cfg->marks[address] & cfgLoaded))
+		return false;
+
+	length = opcodeTable[memory[address]].length;
+
+	for(i = 1; i < length; i++) {
+		if(!(cfg->marks[(uint16_t)(address + i)] & cfgLoaded))
+			return false;
+	}
+
+	return true;
+}
+
+static void cfgPush(struct cfg *cfg, uint16_t *work, size_t *nWork, uint16_t address, uint8_t marks) {
+	if(!(cfg->marks[address] & cfgLoaded))
+		return;
+
+	cfg->marks[address] |= cfgLeader | marks;
+
+	if(!(cfg->marks[address] & cfgInstruction))
+		work[(*nWork)++] = address;
+}
+
+/* follows the code from one leader until it leaves or runs into code that's
+ * known already, queueing every other way it can go */
+static void cfgFollow(struct cfg *cfg, const uint8_t *memory, uint16_t address, uint16_t *work, size_t *nWork) {
+	const struct opcodeInfo *info;
+	uint16_t next, target;
+	uint8_t i;
+
+	while(!(cfg->marks[address] & cfgInstruction) && cfgFits(cfg, memory, address)) {
+		info = &opcodeTable[memory[address]];
+		next = address + info->length;
+		target = memory[(uint16_t)(address + 1)] | memory[(uint16_t)(address + 2)] << 8;
+
+		if(cfg->marks[address] & cfgCode)
+			cfg->marks[address] |= cfgOverlap;
+
+		cfg->marks[address] |= cfgInstruction;
+
+		for(i = 0; i < info->length; i++) {
+			if(i != 0 && cfg->marks[(uint16_t)(address + i)] & (cfgCode | cfgInstruction))
+				cfg->marks[(uint16_t)(address + i)] |= cfgOverlap;
+
+			cfg->marks[(uint16_t)(address + i)] |= cfgCode;
+		}
+
+		switch(info->flow) {
+			case opcodeSequential:
+				address = next;
+				continue;
+
+			case opcodeJump:
+				cfgPush(cfg, work, nWork, target, 0);
+				return;
+
+			case opcodeJumpIf:
+				cfgPush(cfg, work, nWork, target, 0);
+				cfgPush(cfg, work, nWork, next, 0);
+				return;
+
+			case opcodeCall:
+			case opcodeCallIf:
+				cfgPush(cfg, work, nWork, target, cfgCallTarget);
+				cfgPush(cfg, work, nWork, next, 0);
+				return;
+
+			case opcodeRestart:
+				cfgPush(cfg, work, nWork, memory[address] & 0x38, cfgCallTarget);
+				cfgPush(cfg, work, nWork, next, 0);
+				return;
+
+			case opcodeReturnIf:
+				cfg->marks[address] |= cfgIndirect;
+				cfgPush(cfg, work, nWork, next, 0);
+				return;
+
+			/* an interrupt goes on after it */
+			case opcodeHalt:
+				cfgPush(cfg, work, nWork, next, 0);
+				return;
+
+			default:
+				cfg->marks[address] |= cfgIndirect;
+				return;
+		}
+	}
+}
+
+/* memory holds the image at the addresses marked loaded. recovery can be
+ * run again with more entry points, e.g. targets of indirect jumps seen
+ * at run time */
+void cfgRecover(struct cfg *cfg, const uint8_t *memory, const uint16_t *entries, size_t nEntries) {
+	uint16_t *work;
+	size_t nWork, i;
+
+	/* every instruction queues at most two more */
+	work = malloc((2 * CFG_ADDRESSES + nEntries) * sizeof(*work));
+
+	if(work == NULL)
+		return;
+
+	nWork = 0;
+
+	for(i = 0; i < nEntries; i++)
+		cfgPush(cfg, work, &nWork, entries[i], cfgEntry);
+
+	while(nWork != 0)
+		cfgFollow(cfg, memory, work[--nWork], work, &nWork);
+
+	free(work);
+
+	cfg->nInstructions = cfg->nBlocks = cfg->nCallTargets = cfg->nLoaded = cfg->nCode = 0;
+
+	for(i = 0; i < CFG_ADDRESSES; i++) {
+		cfg->nInstructions += !!(cfg->marks[i] & cfgInstruction);
+		cfg->nBlocks += (cfg->marks[i] & (cfgInstruction | cfgLeader)) == (cfgInstruction | cfgLeader);
+		cfg->nCallTargets += (cfg->marks[i] & (cfgInstruction | cfgCallTarget))
+				== (cfgInstruction | cfgCallTarget);
+		cfg->nLoaded += !!(cfg->marks[i] & cfgLoaded);
+		cfg->nCode += !!(cfg->marks[i] & cfgCode);
+	}
+}
+
+/* the address right after the last instruction of the block at leader */
+uint16_t cfgBlockEnd(struct cfg *cfg, const uint8_t *memory, uint16_t leader) {
+	const struct opcodeInfo *info;
+	uint16_t address;
+
+	address = leader;
+
+	for(;;) {
+		info = &opcodeTable[memory[address]];
+		address += info->length;
+
+		if(info->flow != opcodeSequential || (cfg->marks[address] & (cfgLeader | cfgInstruction))
+				!= cfgInstruction)
+			return address;
+	}
+}
@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "console.h"
+
+static bool consoleInit(struct console *console, uint8_t mode) {
+	console->buffer = malloc(CONSOLE_INITIAL_CAPACITY);
+
+	if(console->buffer == NULL)
+		return false;
+
+	console->length = 0;
+	console->capacity = CONSOLE_INITIAL_CAPACITY;
+	console->mode = mode;
+	console->fd = -1;
+	console->sink = NULL;
+	console->context = NULL;
+
+	return true;
+}
+
+bool consoleInitFd(struct console *console, int fd) {
+	if(!consoleInit(console, consoleFd))
+		return false;
+
+	console->fd = fd;
+
+	return true;
+}
+
+bool consoleInitCallback(struct console *console,
+		void (*sink)(void *, const uint8_t *, size_t), void *context) {
+	if(!consoleInit(console, consoleCallback))
+		return false;
+
+	console->sink = sink;
+	console->context = context;
+
+	return true;
+}
+
+static void consoleStreamSink(void *stream, const uint8_t *data, size_t length) {
+	fwrite(data, 1, length, stream);
+}
+
+/* for output that shares a stdio stream with the host's own messages and has
+ * to stay in order with them */
+bool consoleInitStream(struct console *console, FILE *stream) {
+	return consoleInitCallback(console, consoleStreamSink, stream);
+}
+
+bool consoleInitCapture(struct console *console) {
+	return consoleInit(console, consoleCapture);
+}
+
+void consoleDestroy(struct console *console) {
+	consoleFlush(console);
+
+	free(console->buffer);
+	console->buffer = NULL;
+	console->capacity = 0;
+}
+
+/* makes room for length more bytes, growing the buffer when flushing isn't
+ * possible or isn't enough */
+bool consoleReserve(struct console *console, size_t length) {
+	uint8_t *grown;
+	size_t capacity;
+
+	if(console->mode != consoleCapture)
+		consoleFlush(console);
+
+	if(console->length + length <= console->capacity)
+		return true;
+
+	for(capacity = console->capacity ? console->capacity : CONSOLE_INITIAL_CAPACITY;
+			capacity < console->length + length; capacity *= 2)
+		;
+
+	grown = realloc(console->buffer, capacity);
+
+	if(grown == NULL)
+		return false;
+
+	console->buffer = grown;
+	console->capacity = capacity;
+
+	return true;
+}
+
+void consoleFlush(struct console *console) {
+	size_t written;
+	ssize_t result;
+
+	if(console->length == 0)
+		return;
+
+	switch(console->mode) {
+		case consoleFd:
+			for(written = 0; written < console->length; written += result) {
+				result = write(console->fd, console->buffer + written, console->length - written);
+
+				if(result < 0 && errno == EINTR)
+					result = 0;
+				else if(result < 0)
+					break;
+			}
+			break;
+
+		case consoleCallback:
+			console->sink(console->context, console->buffer, console->length);
+			break;
+
+		/* captured output stays until consoleClear */
+		case consoleCapture:
+			return;
+	}
+
+	console->length = 0;
+}
+
+/* everything captured so far, not NUL terminated */
+const uint8_t *consoleCaptured(struct console *console, size_t *length) {
+	*length = console->length;
+
+	return console->buffer;
+}
+
+void consoleClear(struct console *console) {
+	console->length = 0;
+}
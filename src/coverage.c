@@ -0,0 +1,127 @@
+#include <string.h>
+#include <stdlib.h>
+
+#include "coverage.h"
+
+void coverageReset(struct coverage *coverage) {
+	memset(coverage, 0, sizeof(*coverage));
+}
+
+/* ors the executed addresses and adds up the edge counters (saturating) so
+ * the coverage of many instances can be collected into one */
+void coverageMerge(struct coverage *destination, const struct coverage *source) {
+	size_t i;
+
+	for(i = 0; i < sizeof(destination->executed); i++)
+		destination->executed[i] |= source->executed[i];
+
+	for(i = 0; i < COVERAGE_EDGES; i++) {
+		if(destination->edges[i] + source->edges[i] > UINT8_MAX)
+			destination->edges[i] = UINT8_MAX;
+		else
+			destination->edges[i] += source->edges[i];
+	}
+}
+
+size_t coverageCountExecuted(const struct coverage *coverage) {
+	size_t i, count;
+
+	for(i = 0, count = 0; i < sizeof(coverage->executed); i++)
+		count += __builtin_popcount(coverage->executed[i]);
+
+	return count;
+}
+
+size_t coverageCountEdges(const struct coverage *coverage) {
+	size_t i, count;
+
+	for(i = 0, count = 0; i < COVERAGE_EDGES; i++)
+		count += coverage->edges[i] != 0;
+
+	return count;
+}
+
+static int coverageCompareSymbols(const void *a, const void *b) {
+	return ((const struct coverageSymbol *)a)->address - ((const struct coverageSymbol *)b)->address;
+}
+
+/* reads a symbol map with one "hex-address name" pair per line, sorted by
+ * address. the caller frees *symbols */
+size_t coverageReadSymbols(const char *path, struct coverageSymbol **symbols) {
+	FILE *file;
+	char line[128];
+	unsigned address;
+	size_t n, capacity;
+	struct coverageSymbol *resized;
+
+	*symbols = NULL;
+
+	file = fopen(path, "r");
+
+	if(file == NULL)
+		return 0;
+
+	n = capacity = 0;
+
+	while(fgets(line, sizeof(line), file) != NULL) {
+		if(n == capacity) {
+			capacity = capacity ? capacity * 2 : 64;
+			resized = realloc(*symbols, capacity * sizeof(**symbols));
+
+			if(resized == NULL)
+				break;
+
+			*symbols = resized;
+		}
+
+		if(sscanf(line, "%x %31s", &address, (*symbols)[n].name) == 2 && address <= 0xFFFF) {
+			(*symbols)[n].address = address;
+			n++;
+		}
+	}
+
+	fclose(file);
+
+	qsort(*symbols, n, sizeof(**symbols), coverageCompareSymbols);
+
+	return n;
+}
+
+/* lcov tracefile with guest addresses as line numbers: every symbol is a
+ * function, every executed address and every symbol address is a line */
+void coverageWriteLcov(struct coverage *coverage, FILE *stream, const char *sourceName,
+		struct coverageSymbol *symbols, size_t nSymbols) {
+	size_t i, hit, found, functionsHit;
+	uint32_t address;
+
+	fprintf(stream, "TN:\nSF:%s\n", sourceName);
+
+	for(i = 0, functionsHit = 0; i < nSymbols; i++) {
+		fprintf(stream, "FN:%u,%s\n", symbols[i].address, symbols[i].name);
+		functionsHit += coverageWasExecuted(coverage, symbols[i].address);
+	}
+
+	for(i = 0; i < nSymbols; i++)
+		fprintf(stream, "FNDA:%d,%s\n",
+				coverageWasExecuted(coverage, symbols[i].address), symbols[i].name);
+
+	fprintf(stream, "FNF:%lu\nFNH:%lu\n", nSymbols, functionsHit);
+
+	/* both lists are sorted, walk them together */
+	for(address = 0, i = 0, hit = 0, found = 0; address < COVERAGE_ADDRESSES; address++) {
+		while(i < nSymbols && symbols[i].address < address)
+			i++;
+
+		if(coverageWasExecuted(coverage, address)) {
+			fprintf(stream, "DA:%u,1\n", address);
+			hit++;
+			found++;
+		}
+		else if(i < nSymbols && symbols[i].address == address) {
+			fprintf(stream, "DA:%u,0\n", address);
+			found++;
+		}
+	}
+
+	fprintf(stream, "LF:%lu\nLH:%lu\nend_of_record\n", found, hit);
+}
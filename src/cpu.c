@@ -1,6 +1,13 @@
 #include "cpu.h"
 #include "util.h"
 #include "memory.h"
+#include "coverage.h"
+#include "heatmap.h"
+#include "guest_memory.h"
+#include "debugger.h"
+#include "hooks.h"
+#include "disassembler.h"
+#include "opcodes.h"
 
 static void cpuResetStatusRegister(struct cpu8080 *cpu);
 static void clearOrSetParityBit(struct cpu8080 *cpu, uint8_t value);
@@ -18,6 +25,17 @@ static void cpuInstructionCALL(struct cpu8080 *cpu, uint16_t addr);
 static void cpuInstructionRET(struct cpu8080 *cpu);
 static void cpuInstructionXCHG(struct cpu8080 *cpu);
 
+/* cycles of every opcode, from opcodes.def. taken conditional calls and
+ * returns add OPCODE_TAKEN_CYCLES */
+static const uint8_t cpuCycles[256] = {
+#define OPCODE(opcode, mnemonic, length, cycles, cyclesNotTaken, flags, flow, undocumented) \
+	[opcode] = cyclesNotTaken,
+#include "opcodes.def"
+#undef OPCODE
+};
+
+static struct disassemblyCache traceDisassembly;
+
 void printCpuState(struct cpu8080 cpu) {
         printf("PC: %04X, AF: %04X, BC: %04X, DE: %04X, HL: %04X, SP: %04X, CYC: %lu",
                 cpu.programCounter, cpu.registers[rA] << 8 | cpu.registers[rSTATUS],
@@ -25,8 +43,31 @@ void printCpuState(struct cpu8080 cpu) {
                 cpu.registers[rH] << 8 | cpu.registers[rL],
                 cpu.stackPointer, cpu.cycleCounter);
 
-        printf("\t(%02X %02X %02X %02X)\n", cpu.readMemory(cpu.memory, cpu.programCounter), cpu.readMemory(cpu.memory, cpu.programCounter + 1),
+        printf("\t(%02X %02X %02X %02X)", cpu.readMemory(cpu.memory, cpu.programCounter), cpu.readMemory(cpu.memory, cpu.programCounter + 1),
                 cpu.readMemory(cpu.memory, cpu.programCounter + 2), cpu.readMemory(cpu.memory, cpu.programCounter + 3));
+
+        /* a trace goes over the same few addresses over and over */
+        printf("\t%s\n", disassemblyCacheLookup(&traceDisassembly, &cpu, cpu.programCounter)->text);
+}
+
+/* reads from a guest memory are done here instead of through the callback,
+ * unless the callback has a heatmap to count them in */
+static inline uint8_t cpuRead(struct cpu8080 *cpu, uint16_t address) {
+#ifndef CPU_HEATMAP
+	if(cpu->readMemory == guestReadMemory)
+		return cpu->memory[address];
+#endif
+
+	return cpu->readMemory(cpu->memory, address);
+}
+
+static inline uint16_t cpuReadWord(struct cpu8080 *cpu, uint16_t address) {
+#ifndef CPU_HEATMAP
+	if(cpu->readMemoryWord == guestReadMemoryWord)
+		return guestLoadWord(cpu->memory, address);
+#endif
+
+	return cpu->readMemoryWord(cpu->memory, address);
 }
 
 static void cpuResetStatusRegister(struct cpu8080 *cpu) {
@@ -51,7 +92,7 @@ static void cpuPushToStack(struct cpu8080 *cpu, uint16_t data) {
 static uint16_t cpuPopFromStack(struct cpu8080 *cpu) {
 	uint16_t data;
 
-	data = cpu->readMemoryWord(cpu->memory, cpu->stackPointer);
+	data = cpuReadWord(cpu, cpu->stackPointer);
 
 	cpu->stackPointer += 2;
 
@@ -92,7 +133,7 @@ static void cpuInstructionMVItoM(struct cpu8080 *cpu, uint8_t data) {
 }
 
 static void cpuInstructionMOVfromM(struct cpu8080 *cpu, uint8_t r) {
-	cpu->registers[r] = cpu->readMemory(cpu->memory, cpuReadRegisterPair(cpu, rH, rL));
+	cpu->registers[r] = cpuRead(cpu, cpuReadRegisterPair(cpu, rH, rL));
 }
 
 static void cpuInstructionANI(struct cpu8080 *cpu, uint8_t value) {
@@ -237,14 +278,16 @@ static void cpuInstructionSBI(struct cpu8080 *cpu, uint8_t value) {
 
 	borrowBit = isBitSet(cpu->registers[rSTATUS], carryF);
 
-	value += (uint8_t)borrowBit;
+	/* carry, before value + borrow can wrap around to 0 */
+	clearOrSetBit(&cpu->registers[rSTATUS], 0,
+			((int16_t)cpu->registers[rA] - (int16_t)value - (int16_t)borrowBit) < 0);
 
-	/* carry */
-	clearOrSetBit(&cpu->registers[rSTATUS], 0, (((uint16_t)cpu->registers[rA] - ((uint16_t)value)) < 0));
+	/* auxiliary carry, out of bit 3 of A + ~value + !borrow like cpuSubtract */
+	clearOrSetBit(&cpu->registers[rSTATUS], 4,
+			((cpu->registers[rA] & 0x0F) + ((~value) & 0x0F) + !borrowBit) > 0x0F);
+
+	value += (uint8_t)borrowBit;
 
-	/* auxiliary carry*/
-	clearOrSetBit(&cpu->registers[rSTATUS], 4, (((cpu->registers[rA] & 0x0F) > (value & 0x0F))));
-	
 	cpu->registers[rA] -= value;
 
 	/* parity */
@@ -257,6 +300,36 @@ static void cpuInstructionSBI(struct cpu8080 *cpu, uint8_t value) {
 	clearOrSetBit(&cpu->registers[rSTATUS], 7, isBitSet(cpu->registers[rA], 7));
 }
 
+/* whether the upper digit needs correcting is decided on the accumulator
+ * before the lower digit is corrected, which may carry out of it. the
+ * correction of the upper digit sets the carry, a carry that was set
+ * stays set */
+static void cpuInstructionDAA(struct cpu8080 *cpu) {
+	bool upper;
+
+	upper = cpu->registers[rA] > 0x99 || isBitSet(cpu->registers[rSTATUS], carryF);
+
+	if((cpu->registers[rA] & 0x0F) > 9 || 
+			isBitSet(cpu->registers[rSTATUS], auxCarryF)) {
+
+		clearOrSetBit(&cpu->registers[rSTATUS], auxCarryF, 
+				((cpu->registers[rA] & 0x0F) + 6 > 0x0F));
+
+		cpu->registers[rA] += 6;
+	}
+
+	if(upper) {
+		setBit(&cpu->registers[rSTATUS], carryF);
+		cpu->registers[rA] += (6 << 4);
+	}
+	
+	clearOrSetParityBit(cpu, cpu->registers[rA]);
+
+	clearOrSetBit(&cpu->registers[rSTATUS], zeroF, !cpu->registers[rA]);
+
+	clearOrSetBit(&cpu->registers[rSTATUS], signF, isBitSet(cpu->registers[rA], 7));
+}
+
 static void cpuInstructionCPI(struct cpu8080 *cpu, uint8_t value) {
 	uint8_t temp;
 
@@ -273,15 +346,19 @@ static void cpuInstructionCALL(struct cpu8080 *cpu, uint16_t addr) {
 
 }
 
+/* the program counter is already past the opcode, that's where it returns */
+static void cpuInstructionRST(struct cpu8080 *cpu, uint16_t vector) {
+	cpuPushToStack(cpu, cpu->programCounter);
+	cpuJumpToAddr(cpu, vector);
+}
+
 static void cpuCallIf(struct cpu8080 *cpu, bool value, uint16_t addr) {
 	if(value) {
 		cpuInstructionCALL(cpu, addr);
-		cpu->cycleCounter += 17;
+		cpu->cycleCounter += OPCODE_TAKEN_CYCLES;
 	}
-	else {
+	else
 		cpu->programCounter += 2;
-		cpu->cycleCounter += 11;
-	}
 }
 
 static void cpuInstructionRET(struct cpu8080 *cpu) {
@@ -291,10 +368,8 @@ static void cpuInstructionRET(struct cpu8080 *cpu) {
 static void cpuReturnIf(struct cpu8080 *cpu, bool value) {
 	if(value) {
 		cpuInstructionRET(cpu);
-		cpu->cycleCounter += 11;
+		cpu->cycleCounter += OPCODE_TAKEN_CYCLES;
 	}
-	else
-		cpu->cycleCounter += 5;
 }
 
 static void cpuInstructionXCHG(struct cpu8080 *cpu) {
@@ -357,72 +432,93 @@ static void cpuInstructionDAD(struct cpu8080 *cpu, uint16_t data) {
 	cpuWriteWordToRegisterPair(cpu, rH, rL, cpuReadRegisterPair(cpu, rH, rL) + data);
 }
 
-void cpuExecuteInstruction(struct cpu8080 *cpu) {
-	uint8_t opcode,
-		temp;
+/* latches an interrupt request, opcode is an RST instruction. a request
+ * stays pending until the cpu takes it */
+void cpuInterrupt(struct cpu8080 *cpu, uint8_t opcode) {
+	cpu->interruptPending = true;
+	cpu->interruptOpcode = opcode;
+}
 
-	opcode = cpu->readMemory(cpu->memory, cpu->programCounter);
+/* called by the engines between instructions, runs the RST of a pending
+ * interrupt if interrupts are enabled. true if it did */
+bool cpuAcceptInterrupt(struct cpu8080 *cpu) {
+	bool delayed;
 
-#ifdef DEBUG 
-        printCpuState(*cpu);
-#endif
+	delayed = cpu->interruptDelay;
+	cpu->interruptDelay = false;
 
-	cpu->programCounter++;
+	if(!cpu->interruptPending || !cpu->interruptEnable || delayed)
+		return false;
+
+	cpu->interruptPending = false;
+	cpu->interruptEnable = false;
+	cpu->halted = false;
+
+	cpu->stackPointer -= 2;
+	cpu->writeMemoryWord(cpu->memory, cpu->stackPointer, cpu->programCounter);
+
+	cpu->programCounter = cpu->interruptOpcode & 0x38;
+	cpu->cycleCounter += 11;
+
+	return true;
+}
+
+/* the instruction set, from right after the fetch of opcode. it's inlined
+ * into cpuExecute and, with a constant opcode, into code translated ahead
+ * of time, where it folds down to the one case */
+static inline __attribute__((always_inline)) void cpuDispatch(struct cpu8080 *cpu, uint8_t opcode) {
+	uint8_t temp;
+
+	/* devices an instruction talks to see the cycles it takes */
+	cpu->cycleCounter += cpuCycles[opcode];
 
 	switch(opcode) {
-		/* NOP */
+		/* NOP and its undocumented aliases */
 		case 0x00:
-			cpu->cycleCounter += 4;
-
+		case 0x08:
+		case 0x10:
+		case 0x18:
+		case 0x20:
+		case 0x28:
+		case 0x30:
+		case 0x38:
 			break;
 
 		/* LXI BC, d16 */
 		case 0x01:
-			cpuWriteWordToRegisterPair(cpu, rB, rC, cpu->readMemoryWord(cpu->memory, cpu->programCounter));
+			cpuWriteWordToRegisterPair(cpu, rB, rC, cpuReadWord(cpu, cpu->programCounter));
 
 			cpu->programCounter += 2;
 
-			cpu->cycleCounter += 10;
-
 			break;
 
 		/* STAX BC */
 		case 0x02:
 			cpu->writeMemory(cpu->memory, cpuReadRegisterPair(cpu, rB, rC), cpu->registers[rA]);
 
-			cpu->cycleCounter += 7;
-
 			break;
 
 		/* INX BC */
 		case 0x03:
 			cpuInstructionINX(cpu, rB, rC);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* INR B */
 		case 0x04:
 			cpuInstructionINR(cpu, rB);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* DCR B */
 		case 0x05:
 			cpuInstructionDCR(cpu, rB);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MVI B, d8 */
 		case 0x06:
-			cpuInstructionMVI(cpu, rB, cpu->readMemory(cpu->memory, cpu->programCounter++));
-
-			cpu->cycleCounter += 7;
+			cpuInstructionMVI(cpu, rB, cpuRead(cpu, cpu->programCounter++));
 
 			break;
 
@@ -436,29 +532,17 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 
 			clearOrSetBit(&cpu->registers[rA], 0, temp);
 
-			cpu->cycleCounter += 4;
-
-			break;
-
-		/* ILLEGAL/UNDOCUMENTED OPCODE - NOP */
-		case 0x08:
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* DAD BC */
 		case 0x09:
 			cpuInstructionDAD(cpu, cpuReadRegisterPair(cpu, rB, rC));
 
-			cpu->cycleCounter += 10;
-
 			break;
 
 		/* LDAX BC */
 		case 0x0A:
-			cpu->registers[rA] = cpu->readMemory(cpu->memory, cpuReadRegisterPair(cpu, rB, rC));
-
-			cpu->cycleCounter += 7;
+			cpu->registers[rA] = cpuRead(cpu, cpuReadRegisterPair(cpu, rB, rC));
 
 			break;
 
@@ -466,31 +550,23 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 		case 0x0B:
 			cpuInstructionDCX(cpu, rB, rC);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* INR C */
 		case 0x0C:
 			cpuInstructionINR(cpu, rC);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* DCR C */
 		case 0x0D:
 			cpuInstructionDCR(cpu, rC);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MVI C, d8 */
 		case 0x0E:
-			cpuInstructionMVI(cpu, rC, cpu->readMemory(cpu->memory, cpu->programCounter++));
-
-			cpu->cycleCounter += 7;
+			cpuInstructionMVI(cpu, rC, cpuRead(cpu, cpu->programCounter++));
 
 			break;
 
@@ -504,63 +580,43 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 
 			clearOrSetBit(&cpu->registers[rA], 7, temp);
 
-			cpu->cycleCounter += 4;
-
-			break;
-
-		/* ILLEGAL/UNDOCUMENTED OPCODE - NOP */
-		case 0x10:
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* LXI DE, d16 */
 		case 0x11:
-			cpuWriteWordToRegisterPair(cpu, rD, rE, cpu->readMemoryWord(cpu->memory, cpu->programCounter));
+			cpuWriteWordToRegisterPair(cpu, rD, rE, cpuReadWord(cpu, cpu->programCounter));
 
 			cpu->programCounter += 2;
 
-			cpu->cycleCounter += 10;
-
 			break;
 
 		/* STAX DE */
 		case 0x12:
 			cpu->writeMemory(cpu->memory, cpuReadRegisterPair(cpu, rD, rE), cpu->registers[rA]);
 
-			cpu->cycleCounter += 7;
-
 			break;
 
 		/* INX DE */
 		case 0x13:
 			cpuInstructionINX(cpu, rD, rE);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* INR D */
 		case 0x14:
 			cpuInstructionINR(cpu, rD);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* DCR D */
 		case 0x15:
 			cpuInstructionDCR(cpu, rD);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MVI D, d8 */
 		case 0x16:
-			cpuInstructionMVI(cpu, rD, cpu->readMemory(cpu->memory, cpu->programCounter++));
-
-			cpu->cycleCounter += 7;
+			cpuInstructionMVI(cpu, rD, cpuRead(cpu, cpu->programCounter++));
 
 			break;
 
@@ -574,23 +630,17 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 
 			clearOrSetBit(&cpu->registers[rA], 0, temp);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* DAD DE */
 		case 0x19:
 			cpuInstructionDAD(cpu, cpuReadRegisterPair(cpu, rD, rE));
 
-			cpu->cycleCounter += 10;
-
 			break;
 
 		/* LDAX DE */
 		case 0x1A:
-			cpu->registers[rA] = cpu->readMemory(cpu->memory, cpuReadRegisterPair(cpu, rD, rE));
-
-			cpu->cycleCounter += 7;
+			cpu->registers[rA] = cpuRead(cpu, cpuReadRegisterPair(cpu, rD, rE));
 
 			break;
 
@@ -598,31 +648,23 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 		case 0x1B:
 			cpuInstructionDCX(cpu, rD, rE);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* INR E */
 		case 0x1C:
 			cpuInstructionINR(cpu, rE);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* DCR E */
 		case 0x1D:
 			cpuInstructionDCR(cpu, rE);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MVI E, d8 */
 		case 0x1E:
-			cpuInstructionMVI(cpu, rE, cpu->readMemory(cpu->memory, cpu->programCounter++));
-
-			cpu->cycleCounter += 7;
+			cpuInstructionMVI(cpu, rE, cpuRead(cpu, cpu->programCounter++));
 
 			break;
 
@@ -636,25 +678,21 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 
 			clearOrSetBit(&cpu->registers[rA], 7, temp);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* LXI HL, d16 */
 		case 0x21:
-			cpuWriteWordToRegisterPair(cpu, rH, rL, cpu->readMemoryWord(cpu->memory, cpu->programCounter));
+			cpuWriteWordToRegisterPair(cpu, rH, rL, cpuReadWord(cpu, cpu->programCounter));
 
 			cpu->programCounter += 2;
-			cpu->cycleCounter += 10;
 
 			break;
 
 		/* SHLD a16 */
 		case 0x22:
-			cpu->writeMemoryWord(cpu->memory, cpu->readMemoryWord(cpu->memory, cpu->programCounter), cpuReadRegisterPair(cpu, rH, rL));
+			cpu->writeMemoryWord(cpu->memory, cpuReadWord(cpu, cpu->programCounter), cpuReadRegisterPair(cpu, rH, rL));
 
 			cpu->programCounter += 2;
-			cpu->cycleCounter += 16;
 
 			break;
 
@@ -662,61 +700,29 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 		case 0x23:
 			cpuInstructionINX(cpu, rH, rL);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* INR H */
 		case 0x24:
 			cpuInstructionINR(cpu, rH);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* DCR H */
 		case 0x25:
 			cpuInstructionDCR(cpu, rH);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MVI H, d8 */
 		case 0x26:
-			cpuInstructionMVI(cpu, rH, cpu->readMemory(cpu->memory, cpu->programCounter++));
-
-			cpu->cycleCounter += 7;
+			cpuInstructionMVI(cpu, rH, cpuRead(cpu, cpu->programCounter++));
 
 			break;
 
 		/* DAA */
 		case 0x27:
-			if((cpu->registers[rA] & 0x0F) > 9 || 
-					isBitSet(cpu->registers[rSTATUS], auxCarryF)) {
-
-				clearOrSetBit(&cpu->registers[rSTATUS], auxCarryF, 
-						((cpu->registers[rA] & 0x0F) + 6 > 0x0F));
-
-				cpu->registers[rA] += 6;
-			}
-
-			if((cpu->registers[rA] >> 4) > 9 || 
-					isBitSet(cpu->registers[rSTATUS], carryF)) {
-
-				clearOrSetBit(&cpu->registers[rSTATUS], carryF,
-						(((uint16_t)cpu->registers[rA] + (6 << 4)) > 0xff));
-
-				cpu->registers[rA] += (6 << 4);
-			}
-			
-			clearOrSetParityBit(cpu, cpu->registers[rA]);
-	
-			clearOrSetBit(&cpu->registers[rSTATUS], zeroF, !cpu->registers[rA]);
-
-			clearOrSetBit(&cpu->registers[rSTATUS], signF, isBitSet(cpu->registers[rA], 7));
-
-			cpu->cycleCounter += 4;
+			cpuInstructionDAA(cpu);
 
 			break;
 
@@ -724,16 +730,13 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 		case 0x29:
 			cpuInstructionDAD(cpu, cpuReadRegisterPair(cpu, rH, rL));
 
-			cpu->cycleCounter += 10;
-
 			break;
 
 		/* LHLD a16 */
 		case 0x2A:
-			cpuWriteWordToRegisterPair(cpu, rH, rL, cpu->readMemoryWord(cpu->memory, cpu->readMemoryWord(cpu->memory, cpu->programCounter)));
+			cpuWriteWordToRegisterPair(cpu, rH, rL, cpuReadWord(cpu, cpuReadWord(cpu, cpu->programCounter)));
 
 			cpu->programCounter += 2;
-			cpu->cycleCounter += 16;
 
 			break;
 
@@ -741,31 +744,23 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 		case 0x2B:
 			cpuInstructionDCX(cpu, rH, rL);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* INR L */
 		case 0x2C:
 			cpuInstructionINR(cpu, rL);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* DCR L */
 		case 0x2D:
 			cpuInstructionDCR(cpu, rL);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MVI L, d8 */
 		case 0x2E:
-			cpuInstructionMVI(cpu, rL, cpu->readMemory(cpu->memory, cpu->programCounter++));
-
-			cpu->cycleCounter += 7;
+			cpuInstructionMVI(cpu, rL, cpuRead(cpu, cpu->programCounter++));
 
 			break;
 
@@ -773,26 +768,22 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 		case 0x2F:
 			cpu->registers[rA] = ~cpu->registers[rA];
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* LXI SP, d16*/
 		case 0x31:
-			cpu->stackPointer = (cpu->readMemory(cpu->memory, cpu->programCounter + 1) << 8) |
-				cpu->readMemory(cpu->memory, cpu->programCounter);
+			cpu->stackPointer = (cpuRead(cpu, cpu->programCounter + 1) << 8) |
+				cpuRead(cpu, cpu->programCounter);
 
 			cpu->programCounter += 2;
-			cpu->cycleCounter += 10;
 
 			break;
 
 		/* STA a16 */
 		case 0x32:
-			cpu->writeMemory(cpu->memory, cpu->readMemoryWord(cpu->memory, cpu->programCounter), cpu->registers[rA]);
+			cpu->writeMemory(cpu->memory, cpuReadWord(cpu, cpu->programCounter), cpu->registers[rA]);
 
 			cpu->programCounter += 2;
-			cpu->cycleCounter += 13;
 
 			break;
 
@@ -800,13 +791,11 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 		case 0x33:
 			cpu->stackPointer++;
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* INR M */
 		case 0x34:
-			temp = cpu->readMemory(cpu->memory, cpuReadRegisterPair(cpu, rH, rL));
+			temp = cpuRead(cpu, cpuReadRegisterPair(cpu, rH, rL));
 
 			/* auxiliary carry*/
 			clearOrSetBit(&cpu->registers[rSTATUS], 4, ((unsigned)(temp & 0x0F) + 1) > 0x0F);
@@ -822,13 +811,11 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 			/* sign */
 			clearOrSetBit(&cpu->registers[rSTATUS], signF, isBitSet(temp, 7));
 
-			cpu->cycleCounter += 10;
-
 			break;
 
 		/* DCR M */
 		case 0x35:
-			temp = cpu->readMemory(cpu->memory, cpuReadRegisterPair(cpu, rH, rL));
+			temp = cpuRead(cpu, cpuReadRegisterPair(cpu, rH, rL));
 			
 			/* auxiliary carry*/
 			clearOrSetBit(&cpu->registers[rSTATUS], 4, (temp & 0x0F) != 0);
@@ -845,15 +832,11 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 			clearOrSetBit(&cpu->registers[rSTATUS], 7, isBitSet(temp, 7));
 
 
-			cpu->cycleCounter += 10;
-
 			break;
 
 		/* MOV M, d8 */
 		case 0x36:
-			cpu->writeMemory(cpu->memory, cpuReadRegisterPair(cpu, rH, rL), cpu->readMemory(cpu->memory, cpu->programCounter++));
-
-			cpu->cycleCounter += 10;
+			cpu->writeMemory(cpu->memory, cpuReadRegisterPair(cpu, rH, rL), cpuRead(cpu, cpu->programCounter++));
 
 			break;
 
@@ -861,24 +844,19 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 		case 0x37:
 			setBit(&cpu->registers[rSTATUS], carryF);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* DAD SP */
 		case 0x39:
 			cpuInstructionDAD(cpu, cpu->stackPointer);
 
-			cpu->cycleCounter += 10;
-
 			break;
 
 		/* LDA a16 */
 		case 0x3A:
-			cpu->registers[rA] = cpu->readMemory(cpu->memory, cpu->readMemoryWord(cpu->memory, cpu->programCounter));
+			cpu->registers[rA] = cpuRead(cpu, cpuReadWord(cpu, cpu->programCounter));
 
 			cpu->programCounter += 2;
-			cpu->cycleCounter += 13;
 
 			break;
 
@@ -886,31 +864,23 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 		case 0x3B:
 			cpu->stackPointer--;
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* INR A */
 		case 0x3C:
 			cpuInstructionINR(cpu, rA);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* DCR A */
 		case 0x3D:
 			cpuInstructionDCR(cpu, rA);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MVI A, d8 */
 		case 0x3E:
-			cpuInstructionMVI(cpu, rA, cpu->readMemory(cpu->memory, cpu->programCounter++));
-
-			cpu->cycleCounter += 7;
+			cpuInstructionMVI(cpu, rA, cpuRead(cpu, cpu->programCounter++));
 
 			break;
 
@@ -918,404 +888,300 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 		case 0x3F:
 			clearOrSetBit(&cpu->registers[rSTATUS], carryF, !isBitSet(cpu->registers[rSTATUS], carryF));
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* MOV B, B */
 		case 0x40:
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV B, C */
 		case 0x41:
 			cpuInstructionMOV(cpu, rB, rC);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV B, D */
 		case 0x42:
 			cpuInstructionMOV(cpu, rB, rD);
 
-			cpu->cycleCounter += 5;
-
 			break;
 	
 		/* MOV B, E */
 		case 0x43:
 			cpuInstructionMOV(cpu, rB, rE);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV B, H */
 		case 0x44:
 			cpuInstructionMOV(cpu, rB, rH);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV M, L */
 		case 0x45:
 			cpuInstructionMOV(cpu, rB, rL);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV B, A */
 		case 0x47:
 			cpuInstructionMOV(cpu, rB, rA);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV B, M */
 		case 0x46:
 			cpuInstructionMOVfromM(cpu, rB);
 
-			cpu->cycleCounter += 7;
-
 			break;
 
 		/* MOV C, B */
 		case 0x48:
 			cpuInstructionMOV(cpu, rC, rB);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV C, C */
 		case 0x49:
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV C, D */
 		case 0x4A:
 			cpuInstructionMOV(cpu, rC, rD);
 
-			cpu->cycleCounter += 5;
-
 			break;
 		
 		/* MOV C, E */
 		case 0x4B:
 			cpuInstructionMOV(cpu, rC, rE);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV C, H */
 		case 0x4C:
 			cpuInstructionMOV(cpu, rC, rH);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV C, L */
 		case 0x4D:
 			cpuInstructionMOV(cpu, rC, rL);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV C, M */
 		case 0x4E:
 			cpuInstructionMOVfromM(cpu, rC);
 
-			cpu->cycleCounter += 7;
-
 			break;
 
 		/* MOV C, A */
 		case 0x4F:
 			cpuInstructionMOV(cpu, rC, rA);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV D, B */
 		case 0x50:
 			cpuInstructionMOV(cpu, rD, rB);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV D, C */
 		case 0x51:
 			cpuInstructionMOV(cpu, rD, rC);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV D, D */
 		case 0x52:
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV D, E */
 		case 0x53:
 			cpuInstructionMOV(cpu, rD, rE);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV D, H */
 		case 0x54:
 			cpuInstructionMOV(cpu, rD, rH);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV D, L */
 		case 0x55:
 			cpuInstructionMOV(cpu, rD, rL);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV D, M */
 		case 0x56:
 			cpuInstructionMOVfromM(cpu, rD);
 
-			cpu->cycleCounter += 7;
-
 			break;
 
 		/* MOV D, A */
 		case 0x57:
 			cpuInstructionMOV(cpu, rD, rA);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV E, B */
 		case 0x58:
 			cpuInstructionMOV(cpu, rE, rB);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV E, C */
 		case 0x59:
 			cpuInstructionMOV(cpu, rE, rC);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV E, D */
 		case 0x5A:
 			cpuInstructionMOV(cpu, rE, rD);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV E, E */
 		case 0x5B:
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV E, H */
 		case 0x5C:
 			cpuInstructionMOV(cpu, rE, rH);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV E, L */
 		case 0x5D:
 			cpuInstructionMOV(cpu, rE, rL);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV E, M */
 		case 0x5E:
 			cpuInstructionMOVfromM(cpu, rE);
 
-			cpu->cycleCounter += 7;
-
 			break;
 
 		/* MOV E, A */
 		case 0x5F:
 			cpuInstructionMOV(cpu, rE, rA);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV H, B */
 		case 0x60:
 			cpuInstructionMOV(cpu, rH, rB);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV H, C */
 		case 0x61:
 			cpuInstructionMOV(cpu, rH, rC);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV H, D */
 		case 0x62:
 			cpuInstructionMOV(cpu, rH, rD);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV H, E */
 		case 0x63:
 			cpuInstructionMOV(cpu, rH, rE);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV H, H */
 		case 0x64:
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV H, L */
 		case 0x65:
 			cpuInstructionMOV(cpu, rH, rL);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV H, M */
 		case 0x66:
 			cpuInstructionMOVfromM(cpu, rH);
 
-			cpu->cycleCounter += 7;
-
 			break;
 
 		/* MOV H, A */
 		case 0x67:
 			cpuInstructionMOV(cpu, rH, rA);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV L, B */
 		case 0x68:
 			cpuInstructionMOV(cpu, rL, rB);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV L, C */
 		case 0x69:
 			cpuInstructionMOV(cpu, rL, rC);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV L, D */
 		case 0x6A:
 			cpuInstructionMOV(cpu, rL, rD);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV L, E */
 		case 0x6B:
 			cpuInstructionMOV(cpu, rL, rE);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV L, H */
 		case 0x6C:
 			cpuInstructionMOV(cpu, rL, rH);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV L, L */
 		case 0x6D:
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV L, M */
 		case 0x6E:
 			cpuInstructionMOVfromM(cpu, rL);
 
-			cpu->cycleCounter += 7;
-
 			break;
 
 		/* MOV L, A */
 		case 0x6F:
 			cpuInstructionMOV(cpu, rL, rA);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV M, B */
 		case 0x70:
 			cpuInstructionMVItoM(cpu, cpu->registers[rB]);
 
-			cpu->cycleCounter += 7;
-
 			break;
 
 		/* MOV M, C */
 		case 0x71:
 			cpuInstructionMVItoM(cpu, cpu->registers[rC]);
 
-			cpu->cycleCounter += 7;
-
 			break;
 
 		/* MOV M, D */
 		case 0x72:
 			cpuInstructionMVItoM(cpu, cpu->registers[rD]);
 
-			cpu->cycleCounter += 7;
-
 			break;
 
 
@@ -1323,23 +1189,23 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 		case 0x73:
 			cpuInstructionMVItoM(cpu, cpu->registers[rE]);
 
-			cpu->cycleCounter += 7;
-
 			break;
 
 		/* MOV M, H */
 		case 0x74:
 			cpuInstructionMVItoM(cpu, cpu->registers[rH]);
 
-			cpu->cycleCounter += 7;
-
 			break;
 
 		/* MOV M, L */
 		case 0x75:
 			cpuInstructionMVItoM(cpu, cpu->registers[rL]);
 
-			cpu->cycleCounter += 7;
+			break;
+
+		/* HLT */
+		case 0x76:
+			cpu->halted = true;
 
 			break;
 
@@ -1347,125 +1213,93 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 		case 0x77:
 			cpuInstructionMVItoM(cpu, cpu->registers[rA]);
 
-			cpu->cycleCounter += 7;
-
 			break;
 
 		/* MOV A, B */
 		case 0x78:
 			cpuInstructionMOV(cpu, rA, rB);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV A, C */
 		case 0x79:
 			cpuInstructionMOV(cpu, rA, rC);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV A, D */
 		case 0x7A:
 			cpuInstructionMOV(cpu, rA, rD);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV A, E */
 		case 0x7B:
 			cpuInstructionMOV(cpu, rA, rE);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV A, H */
 		case 0x7C:
 			cpuInstructionMOV(cpu, rA, rH);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV A, L */
 		case 0x7D:
 			cpuInstructionMOV(cpu, rA, rL);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* MOV A, M */
 		case 0x7E:
 			cpuInstructionMOVfromM(cpu, rA);
 
-			cpu->cycleCounter += 7;
-
 			break;
 
 		/* MOV A, A */
 		case 0x7F:
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* ADD B */
 		case 0x80:
 			cpuInstructionADI(cpu, cpu->registers[rB]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* ADD C */
 		case 0x81:
 			cpuInstructionADI(cpu, cpu->registers[rC]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* ADD D */
 		case 0x82:
 			cpuInstructionADI(cpu, cpu->registers[rD]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* ADD E */
 		case 0x83:
 			cpuInstructionADI(cpu, cpu->registers[rE]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* ADD H */
 		case 0x84:
 			cpuInstructionADI(cpu, cpu->registers[rH]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* ADD L */
 		case 0x85:
 			cpuInstructionADI(cpu, cpu->registers[rL]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* ADD M */
 		case 0x86:
-			cpuInstructionADI(cpu, cpu->readMemory(cpu->memory, cpuReadRegisterPair(cpu, rH, rL)));
-
-			cpu->cycleCounter += 7;
+			cpuInstructionADI(cpu, cpuRead(cpu, cpuReadRegisterPair(cpu, rH, rL)));
 
 			break;
 
@@ -1473,63 +1307,47 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 		case 0x87:
 			cpuInstructionADI(cpu, cpu->registers[rA]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* ADC B */
 		case 0x88:
 			cpuInstructionACI(cpu, cpu->registers[rB]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* ADC C */
 		case 0x89:
 			cpuInstructionACI(cpu, cpu->registers[rC]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* ADC D */
 		case 0x8A:
 			cpuInstructionACI(cpu, cpu->registers[rD]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* ADC E */
 		case 0x8B:
 			cpuInstructionACI(cpu, cpu->registers[rE]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* ADC H */
 		case 0x8C:
 			cpuInstructionACI(cpu, cpu->registers[rH]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* ADC L */
 		case 0x8D:
 			cpuInstructionACI(cpu, cpu->registers[rL]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* ADC M */
 		case 0x8E:
-			cpuInstructionACI(cpu, cpu->readMemory(cpu->memory, cpuReadRegisterPair(cpu, rH, rL)));
-
-			cpu->cycleCounter += 7;
+			cpuInstructionACI(cpu, cpuRead(cpu, cpuReadRegisterPair(cpu, rH, rL)));
 
 			break;
 
@@ -1537,63 +1355,47 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 		case 0x8F:
 			cpuInstructionACI(cpu, cpu->registers[rA]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* SUB B */
 		case 0x90:
 			cpuInstructionSUI(cpu, cpu->registers[rB]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* SUB C */
 		case 0x91:
 			cpuInstructionSUI(cpu, cpu->registers[rC]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* SUB D */
 		case 0x92:
 			cpuInstructionSUI(cpu, cpu->registers[rD]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* SUB E */
 		case 0x93:
 			cpuInstructionSUI(cpu, cpu->registers[rE]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* SUB H */
 		case 0x94:
 			cpuInstructionSUI(cpu, cpu->registers[rH]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* SUB L */
 		case 0x95:
 			cpuInstructionSUI(cpu, cpu->registers[rL]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* SUB M */
 		case 0x96:
-			cpuInstructionSUI(cpu, cpu->readMemory(cpu->memory, cpuReadRegisterPair(cpu, rH, rL)));
-
-			cpu->cycleCounter += 7;
+			cpuInstructionSUI(cpu, cpuRead(cpu, cpuReadRegisterPair(cpu, rH, rL)));
 
 			break;
 
@@ -1601,63 +1403,47 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 		case 0x97:
 			cpuInstructionSUI(cpu, cpu->registers[rA]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* SBB B */
 		case 0x98:
 			cpuInstructionSBI(cpu, cpu->registers[rB]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* SBB C */
 		case 0x99:
 			cpuInstructionSBI(cpu, cpu->registers[rC]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* SBB D */
 		case 0x9A:
 			cpuInstructionSBI(cpu, cpu->registers[rD]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* SBB E */
 		case 0x9B:
 			cpuInstructionSBI(cpu, cpu->registers[rE]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* SBB H */
 		case 0x9C:
 			cpuInstructionSBI(cpu, cpu->registers[rH]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* SBB L */
 		case 0x9D:
 			cpuInstructionSBI(cpu, cpu->registers[rL]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* SBB M */
 		case 0x9E:
-			cpuInstructionSBI(cpu, cpu->readMemory(cpu->memory, cpuReadRegisterPair(cpu, rH, rL)));
-
-			cpu->cycleCounter += 7;
+			cpuInstructionSBI(cpu, cpuRead(cpu, cpuReadRegisterPair(cpu, rH, rL)));
 
 			break;
 
@@ -1665,15 +1451,12 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 		case 0x9F:
 			cpuInstructionSBI(cpu, cpu->registers[rA]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* ANA B */
 		case 0xA0:
 			cpuInstructionANI(cpu, cpu->registers[rB]);
 
-			cpu->cycleCounter += 4;
 				
 			break;
 
@@ -1681,7 +1464,6 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 		case 0xA1:
 			cpuInstructionANI(cpu, cpu->registers[rC]);
 
-			cpu->cycleCounter += 4;
 				
 			break;
 
@@ -1689,7 +1471,6 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 		case 0xA2:
 			cpuInstructionANI(cpu, cpu->registers[rD]);
 
-			cpu->cycleCounter += 4;
 				
 			break;
 
@@ -1697,7 +1478,6 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 		case 0xA3:
 			cpuInstructionANI(cpu, cpu->registers[rE]);
 
-			cpu->cycleCounter += 4;
 				
 			break;
 
@@ -1705,7 +1485,6 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 		case 0xA4:
 			cpuInstructionANI(cpu, cpu->registers[rH]);
 
-			cpu->cycleCounter += 4;
 				
 			break;
 
@@ -1713,15 +1492,13 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 		case 0xA5:
 			cpuInstructionANI(cpu, cpu->registers[rL]);
 
-			cpu->cycleCounter += 4;
 				
 			break;
 
 		/* ANA M */
 		case 0xA6:
-			cpuInstructionANI(cpu, cpu->readMemory(cpu->memory, cpuReadRegisterPair(cpu, rH, rL)));
+			cpuInstructionANI(cpu, cpuRead(cpu, cpuReadRegisterPair(cpu, rH, rL)));
 
-			cpu->cycleCounter += 7;
 				
 			break;
 
@@ -1729,7 +1506,6 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 		case 0xA7:
 			cpuInstructionANI(cpu, cpu->registers[rA]);
 
-			cpu->cycleCounter += 4;
 				
 			break;
 
@@ -1737,55 +1513,41 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 		case 0xA8:
 			cpuInstructionXRI(cpu, cpu->registers[rB]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* XRA C */
 		case 0xA9:
 			cpuInstructionXRI(cpu, cpu->registers[rC]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* XRA D */
 		case 0xAA:
 			cpuInstructionXRI(cpu, cpu->registers[rD]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* XRA E */
 		case 0xAB:
 			cpuInstructionXRI(cpu, cpu->registers[rE]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* XRA H */
 		case 0xAC:
 			cpuInstructionXRI(cpu, cpu->registers[rH]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* XRA L */
 		case 0xAD:
 			cpuInstructionXRI(cpu, cpu->registers[rL]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* XRA M */
 		case 0xAE:
-			cpuInstructionXRI(cpu, cpu->readMemory(cpu->memory, cpuReadRegisterPair(cpu, rH, rL)));
-
-			cpu->cycleCounter += 7;
+			cpuInstructionXRI(cpu, cpuRead(cpu, cpuReadRegisterPair(cpu, rH, rL)));
 
 			break;
 
@@ -1793,63 +1555,47 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 		case 0xAF:
 			cpuInstructionXRI(cpu, cpu->registers[rA]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* ORA B */
 		case 0xB0:
 			cpuInstructionORI(cpu, cpu->registers[rB]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* ORA C */
 		case 0xB1:
 			cpuInstructionORI(cpu, cpu->registers[rC]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* ORA D */
 		case 0xB2:
 			cpuInstructionORI(cpu, cpu->registers[rD]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* ORA E */
 		case 0xB3:
 			cpuInstructionORI(cpu, cpu->registers[rE]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* ORA H */
 		case 0xB4:
 			cpuInstructionORI(cpu, cpu->registers[rH]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* ORA L */
 		case 0xB5:
 			cpuInstructionORI(cpu, cpu->registers[rL]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* ORA M */
 		case 0xB6:
-			cpuInstructionORI(cpu, cpu->readMemory(cpu->memory, cpuReadRegisterPair(cpu, rH, rL)));
-
-			cpu->cycleCounter += 7;
+			cpuInstructionORI(cpu, cpuRead(cpu, cpuReadRegisterPair(cpu, rH, rL)));
 
 			break;
 
@@ -1857,63 +1603,47 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 		case 0xB7:
 			cpuInstructionORI(cpu, cpu->registers[rA]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* CMP B  */
 		case 0xB8:
 			cpuInstructionCPI(cpu, cpu->registers[rB]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* CMP C  */
 		case 0xB9:
 			cpuInstructionCPI(cpu, cpu->registers[rC]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* CMP D  */
 		case 0xBA:
 			cpuInstructionCPI(cpu, cpu->registers[rD]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* CMP E  */
 		case 0xBB:
 			cpuInstructionCPI(cpu, cpu->registers[rE]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* CMP H  */
 		case 0xBC:
 			cpuInstructionCPI(cpu, cpu->registers[rH]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* CMP L  */
 		case 0xBD:
 			cpuInstructionCPI(cpu, cpu->registers[rL]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* CMP M */ 
 		case 0xBE:
-			cpuInstructionCPI(cpu, cpu->readMemory(cpu->memory, cpuReadRegisterPair(cpu, rH, rL)));
-
-			cpu->cycleCounter += 7;
+			cpuInstructionCPI(cpu, cpuRead(cpu, cpuReadRegisterPair(cpu, rH, rL)));
 
 			break;
 
@@ -1921,8 +1651,6 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 		case 0xBF:
 			cpuInstructionCPI(cpu, cpu->registers[rA]);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* RNZ */
@@ -1935,33 +1663,28 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 		case 0xC1:
 			cpuWriteWordToRegisterPair(cpu, rB, rC, cpuPopFromStack(cpu));
 
-			cpu->cycleCounter += 10;
-
 			break;
 
 
 		/* JNZ a16 */
 		case 0xC2:
 			cpuJumpIf(cpu, !isBitSet(cpu->registers[rSTATUS], 6), 
-					cpu->readMemory(cpu->memory, cpu->programCounter + 1) << 8 | cpu->readMemory(cpu->memory, cpu->programCounter));
-
-			cpu->cycleCounter += 10;
+					cpuRead(cpu, cpu->programCounter + 1) << 8 | cpuRead(cpu, cpu->programCounter));
 
 			break;
 
-		/* JMP a16 */
+		/* JMP a16 and its undocumented alias */
 		case 0xC3:
-			cpuJumpToAddr(cpu, cpu->readMemory(cpu->memory, cpu->programCounter + 1) << 8 |
-					cpu->readMemory(cpu->memory, cpu->programCounter));
-
-			cpu->cycleCounter += 10;
+		case 0xCB:
+			cpuJumpToAddr(cpu, cpuRead(cpu, cpu->programCounter + 1) << 8 |
+					cpuRead(cpu, cpu->programCounter));
 
 			break;
 
 		/* CNZ a16 */
 		case 0xC4:
 			cpuCallIf(cpu, !isBitSet(cpu->registers[rSTATUS], zeroF),
-					cpu->readMemory(cpu->memory, cpu->programCounter + 1) << 8 | cpu->readMemory(cpu->memory, cpu->programCounter));
+					cpuRead(cpu, cpu->programCounter + 1) << 8 | cpuRead(cpu, cpu->programCounter));
 
 			break;
 
@@ -1969,21 +1692,24 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 		case 0xC5:
 			cpuPushToStack(cpu, cpu->registers[rB] << 8 | cpu->registers[rC]);
 
-			cpu->cycleCounter += 11;
-
 			break;
 
 		/* ADI d8*/
 		case 0xC6:
-			cpuInstructionADI(cpu, cpu->readMemory(cpu->memory, cpu->programCounter++));
-
-			cpu->cycleCounter += 7;
+			cpuInstructionADI(cpu, cpuRead(cpu, cpu->programCounter++));
 
 			break;
 
-		/* RST 0 */
+		/* RST n */
 		case 0xC7:
-			cpuInstructionCALL(cpu, 0x0000);
+		case 0xCF:
+		case 0xD7:
+		case 0xDF:
+		case 0xE7:
+		case 0xEF:
+		case 0xF7:
+		case 0xFF:
+			cpuInstructionRST(cpu, opcode & 0x38);
 
 			break;
 
@@ -1993,45 +1719,41 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 
 			break;
 
-		/* RET */
+		/* RET and its undocumented alias */
 		case 0xC9:
+		case 0xD9:
 			cpuInstructionRET(cpu);
 
-			cpu->cycleCounter += 10;
-
 			break;
 
 		/* JZ a16 */
 		case 0xCA:
 			cpuJumpIf(cpu, isBitSet(cpu->registers[rSTATUS], 6), 
-					cpu->readMemory(cpu->memory, cpu->programCounter + 1) << 8 | cpu->readMemory(cpu->memory, cpu->programCounter));
-
-			cpu->cycleCounter += 10;
+					cpuRead(cpu, cpu->programCounter + 1) << 8 | cpuRead(cpu, cpu->programCounter));
 
 			break;
 
 		/* CZ a16 */
 		case 0xCC:
 			cpuCallIf(cpu, isBitSet(cpu->registers[rSTATUS], zeroF),
-					cpu->readMemory(cpu->memory, cpu->programCounter + 1) << 8 | cpu->readMemory(cpu->memory, cpu->programCounter));
+					cpuRead(cpu, cpu->programCounter + 1) << 8 | cpuRead(cpu, cpu->programCounter));
 
 			break;
 
 
-		/* CALL a16 */
+		/* CALL a16 and its undocumented aliases */
 		case 0xCD:
-			cpuInstructionCALL(cpu, cpu->readMemory(cpu->memory, cpu->programCounter + 1) << 8 |
-						cpu->readMemory(cpu->memory, cpu->programCounter));
-
-			cpu->cycleCounter += 17;
+		case 0xDD:
+		case 0xED:
+		case 0xFD:
+			cpuInstructionCALL(cpu, cpuRead(cpu, cpu->programCounter + 1) << 8 |
+						cpuRead(cpu, cpu->programCounter));
 
 			break;
 
 		/* ACI d8 */
 		case 0xCE:
-			cpuInstructionACI(cpu, cpu->readMemory(cpu->memory, cpu->programCounter++));
-
-			cpu->cycleCounter += 7;
+			cpuInstructionACI(cpu, cpuRead(cpu, cpu->programCounter++));
 
 			break;
 
@@ -2045,32 +1767,27 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 		case 0xD1:
 			cpuWriteWordToRegisterPair(cpu, rD, rE, cpuPopFromStack(cpu));
 
-			cpu->cycleCounter += 10;
-
 			break;
 
 		/* JNC a16 */
 		case 0xD2:
 			cpuJumpIf(cpu, !isBitSet(cpu->registers[rSTATUS], 0), 
-					cpu->readMemory(cpu->memory, cpu->programCounter + 1) << 8 | cpu->readMemory(cpu->memory, cpu->programCounter));
-
-			cpu->cycleCounter += 10;
+					cpuRead(cpu, cpu->programCounter + 1) << 8 | cpuRead(cpu, cpu->programCounter));
 
 			break;
 
 		/* OUT d8 */
 		case 0xD3:
-			cpu->portOut(cpu, cpu->readMemory(cpu->memory, cpu->programCounter));
+			temp = cpuRead(cpu, cpu->programCounter++);
 
-			cpu->programCounter++;
-			cpu->cycleCounter += 10;
+			cpu->portOut(cpu, temp, cpu->registers[rA]);
 
 			break;
 
 		/* CNC a16 */
 		case 0xD4:
 			cpuCallIf(cpu, !isBitSet(cpu->registers[rSTATUS], carryF),
-					cpu->readMemory(cpu->memory, cpu->programCounter + 1) << 8 | cpu->readMemory(cpu->memory, cpu->programCounter));
+					cpuRead(cpu, cpu->programCounter + 1) << 8 | cpuRead(cpu, cpu->programCounter));
 
 			break;
 
@@ -2078,15 +1795,11 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 		case 0xD5:
 			cpuPushToStack(cpu, cpu->registers[rD] << 8 | cpu->registers[rE]);
 
-			cpu->cycleCounter += 11;
-
 			break;
 
 		/* SUI d8 */
 		case 0xD6:
-			cpuInstructionSUI(cpu, cpu->readMemory(cpu->memory, cpu->programCounter++));
-
-			cpu->cycleCounter += 7;
+			cpuInstructionSUI(cpu, cpuRead(cpu, cpu->programCounter++));
 
 			break;
 
@@ -2099,31 +1812,26 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 		/* JC a16 */
 		case 0xDA:
 			cpuJumpIf(cpu, isBitSet(cpu->registers[rSTATUS], 0), 
-					cpu->readMemory(cpu->memory, cpu->programCounter + 1) << 8 | cpu->readMemory(cpu->memory, cpu->programCounter));
-
-			cpu->cycleCounter += 10;
+					cpuRead(cpu, cpu->programCounter + 1) << 8 | cpuRead(cpu, cpu->programCounter));
 
 			break;
 
 		/* IN d8 */
 		case 0xDB:
-			cpu->registers[rA] = cpu->portIn(cpu, cpu->readMemory(cpu->memory, (cpu->programCounter)++));
-			cpu->cycleCounter += 10;
+			cpu->registers[rA] = cpu->portIn(cpu, cpuRead(cpu, (cpu->programCounter)++));
 
 			break;
 
 		/* CC a16 */
 		case 0xDC:
 			cpuCallIf(cpu, isBitSet(cpu->registers[rSTATUS], carryF),
-					cpu->readMemory(cpu->memory, cpu->programCounter + 1) << 8 | cpu->readMemory(cpu->memory, cpu->programCounter));
+					cpuRead(cpu, cpu->programCounter + 1) << 8 | cpuRead(cpu, cpu->programCounter));
 
 			break;
 
 		/* SBI d8 */
 		case 0xDE:
-			cpuInstructionSBI(cpu, cpu->readMemory(cpu->memory, cpu->programCounter++));
-
-			cpu->cycleCounter += 7;
+			cpuInstructionSBI(cpu, cpuRead(cpu, cpu->programCounter++));
 
 			break;
 
@@ -2137,16 +1845,12 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 		case 0xE1:
 			cpuWriteWordToRegisterPair(cpu, rH, rL, cpuPopFromStack(cpu));
 
-			cpu->cycleCounter += 10;
-
 			break;
 
 		/* JPO a16 */
 		case 0xE2:
 			cpuJumpIf(cpu, !isBitSet(cpu->registers[rSTATUS], 2), 
-					cpu->readMemory(cpu->memory, cpu->programCounter + 1) << 8 | cpu->readMemory(cpu->memory, cpu->programCounter));
-
-			cpu->cycleCounter += 10;
+					cpuRead(cpu, cpu->programCounter + 1) << 8 | cpuRead(cpu, cpu->programCounter));
 
 			break;
 
@@ -2154,22 +1858,20 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 		case 0xE3:
 			temp = cpu->registers[rH];
 
-			cpu->registers[rH] = cpu->readMemory(cpu->memory, cpu->stackPointer + 1);
+			cpu->registers[rH] = cpuRead(cpu, cpu->stackPointer + 1);
 			cpu->writeMemory(cpu->memory, cpu->stackPointer + 1, temp);
 
 			temp = cpu->registers[rL];
 
-			cpu->registers[rL] = cpu->readMemory(cpu->memory, cpu->stackPointer);
+			cpu->registers[rL] = cpuRead(cpu, cpu->stackPointer);
 			cpu->writeMemory(cpu->memory, cpu->stackPointer, temp);
 
-			cpu->cycleCounter += 18;
-
 			break;
 
 		/* CPO a16 */
 		case 0xE4:
 			cpuCallIf(cpu, !isBitSet(cpu->registers[rSTATUS], parityF),
-					cpu->readMemory(cpu->memory, cpu->programCounter + 1) << 8 | cpu->readMemory(cpu->memory, cpu->programCounter));
+					cpuRead(cpu, cpu->programCounter + 1) << 8 | cpuRead(cpu, cpu->programCounter));
 
 			break;
 
@@ -2177,15 +1879,11 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 		case 0xE5:
 			cpuPushToStack(cpu, cpu->registers[rH] << 8 | cpu->registers[rL]);
 
-			cpu->cycleCounter += 11;
-
 			break;
 
 		/* ANI d8 */
 		case 0xE6:
-			cpuInstructionANI(cpu, cpu->readMemory(cpu->memory, cpu->programCounter++));
-
-			cpu->cycleCounter += 7;
+			cpuInstructionANI(cpu, cpuRead(cpu, cpu->programCounter++));
 
 			break;
 
@@ -2199,16 +1897,12 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 		case 0xE9:
 			cpu->programCounter = cpuReadRegisterPair(cpu, rH, rL);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* JPE a16 */
 		case 0xEA:
 			cpuJumpIf(cpu, isBitSet(cpu->registers[rSTATUS], 2), 
-					cpu->readMemory(cpu->memory, cpu->programCounter + 1) << 8 | cpu->readMemory(cpu->memory, cpu->programCounter));
-
-			cpu->cycleCounter += 10;
+					cpuRead(cpu, cpu->programCounter + 1) << 8 | cpuRead(cpu, cpu->programCounter));
 
 			break;
 
@@ -2216,22 +1910,18 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 		case 0xEB:
 			cpuInstructionXCHG(cpu);
 
-			cpu->cycleCounter += 4;
-
 			break;
 
 		/* CPE a16 */
 		case 0xEC:
 			cpuCallIf(cpu, isBitSet(cpu->registers[rSTATUS], parityF),
-					cpu->readMemory(cpu->memory, cpu->programCounter + 1) << 8 | cpu->readMemory(cpu->memory, cpu->programCounter));
+					cpuRead(cpu, cpu->programCounter + 1) << 8 | cpuRead(cpu, cpu->programCounter));
 
 			break;
 
 		/* XRI d8 */
 		case 0xEE:
-			cpuInstructionXRI(cpu, cpu->readMemory(cpu->memory, cpu->programCounter++));
-
-			cpu->cycleCounter += 7;
+			cpuInstructionXRI(cpu, cpuRead(cpu, cpu->programCounter++));
 
 			break;
 
@@ -2245,31 +1935,25 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 		case 0xF1:
 			cpuWriteWordToRegisterPair(cpu, rA, rSTATUS, (cpuPopFromStack(cpu) & 0xFFD7) | 0x0002);
 
-			cpu->cycleCounter += 10;
-
 			break;
 
 		/* JP a16 */
 		case 0xF2:
 			cpuJumpIf(cpu, !isBitSet(cpu->registers[rSTATUS], 7), 
-					cpu->readMemory(cpu->memory, cpu->programCounter + 1) << 8 | cpu->readMemory(cpu->memory, cpu->programCounter));
-
-			cpu->cycleCounter += 10;
+					cpuRead(cpu, cpu->programCounter + 1) << 8 | cpuRead(cpu, cpu->programCounter));
 
 			break;
 
 		/* DI */
 		case 0xF3:
-			/* This instruction doesn't do anything in the cpu tests */
-
-			cpu->cycleCounter += 4;
+			cpu->interruptEnable = false;
 
 			break;
 	
 		/* CP a16 */
 		case 0xF4:
 			cpuCallIf(cpu, !isBitSet(cpu->registers[rSTATUS], signF),
-					cpu->readMemory(cpu->memory, cpu->programCounter + 1) << 8 | cpu->readMemory(cpu->memory, cpu->programCounter));
+					cpuRead(cpu, cpu->programCounter + 1) << 8 | cpuRead(cpu, cpu->programCounter));
 
 			break;
 
@@ -2278,15 +1962,11 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 			cpuPushToStack(cpu, cpu->registers[rA] << 8
 					| cpu->registers[rSTATUS] & 0xD7);
 
-			cpu->cycleCounter += 11;
-
 			break;
 
 		/* ORI d8 */
 		case 0xF6:
-			cpuInstructionORI(cpu, cpu->readMemory(cpu->memory, cpu->programCounter++));
-
-			cpu->cycleCounter += 7;
+			cpuInstructionORI(cpu, cpuRead(cpu, cpu->programCounter++));
 
 			break;
 
@@ -2300,47 +1980,141 @@ void cpuExecuteInstruction(struct cpu8080 *cpu) {
 		case 0xF9:
 			cpu->stackPointer = cpuReadRegisterPair(cpu, rH, rL);
 
-			cpu->cycleCounter += 5;
-
 			break;
 
 		/* JM a16 */
 		case 0xFA:
 			cpuJumpIf(cpu, isBitSet(cpu->registers[rSTATUS], 7), 
-					cpu->readMemory(cpu->memory, cpu->programCounter + 1) << 8 | cpu->readMemory(cpu->memory, cpu->programCounter));
-
-			cpu->cycleCounter += 10;
+					cpuRead(cpu, cpu->programCounter + 1) << 8 | cpuRead(cpu, cpu->programCounter));
 
 			break;
 
 		/* EI */
 		case 0xFB:
-			/* This instruction doesn't do anything in the cpu tests */
-
-			cpu->cycleCounter += 4;
+			cpu->interruptEnable = true;
+			cpu->interruptDelay = true;
 
 			break;
 
 		/* CM a16 */
 		case 0xFC:
 			cpuCallIf(cpu, isBitSet(cpu->registers[rSTATUS], signF),
-					cpu->readMemory(cpu->memory, cpu->programCounter + 1) << 8 | cpu->readMemory(cpu->memory, cpu->programCounter));
+					cpuRead(cpu, cpu->programCounter + 1) << 8 | cpuRead(cpu, cpu->programCounter));
 
 			break;
 
 		/* CPI d8  */
 		case 0xFE:
-			cpuInstructionCPI(cpu, cpu->readMemory(cpu->memory, cpu->programCounter++));
-
-			cpu->cycleCounter += 7;
+			cpuInstructionCPI(cpu, cpuRead(cpu, cpu->programCounter++));
 
 			break;
+	}
+}
+
+/* one instruction. it's inlined into the instrumented entry point and into
+ * the turbo engine, which compiles the per instruction hooks away and keeps
+ * the cpu state and the dispatch in one loop. both run the same code, so a
+ * cpu can move between them at any instruction boundary */
+static inline __attribute__((always_inline)) void cpuExecute(struct cpu8080 *cpu, bool instrumented) {
+	uint16_t start;
+	uint8_t opcode;
+
+	/* a breakpoint stops before an interrupt is taken too */
+	if(instrumented && cpu->debugger != NULL && debuggerCheckExecute(cpu->debugger, cpu))
+		return;
+
+	if(cpu->interruptPending || cpu->interruptDelay || cpu->halted) {
+		if(cpuAcceptInterrupt(cpu))
+			return;
+
+		/* only an interrupt gets a halted cpu going again */
+		if(cpu->halted) {
+			cpu->cycleCounter += 4;
+			return;
+		}
+	}
+
+	/* the debugger sees the guest code of hooked routines */
+	if(cpu->hooks != NULL && cpu->debugger == NULL && hooksCheck(cpu->hooks, cpu))
+		return;
 
-		default:
-			puts("unrecognized opcode");
+	start = cpu->programCounter;
+	opcode = cpuRead(cpu, start);
 
-			printf("opcode: %X at %d\n", opcode, cpu->programCounter);
+	if(instrumented) {
+#ifdef DEBUG 
+	        printCpuState(*cpu);
+#endif
 
-			exit(1);
+		COVERAGE_EXECUTE(cpu, cpu->programCounter);
+		HEATMAP_EXECUTE(cpu->heatmap, cpu->programCounter);
 	}
+
+	cpu->programCounter++;
+
+	cpuDispatch(cpu, opcode);
+
+#ifdef CPU_COVERAGE
+	/* an instruction that didn't go on to the next one branched. it's
+	 * recorded here rather than in the dispatch, where the turbo engine
+	 * would record it from a stale source */
+	if(instrumented && cpu->programCounter != (uint16_t)(start + opcodeTable[opcode].length))
+		COVERAGE_BRANCH(cpu, cpu->programCounter);
+#endif
+}
+
+void cpuExecuteInstruction(struct cpu8080 *cpu) {
+	cpuExecute(cpu, true);
+}
+
+void cpuTurboStep(struct cpu8080 *cpu) {
+	cpuExecute(cpu, false);
+}
+
+void cpuTurboRun(struct cpu8080 *cpu, size_t cycles) {
+	size_t target;
+
+	target = cpu->cycleCounter + cycles;
+
+	while(cpu->cycleCounter < target && cpu->signalBuffer == noSignal)
+		cpuExecute(cpu, false);
+}
+
+#ifdef CPU_AOT
+/* a rom translated ahead of time by i8080-aot, built in with
+ * -DCPU_AOT='"translation.c"'. every block the translator recovered runs
+ * its instructions straight through, each one the dispatch cut down to
+ * its opcode, and goes on to the next block by goto where the target is
+ * known. a block is compared against the bytes it was translated from
+ * before it runs and after every store in it, code that changed and
+ * everything the translator didn't find goes through cpuExecute */
+
+/* the dispatch specialized to every opcode once, translations only call
+ * these instead of inlining the whole switch at every instruction */
+#define OPCODE(opcode, mnemonic, length, cycles, cyclesNotTaken, flags, flow, undocumented) \
+	static inline void cpuAotExecute##opcode(struct cpu8080 *cpu) { cpuDispatch(cpu, opcode); }
+#include "opcodes.def"
+#undef OPCODE
+
+/* the cpu has to go back to the dispatch after this instruction, it stops
+ * at the same instruction boundary as every other engine */
+#define AOT_LEFT(cpu, target)	((cpu)->cycleCounter >= (target) || (cpu)->signalBuffer != noSignal \
+		|| (cpu)->interruptPending || (cpu)->interruptDelay)
+/* a block can go straight on to the next one */
+#define AOT_GO_ON(cpu, target)	(!AOT_LEFT(cpu, target) && !(cpu)->halted)
+#define AOT_STEP(cpu)		cpuTurboStep(cpu)
+#define AOT_EXECUTE(cpu, opcode) do { (cpu)->programCounter++; cpuAotExecute##opcode(cpu); } while(0)
+
+#include CPU_AOT
+
+/* the translation reads guest memory directly, anything else (a heatmap,
+ * read watchpoints) runs on turbo */
+void cpuAotRun(struct cpu8080 *cpu, size_t cycles) {
+	if(cpu->readMemory != guestReadMemory) {
+		cpuTurboRun(cpu, cycles);
+		return;
+	}
+
+	aotRun(cpu, cycles);
 }
+#endif /* #ifdef CPU_AOT */
@@ -0,0 +1,501 @@
+#include "cpu_model.h"
+#include "util.h"
+
+/* a second, independent implementation of the 8080 written straight from the
+ * intel 8080 programmer's manual. instructions are decoded by their bit
+ * fields (ddd/sss registers, rp pairs, ccc conditions, alu operation) instead
+ * of one case per opcode, so it shares no code with the reference
+ * interpreter. it is slow and only meant to check the other engines */
+
+#define MODEL_M		6	/* sss/ddd = 110 is the memory operand */
+#define MODEL_STATUS_MASK	(1 << signF | 1 << zeroF | 1 << auxCarryF | 1 << parityF | 1 << carryF)
+
+/* cycles per opcode, taken conditional calls and returns add 6 */
+static const uint8_t modelCycles[256] = {
+	 4, 10,  7,  5,  5,  5,  7,  4,  4, 10,  7,  5,  5,  5,  7,  4,
+	 4, 10,  7,  5,  5,  5,  7,  4,  4, 10,  7,  5,  5,  5,  7,  4,
+	 4, 10, 16,  5,  5,  5,  7,  4,  4, 10, 16,  5,  5,  5,  7,  4,
+	 4, 10, 13,  5, 10, 10, 10,  4,  4, 10, 13,  5,  5,  5,  7,  4,
+	 5,  5,  5,  5,  5,  5,  7,  5,  5,  5,  5,  5,  5,  5,  7,  5,
+	 5,  5,  5,  5,  5,  5,  7,  5,  5,  5,  5,  5,  5,  5,  7,  5,
+	 5,  5,  5,  5,  5,  5,  7,  5,  5,  5,  5,  5,  5,  5,  7,  5,
+	 7,  7,  7,  7,  7,  7,  7,  7,  5,  5,  5,  5,  5,  5,  7,  5,
+	 4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4,
+	 4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4,
+	 4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4,
+	 4,  4,  4,  4,  4,  4,  7,  4,  4,  4,  4,  4,  4,  4,  7,  4,
+	 5, 10, 10, 10, 11, 11,  7, 11,  5, 10, 10, 10, 11, 17,  7, 11,
+	 5, 10, 10, 10, 11, 11,  7, 11,  5, 10, 10, 10, 11, 17,  7, 11,
+	 5, 10, 10, 18, 11, 11,  7, 11,  5,  5, 10,  4, 11, 17,  7, 11,
+	 5, 10, 10,  4, 11, 11,  7, 11,  5,  5, 10,  4, 11, 17,  7, 11,
+};
+
+static uint8_t modelFetch(struct cpu8080 *cpu) {
+	return cpu->readMemory(cpu->memory, cpu->programCounter++);
+}
+
+static uint16_t modelFetchWord(struct cpu8080 *cpu) {
+	uint8_t low;
+
+	low = modelFetch(cpu);
+
+	return modelFetch(cpu) << 8 | low;
+}
+
+static uint16_t modelHL(struct cpu8080 *cpu) {
+	return cpu->registers[rH] << 8 | cpu->registers[rL];
+}
+
+/* ddd/sss: B C D E H L M A */
+static uint8_t modelGet(struct cpu8080 *cpu, uint8_t field) {
+	if(field == MODEL_M)
+		return cpu->readMemory(cpu->memory, modelHL(cpu));
+
+	return cpu->registers[field == 7 ? rA : field];
+}
+
+static void modelSet(struct cpu8080 *cpu, uint8_t field, uint8_t value) {
+	if(field == MODEL_M)
+		cpu->writeMemory(cpu->memory, modelHL(cpu), value);
+	else
+		cpu->registers[field == 7 ? rA : field] = value;
+}
+
+/* rp: BC DE HL SP */
+static uint16_t modelGetPair(struct cpu8080 *cpu, uint8_t pair) {
+	if(pair == 3)
+		return cpu->stackPointer;
+
+	return cpu->registers[pair * 2] << 8 | cpu->registers[pair * 2 + 1];
+}
+
+static void modelSetPair(struct cpu8080 *cpu, uint8_t pair, uint16_t value) {
+	if(pair == 3)
+		cpu->stackPointer = value;
+	else {
+		cpu->registers[pair * 2] = value >> 8;
+		cpu->registers[pair * 2 + 1] = value & 0xFF;
+	}
+}
+
+static bool modelFlag(struct cpu8080 *cpu, uint8_t flag) {
+	return isBitSet(cpu->registers[rSTATUS], flag);
+}
+
+static void modelSetFlag(struct cpu8080 *cpu, uint8_t flag, bool value) {
+	clearOrSetBit(&cpu->registers[rSTATUS], flag, value);
+}
+
+/* sign, zero and parity of a result, bit 1 always reads as 1 and bits 3 and
+ * 5 as 0 */
+static void modelSetSZP(struct cpu8080 *cpu, uint8_t value) {
+	uint8_t ones, i;
+
+	for(ones = 0, i = 0; i < 8; i++)
+		ones += isBitSet(value, i);
+
+	cpu->registers[rSTATUS] = (cpu->registers[rSTATUS] & MODEL_STATUS_MASK) | 0x02;
+
+	modelSetFlag(cpu, signF, value & 0x80);
+	modelSetFlag(cpu, zeroF, value == 0);
+	modelSetFlag(cpu, parityF, ones % 2 == 0);
+}
+
+/* ccc: NZ Z NC C PO PE P M */
+static bool modelCondition(struct cpu8080 *cpu, uint8_t condition) {
+	static const uint8_t flags[4] = { zeroF, carryF, parityF, signF };
+
+	return modelFlag(cpu, flags[condition >> 1]) == (condition & 1);
+}
+
+static void modelPush(struct cpu8080 *cpu, uint16_t value) {
+	cpu->stackPointer -= 2;
+	cpu->writeMemoryWord(cpu->memory, cpu->stackPointer, value);
+}
+
+static uint16_t modelPop(struct cpu8080 *cpu) {
+	uint16_t value;
+
+	value = cpu->readMemoryWord(cpu->memory, cpu->stackPointer);
+	cpu->stackPointer += 2;
+
+	return value;
+}
+
+/* the 8080 subtracts by adding the complement, so the auxiliary carry of a
+ * subtraction is the carry out of bit 3 of that addition */
+static uint8_t modelAdd(struct cpu8080 *cpu, uint8_t a, uint8_t b, bool carry) {
+	uint16_t result;
+
+	result = a + b + carry;
+
+	modelSetSZP(cpu, result & 0xFF);
+	modelSetFlag(cpu, carryF, result > 0xFF);
+	modelSetFlag(cpu, auxCarryF, (a & 0x0F) + (b & 0x0F) + carry > 0x0F);
+
+	return result & 0xFF;
+}
+
+static uint8_t modelSubtract(struct cpu8080 *cpu, uint8_t a, uint8_t b, bool borrow) {
+	uint8_t result;
+
+	result = modelAdd(cpu, a, ~b, !borrow);
+	modelSetFlag(cpu, carryF, !modelFlag(cpu, carryF));
+
+	return result;
+}
+
+/* alu: ADD ADC SUB SBB ANA XRA ORA CMP */
+static void modelAlu(struct cpu8080 *cpu, uint8_t operation, uint8_t value) {
+	uint8_t a;
+
+	a = cpu->registers[rA];
+
+	switch(operation) {
+		case 0: a = modelAdd(cpu, a, value, false); break;
+		case 1: a = modelAdd(cpu, a, value, modelFlag(cpu, carryF)); break;
+		case 2: a = modelSubtract(cpu, a, value, false); break;
+		case 3: a = modelSubtract(cpu, a, value, modelFlag(cpu, carryF)); break;
+		case 7: modelSubtract(cpu, a, value, false); break;
+
+		case 4:
+			modelSetSZP(cpu, a & value);
+			modelSetFlag(cpu, auxCarryF, (a | value) & 0x08);
+			modelSetFlag(cpu, carryF, false);
+			a &= value;
+			break;
+
+		default:
+			a = operation == 5 ? a ^ value : a | value;
+			modelSetSZP(cpu, a);
+			modelSetFlag(cpu, auxCarryF, false);
+			modelSetFlag(cpu, carryF, false);
+			break;
+	}
+
+	cpu->registers[rA] = a;
+}
+
+static void modelRotate(struct cpu8080 *cpu, uint8_t operation) {
+	uint8_t a;
+	bool carry;
+
+	a = cpu->registers[rA];
+	carry = modelFlag(cpu, carryF);
+
+	switch(operation) {
+		/* RLC */
+		case 0: carry = a >> 7; a = a << 1 | carry; break;
+		/* RRC */
+		case 1: carry = a & 1; a = a >> 1 | carry << 7; break;
+		/* RAL */
+		case 2: a = a << 1 | carry; carry = cpu->registers[rA] >> 7; break;
+		/* RAR */
+		case 3: a = a >> 1 | carry << 7; carry = cpu->registers[rA] & 1; break;
+	}
+
+	cpu->registers[rA] = a;
+	modelSetFlag(cpu, carryF, carry);
+}
+
+static void modelDAA(struct cpu8080 *cpu) {
+	uint8_t a, correction;
+	bool carry;
+
+	a = cpu->registers[rA];
+	correction = 0;
+	carry = modelFlag(cpu, carryF);
+
+	if((a & 0x0F) > 9 || modelFlag(cpu, auxCarryF))
+		correction |= 0x06;
+
+	if(a > 0x99 || carry) {
+		correction |= 0x60;
+		carry = true;
+	}
+
+	cpu->registers[rA] = modelAdd(cpu, a, correction, false);
+	modelSetFlag(cpu, carryF, carry);
+}
+
+/* 00 xxx xxx */
+static void modelGroup0(struct cpu8080 *cpu, uint8_t opcode) {
+	uint8_t ddd, pair, value;
+	uint16_t address;
+	uint32_t sum;
+	bool carry;
+
+	ddd = opcode >> 3 & 7;
+	pair = opcode >> 4 & 3;
+
+	switch(opcode & 7) {
+		/* NOP and its aliases */
+		case 0:
+			break;
+
+		/* LXI rp / DAD rp */
+		case 1:
+			if(opcode & 0x08) {
+				sum = modelHL(cpu) + modelGetPair(cpu, pair);
+				modelSetPair(cpu, 2, sum);
+				modelSetFlag(cpu, carryF, sum > 0xFFFF);
+			}
+			else
+				modelSetPair(cpu, pair, modelFetchWord(cpu));
+			break;
+
+		/* STAX/LDAX B, D, SHLD, LHLD, STA, LDA */
+		case 2:
+			if(pair < 2) {
+				address = modelGetPair(cpu, pair);
+
+				if(opcode & 0x08)
+					cpu->registers[rA] = cpu->readMemory(cpu->memory, address);
+				else
+					cpu->writeMemory(cpu->memory, address, cpu->registers[rA]);
+			}
+			else {
+				address = modelFetchWord(cpu);
+
+				if(pair == 2 && opcode & 0x08)
+					modelSetPair(cpu, 2, cpu->readMemoryWord(cpu->memory, address));
+				else if(pair == 2)
+					cpu->writeMemoryWord(cpu->memory, address, modelHL(cpu));
+				else if(opcode & 0x08)
+					cpu->registers[rA] = cpu->readMemory(cpu->memory, address);
+				else
+					cpu->writeMemory(cpu->memory, address, cpu->registers[rA]);
+			}
+			break;
+
+		/* INX rp / DCX rp */
+		case 3:
+			modelSetPair(cpu, pair, modelGetPair(cpu, pair) + (opcode & 0x08 ? -1 : 1));
+			break;
+
+		/* INR/DCR leave the carry alone */
+		case 4:
+		case 5:
+			carry = modelFlag(cpu, carryF);
+			value = modelGet(cpu, ddd) + ((opcode & 7) == 4 ? 1 : -1);
+
+			modelSetSZP(cpu, value);
+			modelSetFlag(cpu, auxCarryF, (opcode & 7) == 4 ?
+					(value & 0x0F) == 0 : (value & 0x0F) != 0x0F);
+			modelSetFlag(cpu, carryF, carry);
+
+			modelSet(cpu, ddd, value);
+			break;
+
+		/* MVI */
+		case 6:
+			modelSet(cpu, ddd, modelFetch(cpu));
+			break;
+
+		/* RLC RRC RAL RAR DAA CMA STC CMC */
+		case 7:
+			if(ddd < 4)
+				modelRotate(cpu, ddd);
+			else if(ddd == 4)
+				modelDAA(cpu);
+			else if(ddd == 5)
+				cpu->registers[rA] = ~cpu->registers[rA];
+			else if(ddd == 6)
+				modelSetFlag(cpu, carryF, true);
+			else
+				modelSetFlag(cpu, carryF, !modelFlag(cpu, carryF));
+			break;
+	}
+}
+
+/* 11 xxx xxx */
+static void modelGroup3(struct cpu8080 *cpu, uint8_t opcode) {
+	uint8_t ddd, pair, temp;
+	uint16_t address, value;
+
+	ddd = opcode >> 3 & 7;
+	pair = opcode >> 4 & 3;
+
+	switch(opcode & 7) {
+		/* Rccc */
+		case 0:
+			if(modelCondition(cpu, ddd)) {
+				cpu->programCounter = modelPop(cpu);
+				cpu->cycleCounter += 6;
+			}
+			break;
+
+		/* POP rp / RET PCHL SPHL */
+		case 1:
+			if(!(opcode & 0x08)) {
+				value = modelPop(cpu);
+
+				if(pair == 3) {
+					cpu->registers[rA] = value >> 8;
+					cpu->registers[rSTATUS] = (value & MODEL_STATUS_MASK) | 0x02;
+				}
+				else
+					modelSetPair(cpu, pair, value);
+			}
+			else if(pair < 2)
+				cpu->programCounter = modelPop(cpu);
+			else if(pair == 2)
+				cpu->programCounter = modelHL(cpu);
+			else
+				cpu->stackPointer = modelHL(cpu);
+			break;
+
+		/* Jccc */
+		case 2:
+			address = modelFetchWord(cpu);
+
+			if(modelCondition(cpu, ddd))
+				cpu->programCounter = address;
+			break;
+
+		/* JMP OUT IN XTHL XCHG DI EI */
+		case 3:
+			switch(ddd) {
+				case 0:
+				case 1:
+					cpu->programCounter = modelFetchWord(cpu);
+					break;
+
+				/* port handlers may look at the operand, so the
+				 * program counter only moves past it afterwards */
+				case 2:
+					temp = modelFetch(cpu);
+
+					if(cpu->portOut != NULL)
+						cpu->portOut(cpu, temp, cpu->registers[rA]);
+					break;
+
+				case 3:
+					temp = modelFetch(cpu);
+
+					if(cpu->portIn != NULL)
+						cpu->registers[rA] = cpu->portIn(cpu, temp);
+					break;
+
+				case 4:
+					temp = cpu->registers[rH];
+					cpu->registers[rH] = cpu->readMemory(cpu->memory, cpu->stackPointer + 1);
+					cpu->writeMemory(cpu->memory, cpu->stackPointer + 1, temp);
+
+					temp = cpu->registers[rL];
+					cpu->registers[rL] = cpu->readMemory(cpu->memory, cpu->stackPointer);
+					cpu->writeMemory(cpu->memory, cpu->stackPointer, temp);
+					break;
+
+				case 5:
+					value = modelGetPair(cpu, 1);
+					modelSetPair(cpu, 1, modelHL(cpu));
+					modelSetPair(cpu, 2, value);
+					break;
+
+				case 6:
+					cpu->interruptEnable = false;
+					break;
+
+				/* interrupts are taken after the instruction following EI */
+				case 7:
+					cpu->interruptEnable = true;
+					cpu->interruptDelay = true;
+					break;
+			}
+			break;
+
+		/* Cccc */
+		case 4:
+			address = modelFetchWord(cpu);
+
+			if(modelCondition(cpu, ddd)) {
+				modelPush(cpu, cpu->programCounter);
+				cpu->programCounter = address;
+				cpu->cycleCounter += 6;
+			}
+			break;
+
+		/* PUSH rp / CALL and its aliases */
+		case 5:
+			if(!(opcode & 0x08)) {
+				if(pair == 3)
+					value = cpu->registers[rA] << 8
+						| (cpu->registers[rSTATUS] & MODEL_STATUS_MASK) | 0x02;
+				else
+					value = modelGetPair(cpu, pair);
+
+				modelPush(cpu, value);
+			}
+			else {
+				address = modelFetchWord(cpu);
+				modelPush(cpu, cpu->programCounter);
+				cpu->programCounter = address;
+			}
+			break;
+
+		/* alu immediate */
+		case 6:
+			modelAlu(cpu, ddd, modelFetch(cpu));
+			break;
+
+		/* RST */
+		case 7:
+			modelPush(cpu, cpu->programCounter);
+			cpu->programCounter = ddd << 3;
+			break;
+	}
+}
+
+void cpuModelExecuteInstruction(struct cpu8080 *cpu) {
+	uint8_t opcode;
+
+	if(cpuAcceptInterrupt(cpu))
+		return;
+
+	if(cpu->halted) {
+		cpu->cycleCounter += 4;
+		return;
+	}
+
+	opcode = modelFetch(cpu);
+
+	cpu->cycleCounter += modelCycles[opcode];
+
+	switch(opcode >> 6) {
+		case 0:
+			modelGroup0(cpu, opcode);
+			break;
+
+		/* MOV, 01 110 110 is HLT which waits for an interrupt */
+		case 1:
+			if(opcode == 0x76)
+				cpu->halted = true;
+			else
+				modelSet(cpu, opcode >> 3 & 7, modelGet(cpu, opcode & 7));
+			break;
+
+		case 2:
+			modelAlu(cpu, opcode >> 3 & 7, modelGet(cpu, opcode & 7));
+			break;
+
+		case 3:
+			modelGroup3(cpu, opcode);
+			break;
+	}
+}
+
+static void modelRun(struct cpu8080 *cpu, size_t cycles) {
+	size_t target;
+
+	target = cpu->cycleCounter + cycles;
+
+	while(cpu->cycleCounter < target && cpu->signalBuffer == noSignal)
+		cpuModelExecuteInstruction(cpu);
+}
+
+const struct cpuEngine modelEngine = {
+	.name = "model",
+	.step = cpuModelExecuteInstruction,
+	.run = modelRun,
+};
@@ -0,0 +1,644 @@
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+
+#include "debugger.h"
+#include "guest_memory.h"
+
+/* the memory callbacks only get the memory pointer, the debugger is kept
+ * in the header below it */
+static struct debugger *debuggerOfMemory(uint8_t *memory) {
+	return guestMemoryFromBase(memory)->debugger;
+}
+
+static uint16_t debuggerOperand(struct cpu8080 *cpu, const struct debugCondition *condition,
+		uint16_t address, uint8_t data) {
+	switch(condition->operand) {
+		case debugOperandRegister:
+			return cpu->registers[condition->index];
+
+		case debugOperandPair:
+			if(condition->index == debugPairSP)
+				return cpu->stackPointer;
+
+			if(condition->index == debugPairPC)
+				return cpu->programCounter;
+
+			return cpu->registers[condition->index] << 8 | cpu->registers[condition->index + 1];
+
+		case debugOperandFlag:
+			return cpu->registers[rSTATUS] >> condition->index & 1;
+
+		case debugOperandData:
+			return data;
+
+		default:
+			return address;
+	}
+}
+
+static bool debuggerConditionHolds(struct cpu8080 *cpu, const struct debugCondition *condition,
+		uint16_t address, uint8_t data) {
+	uint16_t value;
+
+	value = debuggerOperand(cpu, condition, address, data);
+
+	switch(condition->comparison) {
+		case debugEqual:
+			return value == condition->value;
+		case debugNotEqual:
+			return value != condition->value;
+		case debugLess:
+			return value < condition->value;
+		case debugLessEqual:
+			return value <= condition->value;
+		case debugGreater:
+			return value > condition->value;
+		case debugGreaterEqual:
+			return value >= condition->value;
+		default:
+			return (value & condition->value) != 0;
+	}
+}
+
+/* the slow path, the page of address has points of this kind */
+static bool debuggerMatch(struct debugger *debugger, uint8_t kind, uint16_t address, uint8_t data) {
+	struct debugPoint *point;
+	size_t i, j;
+
+	for(i = 0; i < DEBUGGER_MAX_POINTS; i++) {
+		point = &debugger->points[i];
+
+		if(!point->used || !(point->accesses & 1 << kind) || address < point->first || address > point->last)
+			continue;
+
+		for(j = 0; j < point->nConditions; j++) {
+			if(!debuggerConditionHolds(debugger->cpu, &point->conditions[j], address, data))
+				break;
+		}
+
+		if(j != point->nConditions)
+			continue;
+
+		point->hits++;
+
+		debugger->hit.point = i;
+		debugger->hit.access = 1 << kind;
+		debugger->hit.address = address;
+		debugger->hit.data = data;
+
+		debugger->cpu->signalBuffer = breakpointSignal;
+
+		return true;
+	}
+
+	return false;
+}
+
+static void debuggerCheckMemory(struct debugger *debugger, uint8_t kind, uint16_t address, uint8_t data) {
+	if(debugger->pages[kind][address >> DEBUGGER_PAGE_SHIFT] != 0)
+		debuggerMatch(debugger, kind, address, data);
+}
+
+static uint8_t debuggerReadMemory(uint8_t *memory, uint16_t address) {
+	struct debugger *debugger;
+	uint8_t data;
+
+	debugger = debuggerOfMemory(memory);
+	data = debugger->readMemory(memory, address);
+
+	debuggerCheckMemory(debugger, debugKindRead, address, data);
+
+	return data;
+}
+
+static uint16_t debuggerReadMemoryWord(uint8_t *memory, uint16_t address) {
+	struct debugger *debugger;
+	uint16_t data;
+
+	debugger = debuggerOfMemory(memory);
+	data = debugger->readMemoryWord(memory, address);
+
+	debuggerCheckMemory(debugger, debugKindRead, address, data & 0xFF);
+	debuggerCheckMemory(debugger, debugKindRead, address + 1, data >> 8);
+
+	return data;
+}
+
+static void debuggerWriteMemory(uint8_t *memory, uint16_t address, uint8_t data) {
+	struct debugger *debugger;
+
+	debugger = debuggerOfMemory(memory);
+	debugger->writeMemory(memory, address, data);
+
+	debuggerCheckMemory(debugger, debugKindWrite, address, data);
+}
+
+static void debuggerWriteMemoryWord(uint8_t *memory, uint16_t address, uint16_t data) {
+	struct debugger *debugger;
+
+	debugger = debuggerOfMemory(memory);
+	debugger->writeMemoryWord(memory, address, data);
+
+	debuggerCheckMemory(debugger, debugKindWrite, address, data & 0xFF);
+	debuggerCheckMemory(debugger, debugKindWrite, address + 1, data >> 8);
+}
+
+static uint8_t debuggerPortIn(struct cpu8080 *cpu, uint8_t port) {
+	struct debugger *debugger;
+	uint8_t data;
+
+	debugger = debuggerOfMemory(cpu->memory);
+	data = debugger->portIn != NULL ? debugger->portIn(cpu, port) : 0xFF;
+
+	if(debugger->pages[debugKindPortIn][port] != 0)
+		debuggerMatch(debugger, debugKindPortIn, port, data);
+
+	return data;
+}
+
+static void debuggerPortOut(struct cpu8080 *cpu, uint8_t port, uint8_t data) {
+	struct debugger *debugger;
+
+	debugger = debuggerOfMemory(cpu->memory);
+
+	/* a signal the device raises wins over the watchpoint */
+	if(debugger->pages[debugKindPortOut][port] != 0)
+		debuggerMatch(debugger, debugKindPortOut, port, data);
+
+	if(debugger->portOut != NULL)
+		debugger->portOut(cpu, port, data);
+}
+
+/* installs the wrappers the armed points need and takes the others out */
+static void debuggerRewire(struct debugger *debugger) {
+	struct cpu8080 *cpu;
+
+	cpu = debugger->cpu;
+
+	cpu->readMemory = debugger->armed[debugKindRead] ? debuggerReadMemory : debugger->readMemory;
+	cpu->readMemoryWord = debugger->armed[debugKindRead] ? debuggerReadMemoryWord : debugger->readMemoryWord;
+	cpu->writeMemory = debugger->armed[debugKindWrite] ? debuggerWriteMemory : debugger->writeMemory;
+	cpu->writeMemoryWord = debugger->armed[debugKindWrite] ? debuggerWriteMemoryWord : debugger->writeMemoryWord;
+	cpu->portIn = debugger->armed[debugKindPortIn] ? debuggerPortIn : debugger->portIn;
+	cpu->portOut = debugger->armed[debugKindPortOut] ? debuggerPortOut : debugger->portOut;
+
+	if(debugger->armed[debugKindExecute] != 0 || debugger->stepping)
+		cpu->debugger = debugger;
+	else {
+		cpu->debugger = NULL;
+		debugger->skip = false;
+	}
+}
+
+/* the cpu's callbacks have to be set, they are wrapped while points are
+ * armed. one debugger per cpu, its memory has to be a guestMemory */
+void debuggerAttach(struct debugger *debugger, struct cpu8080 *cpu) {
+	memset(debugger, 0, sizeof(*debugger));
+
+	debugger->cpu = cpu;
+	debugger->hit.point = DEBUGGER_MAX_POINTS;
+
+	debugger->readMemory = cpu->readMemory;
+	debugger->readMemoryWord = cpu->readMemoryWord;
+	debugger->writeMemory = cpu->writeMemory;
+	debugger->writeMemoryWord = cpu->writeMemoryWord;
+	debugger->portOut = cpu->portOut;
+	debugger->portIn = cpu->portIn;
+
+	guestMemoryFromBase(cpu->memory)->debugger = debugger;
+}
+
+/* puts the cpu's callbacks back */
+void debuggerDetach(struct debugger *debugger) {
+	memset(debugger->armed, 0, sizeof(debugger->armed));
+	debugger->stepping = false;
+	debuggerRewire(debugger);
+
+	guestMemoryFromBase(debugger->cpu->memory)->debugger = NULL;
+}
+
+static void debuggerCount(struct debugger *debugger, struct debugPoint *point, int delta) {
+	unsigned kind, page, first, last;
+
+	for(kind = 0; kind < debugKinds; kind++) {
+		if(!(point->accesses & 1 << kind))
+			continue;
+
+		/* ports are their own pages */
+		if(kind == debugKindPortIn || kind == debugKindPortOut) {
+			first = point->first & 0xFF;
+			last = point->last > 0xFF ? 0xFF : point->last;
+		}
+		else {
+			first = point->first >> DEBUGGER_PAGE_SHIFT;
+			last = point->last >> DEBUGGER_PAGE_SHIFT;
+		}
+
+		for(page = first; page <= last; page++)
+			debugger->pages[kind][page] += delta;
+
+		debugger->armed[kind] += delta;
+	}
+}
+
+/* returns the number of the point, or -1 if there's no room */
+int debuggerAdd(struct debugger *debugger, uint8_t accesses, uint16_t first, uint16_t last,
+		const struct debugCondition *conditions, size_t nConditions) {
+	struct debugPoint *point;
+	size_t i;
+
+	if(nConditions > DEBUGGER_MAX_CONDITIONS || last < first || accesses == 0)
+		return -1;
+
+	for(i = 0; i < DEBUGGER_MAX_POINTS && debugger->points[i].used; i++)
+		;
+
+	if(i == DEBUGGER_MAX_POINTS)
+		return -1;
+
+	point = &debugger->points[i];
+
+	point->used = true;
+	point->accesses = accesses;
+	point->first = first;
+	point->last = last;
+	point->nConditions = nConditions;
+	point->hits = 0;
+
+	memcpy(point->conditions, conditions, nConditions * sizeof(*conditions));
+
+	debuggerCount(debugger, point, 1);
+	debuggerRewire(debugger);
+
+	return i;
+}
+
+bool debuggerRemove(struct debugger *debugger, size_t point) {
+	if(point >= DEBUGGER_MAX_POINTS || !debugger->points[point].used)
+		return false;
+
+	debuggerCount(debugger, &debugger->points[point], -1);
+	debugger->points[point].used = false;
+
+	debuggerRewire(debugger);
+
+	return true;
+}
+
+/* stops before every instruction while stepping */
+void debuggerStep(struct debugger *debugger, bool stepping) {
+	debugger->stepping = stepping;
+	debuggerRewire(debugger);
+}
+
+/* goes on after a stop, the instruction a breakpoint stopped at runs. a
+ * watchpoint stopped after its instruction, the next one is checked */
+void debuggerResume(struct debugger *debugger) {
+	struct cpu8080 *cpu;
+
+	cpu = debugger->cpu;
+
+	if(cpu->signalBuffer == breakpointSignal)
+		cpu->signalBuffer = noSignal;
+
+	debugger->skip = cpu->debugger != NULL && debugger->hit.access == debugExecute
+		&& debugger->hit.address == cpu->programCounter;
+}
+
+bool debuggerStopAtExecute(struct debugger *debugger, struct cpu8080 *cpu) {
+	if(debugger->pages[debugKindExecute][cpu->programCounter >> DEBUGGER_PAGE_SHIFT] != 0
+			&& debuggerMatch(debugger, debugKindExecute, cpu->programCounter, 0))
+		return true;
+
+	if(!debugger->stepping)
+		return false;
+
+	debugger->hit.point = DEBUGGER_MAX_POINTS;
+	debugger->hit.access = debugExecute;
+	debugger->hit.address = cpu->programCounter;
+	debugger->hit.data = 0;
+
+	cpu->signalBuffer = breakpointSignal;
+
+	return true;
+}
+
+static const struct {
+	const char	*name;
+	uint8_t		operand,
+			index;
+} debugOperandNames[] = {
+	{ "a", debugOperandRegister, rA }, { "b", debugOperandRegister, rB },
+	{ "c", debugOperandRegister, rC }, { "d", debugOperandRegister, rD },
+	{ "e", debugOperandRegister, rE }, { "h", debugOperandRegister, rH },
+	{ "l", debugOperandRegister, rL }, { "f", debugOperandRegister, rSTATUS },
+	{ "bc", debugOperandPair, rB }, { "de", debugOperandPair, rD },
+	{ "hl", debugOperandPair, rH }, { "sp", debugOperandPair, debugPairSP },
+	{ "pc", debugOperandPair, debugPairPC },
+	{ "cy", debugOperandFlag, carryF }, { "p", debugOperandFlag, parityF },
+	{ "ac", debugOperandFlag, auxCarryF }, { "z", debugOperandFlag, zeroF },
+	{ "s", debugOperandFlag, signF },
+	{ "data", debugOperandData, 0 }, { "address", debugOperandAddress, 0 },
+};
+
+static const char *debugComparisonNames[] = {
+	[debugEqual] = "==",
+	[debugNotEqual] = "!=",
+	[debugLess] = "<",
+	[debugLessEqual] = "<=",
+	[debugGreater] = ">",
+	[debugGreaterEqual] = ">=",
+	[debugMask] = "&",
+};
+
+static const char *debuggerOperandName(const struct debugCondition *condition) {
+	size_t i;
+
+	for(i = 0; i < sizeof(debugOperandNames) / sizeof(*debugOperandNames); i++) {
+		if(debugOperandNames[i].operand == condition->operand
+				&& (debugOperandNames[i].index == condition->index
+				|| condition->operand == debugOperandData || condition->operand == debugOperandAddress))
+			return debugOperandNames[i].name;
+	}
+
+	return "?";
+}
+
+/* operand, comparison and a number without spaces, e.g. "hl>=0x8000" */
+bool debuggerParseCondition(const char *text, struct debugCondition *condition) {
+	size_t length, i, best, bestLength;
+	unsigned long value;
+	char *end;
+
+	for(length = 0; isalpha((unsigned char)text[length]); length++)
+		;
+
+	for(i = 0; i < sizeof(debugOperandNames) / sizeof(*debugOperandNames); i++) {
+		if(strlen(debugOperandNames[i].name) == length
+				&& strncasecmp(debugOperandNames[i].name, text, length) == 0)
+			break;
+	}
+
+	if(i == sizeof(debugOperandNames) / sizeof(*debugOperandNames))
+		return false;
+
+	condition->operand = debugOperandNames[i].operand;
+	condition->index = debugOperandNames[i].index;
+	text += length;
+
+	/* the longest comparison that matches, "<=" before "<" */
+	bestLength = 0;
+	best = 0;
+
+	for(i = 0; i < sizeof(debugComparisonNames) / sizeof(*debugComparisonNames); i++) {
+		length = strlen(debugComparisonNames[i]);
+
+		if(length > bestLength && strncmp(debugComparisonNames[i], text, length) == 0) {
+			best = i;
+			bestLength = length;
+		}
+	}
+
+	if(bestLength == 0)
+		return false;
+
+	condition->comparison = best;
+
+	value = strtoul(text + bestLength, &end, 0);
+
+	if(end == text + bestLength || *end != '\0' || value > 0xFFFF)
+		return false;
+
+	condition->value = value;
+
+	return true;
+}
+
+static bool debuggerParseRange(const char *text, uint16_t *first, uint16_t *last) {
+	unsigned long low, high;
+	char *end;
+
+	low = strtoul(text, &end, 0);
+
+	if(end == text)
+		return false;
+
+	high = low;
+
+	if(*end == '-')
+		high = strtoul(end + 1, &end, 0);
+
+	if(*end != '\0' || low > high || high > 0xFFFF)
+		return false;
+
+	*first = low;
+	*last = high;
+
+	return true;
+}
+
+static uint8_t debuggerParseAccesses(const char *text) {
+	static const struct {
+		const char	*name;
+		uint8_t		accesses;
+	} names[] = {
+		{ "r", debugRead }, { "w", debugWrite }, { "rw", debugRead | debugWrite },
+		{ "in", debugPortIn }, { "out", debugPortOut }, { "io", debugPortIn | debugPortOut },
+	};
+	size_t i;
+
+	for(i = 0; i < sizeof(names) / sizeof(*names); i++) {
+		if(strcmp(names[i].name, text) == 0)
+			return names[i].accesses;
+	}
+
+	return 0;
+}
+
+static void debuggerList(struct debugger *debugger, FILE *out) {
+	struct debugPoint *point;
+	size_t i, j;
+
+	for(i = 0; i < DEBUGGER_MAX_POINTS; i++) {
+		point = &debugger->points[i];
+
+		if(!point->used)
+			continue;
+
+		fprintf(out, "%2lu: %s%s%s%s%s %04X-%04X, %lu hits", i,
+				point->accesses & debugExecute ? "x" : "",
+				point->accesses & debugRead ? "r" : "",
+				point->accesses & debugWrite ? "w" : "",
+				point->accesses & debugPortIn ? "i" : "",
+				point->accesses & debugPortOut ? "o" : "",
+				point->first, point->last, point->hits);
+
+		for(j = 0; j < point->nConditions; j++)
+			fprintf(out, "%s%s%s0x%X", j == 0 ? " if " : " ",
+					debuggerOperandName(&point->conditions[j]),
+					debugComparisonNames[point->conditions[j].comparison],
+					point->conditions[j].value);
+
+		fputc('\n', out);
+	}
+}
+
+/* the cpu's callbacks are the watchpoints' while read points are armed,
+ * the state is shown through the ones underneath so it doesn't hit them */
+static void debuggerPrintState(struct debugger *debugger) {
+	struct cpu8080 cpu;
+
+	cpu = *debugger->cpu;
+	cpu.readMemory = debugger->readMemory;
+	cpu.readMemoryWord = debugger->readMemoryWord;
+
+	printCpuState(cpu);
+}
+
+static void debuggerPrintHit(struct debugger *debugger, FILE *out) {
+	struct debugHit *hit;
+
+	hit = &debugger->hit;
+
+	if(hit->point == DEBUGGER_MAX_POINTS)
+		fprintf(out, "step ");
+	else if(hit->access == debugExecute)
+		fprintf(out, "breakpoint %lu ", hit->point);
+	else
+		fprintf(out, "watchpoint %lu: %s %04X = %02X, ", hit->point,
+				hit->access == debugRead ? "read" : hit->access == debugWrite ? "write"
+				: hit->access == debugPortIn ? "in" : "out", hit->address, hit->data);
+
+	debuggerPrintState(debugger);
+}
+
+/* one command, true if the cpu should go on:
+ *
+ *	[s]tep			run one instruction (an empty line too)
+ *	[c]ontinue		run until the next hit
+ *	[b]reak addr [if cond...]
+ *	[w]atch r|w|rw addr[-addr] [if cond...]
+ *	[p]ort in|out|io port[-port] [if cond...]
+ *	[d]elete n
+ *	[l]ist
+ *	[r]egisters
+ */
+bool debuggerCommand(struct debugger *debugger, const char *line, FILE *out) {
+	struct debugCondition conditions[DEBUGGER_MAX_CONDITIONS];
+	char buffer[256], *words[5 + DEBUGGER_MAX_CONDITIONS], *save;
+	size_t nWords, nConditions, i;
+	uint16_t first, last;
+	uint8_t accesses;
+	int point;
+
+	snprintf(buffer, sizeof(buffer), "%s", line);
+
+	for(nWords = 0; nWords < sizeof(words) / sizeof(*words)
+			&& (words[nWords] = strtok_r(nWords == 0 ? buffer : NULL, " \t\n", &save)) != NULL; nWords++)
+		;
+
+	if(nWords == 0 || strcmp(words[0], "s") == 0 || strcmp(words[0], "step") == 0) {
+		debuggerStep(debugger, true);
+		debuggerResume(debugger);
+		return true;
+	}
+
+	switch(words[0][0]) {
+		case 'c':
+			debuggerStep(debugger, false);
+			debuggerResume(debugger);
+			return true;
+
+		case 'l':
+			debuggerList(debugger, out);
+			return false;
+
+		case 'r':
+			debuggerPrintState(debugger);
+			return false;
+
+		case 'd':
+			if(nWords < 2 || !debuggerRemove(debugger, strtoul(words[1], NULL, 0)))
+				fprintf(out, "no such point\n");
+			return false;
+
+		case 'b':
+			accesses = debugExecute;
+			i = 1;
+			break;
+
+		case 'w':
+		case 'p':
+			accesses = nWords > 1 ? debuggerParseAccesses(words[1]) : 0;
+
+			if(accesses == 0 || (words[0][0] == 'w') != !(accesses & (debugPortIn | debugPortOut))) {
+				fprintf(out, "unknown access\n");
+				return false;
+			}
+
+			i = 2;
+			break;
+
+		default:
+			fprintf(out, "unknown command\n");
+			return false;
+	}
+
+	if(nWords <= i || !debuggerParseRange(words[i], &first, &last)) {
+		fprintf(out, "bad address\n");
+		return false;
+	}
+
+	nConditions = 0;
+
+	if(nWords > i + 1) {
+		if(strcmp(words[i + 1], "if") != 0) {
+			fprintf(out, "expected if\n");
+			return false;
+		}
+
+		/* a word past the last condition that fits is kept to tell */
+		for(i += 2; i < nWords; i++) {
+			if(nConditions == DEBUGGER_MAX_CONDITIONS) {
+				fprintf(out, "too many conditions\n");
+				return false;
+			}
+
+			if(!debuggerParseCondition(words[i], &conditions[nConditions++])) {
+				fprintf(out, "bad condition %s\n", words[i]);
+				return false;
+			}
+		}
+	}
+
+	point = debuggerAdd(debugger, accesses, first, last, conditions, nConditions);
+
+	if(point < 0)
+		fprintf(out, "no room\n");
+	else
+		fprintf(out, "%d\n", point);
+
+	return false;
+}
+
+/* shows why the cpu stopped and reads commands until one resumes it, the
+ * end of input continues */
+void debuggerPrompt(struct debugger *debugger, FILE *in, FILE *out) {
+	char line[256];
+
+	debuggerPrintHit(debugger, out);
+
+	for(;;) {
+		fprintf(out, "> ");
+		fflush(out);
+
+		if(fgets(line, sizeof(line), in) == NULL) {
+			debuggerCommand(debugger, "continue", out);
+			return;
+		}
+
+		if(debuggerCommand(debugger, line, out))
+			return;
+	}
+}
@@ -0,0 +1,250 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "device_thread.h"
+
+/* input backs off this long while the guest doesn't read its queue */
+#define DEVICE_THREAD_BACKOFF_MS	1
+
+static void deviceThreadWatch(struct deviceThread *device, int fd, uint32_t events) {
+	struct epoll_event event;
+
+	event.events = events;
+	event.data.fd = fd;
+
+	epoll_ctl(device->epollFd, EPOLL_CTL_MOD, fd, &event);
+}
+
+/* a hung up fd is reported even without events, so after the end of input
+ * the read side isn't watched at all */
+static void deviceThreadInterest(struct deviceThread *device) {
+	uint32_t readEvents, writeEvents;
+
+	readEvents = device->reading ? EPOLLIN : 0;
+	writeEvents = device->writing ? EPOLLOUT : 0;
+
+	if(device->readFd >= 0 && device->readFd == device->writeFd) {
+		if(!atomic_load(&device->eof))
+			deviceThreadWatch(device, device->readFd, readEvents | writeEvents);
+		return;
+	}
+
+	if(device->readFd >= 0 && !atomic_load(&device->eof))
+		deviceThreadWatch(device, device->readFd, readEvents);
+
+	if(device->writeFd >= 0)
+		deviceThreadWatch(device, device->writeFd, writeEvents);
+}
+
+/* queues what was read, reads more once the stash is empty */
+static void deviceThreadFill(struct deviceThread *device) {
+	ssize_t length;
+
+	for(;;) {
+		if(device->stashLength != 0) {
+			length = spscPush(&device->input, device->stash + device->stashOffset, device->stashLength);
+
+			device->stashOffset += length;
+			device->stashLength -= length;
+
+			if(device->stashLength != 0)
+				break;
+		}
+
+		if(atomic_load(&device->eof))
+			break;
+
+		length = read(device->readFd, device->stash, sizeof(device->stash));
+
+		if(length > 0) {
+			device->stashOffset = 0;
+			device->stashLength = length;
+			continue;
+		}
+
+		if(length < 0 && (errno == EAGAIN || errno == EINTR))
+			break;
+
+		atomic_store(&device->eof, true);
+		device->reading = false;
+		epoll_ctl(device->epollFd, EPOLL_CTL_DEL, device->readFd, NULL);
+		return;
+	}
+
+	/* a full queue stops reading until the guest catches up */
+	if(device->reading != (device->stashLength == 0)) {
+		device->reading = device->stashLength == 0;
+		deviceThreadInterest(device);
+	}
+}
+
+/* writes out what the guest queued until the host doesn't take more */
+static void deviceThreadDrain(struct deviceThread *device) {
+	ssize_t length;
+
+	for(;;) {
+		if(device->pendingLength == 0) {
+			device->pendingOffset = 0;
+			device->pendingLength = spscPop(&device->output, device->pending, sizeof(device->pending));
+
+			if(device->pendingLength == 0)
+				break;
+		}
+
+		length = write(device->writeFd, device->pending + device->pendingOffset, device->pendingLength);
+
+		if(length < 0) {
+			if(errno == EINTR)
+				continue;
+
+			if(errno != EAGAIN) {
+				/* nobody is listening, drop it */
+				device->pendingLength = 0;
+				continue;
+			}
+
+			break;
+		}
+
+		device->pendingOffset += length;
+		device->pendingLength -= length;
+	}
+
+	if(device->writing != (device->pendingLength != 0)) {
+		device->writing = device->pendingLength != 0;
+		deviceThreadInterest(device);
+	}
+}
+
+static void *deviceThreadMain(void *argument) {
+	struct deviceThread *device;
+	struct epoll_event events[4];
+	uint64_t wake;
+	int i, n;
+
+	device = argument;
+
+	for(;;) {
+		if(device->writeFd >= 0)
+			deviceThreadDrain(device);
+
+		if(device->readFd >= 0 && !atomic_load(&device->eof))
+			deviceThreadFill(device);
+
+		if(atomic_load(&device->stop) && device->pendingLength == 0)
+			break;
+
+		/* output queued after the drain is written before waiting */
+		if(device->writeFd >= 0 && device->pendingLength == 0 && !spscSleep(&device->output))
+			continue;
+
+		/* output to a shared fd that hit the end of input isn't watched */
+		n = epoll_wait(device->epollFd, events, sizeof(events) / sizeof(*events),
+				device->stashLength != 0 || (device->writing && device->readFd == device->writeFd
+					&& atomic_load(&device->eof)) ? DEVICE_THREAD_BACKOFF_MS : -1);
+
+		for(i = 0; i < n; i++) {
+			if(events[i].data.fd == device->wakeFd)
+				while(read(device->wakeFd, &wake, sizeof(wake)) > 0)
+					;
+		}
+	}
+
+	return NULL;
+}
+
+static bool deviceThreadAdd(struct deviceThread *device, int fd, uint32_t events) {
+	struct epoll_event event;
+
+	if(fd != device->wakeFd)
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+	event.events = events;
+	event.data.fd = fd;
+
+	return epoll_ctl(device->epollFd, EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+/* readFd and writeFd may be the same fd */
+bool deviceThreadStart(struct deviceThread *device, int readFd, int writeFd, size_t queueSize) {
+	device->readFd = readFd;
+	device->writeFd = writeFd;
+	device->stashOffset = device->stashLength = 0;
+	device->pendingOffset = device->pendingLength = 0;
+	device->reading = readFd >= 0;
+	device->writing = false;
+
+	atomic_init(&device->stop, false);
+	atomic_init(&device->eof, readFd < 0);
+
+	if(!spscInit(&device->input, queueSize))
+		return false;
+
+	if(!spscInit(&device->output, queueSize)) {
+		spscDestroy(&device->input);
+		return false;
+	}
+
+	device->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	device->epollFd = epoll_create1(EPOLL_CLOEXEC);
+
+	if(device->wakeFd < 0 || device->epollFd < 0
+			|| !deviceThreadAdd(device, device->wakeFd, EPOLLIN)
+			|| (readFd >= 0 && !deviceThreadAdd(device, readFd, EPOLLIN))
+			|| (writeFd >= 0 && writeFd != readFd && !deviceThreadAdd(device, writeFd, 0))
+			|| pthread_create(&device->thread, NULL, deviceThreadMain, device) != 0) {
+		if(device->wakeFd >= 0)
+			close(device->wakeFd);
+		if(device->epollFd >= 0)
+			close(device->epollFd);
+
+		spscDestroy(&device->input);
+		spscDestroy(&device->output);
+		return false;
+	}
+
+	return true;
+}
+
+/* waits for queued output to be written */
+void deviceThreadStop(struct deviceThread *device) {
+	uint64_t wake;
+
+	wake = 1;
+
+	atomic_store(&device->stop, true);
+	write(device->wakeFd, &wake, sizeof(wake));
+
+	pthread_join(device->thread, NULL);
+
+	close(device->wakeFd);
+	close(device->epollFd);
+
+	spscDestroy(&device->input);
+	spscDestroy(&device->output);
+}
+
+/* cpu side, never blocks. returns how much fit, the thread is only woken
+ * when it went to sleep on an empty queue, it drains everything else on
+ * its own */
+size_t deviceThreadWrite(struct deviceThread *device, const uint8_t *data, size_t length) {
+	size_t written;
+
+	written = spscPush(&device->output, data, length);
+
+	if(written != 0 && spscWakeNeeded(&device->output))
+		deviceThreadWake(device);
+
+	return written;
+}
+
+/* for producers that push to the output queue themselves */
+void deviceThreadWake(struct deviceThread *device) {
+	uint64_t wake;
+
+	wake = 1;
+	write(device->wakeFd, &wake, sizeof(wake));
+}
@@ -0,0 +1,124 @@
+#include <string.h>
+
+#include "disassembler.h"
+
+static const char disassemblerDigits[] = "0123456789ABCDEF";
+
+/* intel style, "0FFH" */
+static char *disassemblerPutImmediate(char *out, uint16_t value, int digits) {
+	int shift;
+
+	shift = digits * 4 - 4;
+
+	if((value >> shift & 0xF) > 9)
+		*out++ = '0';
+
+	for(; shift >= 0; shift -= 4)
+		*out++ = disassemblerDigits[value >> shift & 0xF];
+
+	*out++ = 'H';
+
+	return out;
+}
+
+/* the text of the instruction at bytes, not terminated */
+static char *disassemblerPut(char *out, const uint8_t *bytes) {
+	const struct opcodeInfo *info;
+
+	info = &opcodeTable[bytes[0]];
+
+	memcpy(out, info->mnemonic, 8);
+	out += info->mnemonicLength;
+
+	if(info->length == 2)
+		out = disassemblerPutImmediate(out, bytes[1], 2);
+	else if(info->length == 3)
+		out = disassemblerPutImmediate(out, bytes[2] << 8 | bytes[1], 4);
+
+	return out;
+}
+
+/* decodes the instruction at bytes into text, which holds at least
+ * DISASSEMBLY_TEXT_SIZE. returns its length */
+size_t disassemble(const uint8_t *bytes, char *text) {
+	*disassemblerPut(text, bytes) = '\0';
+
+	return opcodeTable[bytes[0]].length;
+}
+
+/* a listing of size bytes loaded at origin, one "AAAA  text" line per
+ * instruction. out has to hold size * DISASSEMBLY_LINE_SIZE, the length of
+ * the listing is returned. an instruction cut off by the end is listed as
+ * data */
+size_t disassembleBlock(const uint8_t *bytes, size_t size, uint16_t origin, char *out) {
+	uint16_t address;
+	size_t offset;
+	char *start;
+	uint8_t length;
+
+	start = out;
+
+	for(offset = 0; offset < size; offset += length) {
+		address = origin + offset;
+
+		out[0] = disassemblerDigits[address >> 12];
+		out[1] = disassemblerDigits[address >> 8 & 0xF];
+		out[2] = disassemblerDigits[address >> 4 & 0xF];
+		out[3] = disassemblerDigits[address & 0xF];
+		out[4] = ' ';
+		out[5] = ' ';
+		out += 6;
+
+		length = opcodeTable[bytes[offset]].length;
+
+		if(offset + length <= size)
+			out = disassemblerPut(out, bytes + offset);
+		else {
+			length = 1;
+
+			memcpy(out, "DB ", 3);
+			out = disassemblerPutImmediate(out + 3, bytes[offset], 2);
+		}
+
+		*out++ = '\n';
+	}
+
+	return out - start;
+}
+
+void disassemblyCacheInit(struct disassemblyCache *cache) {
+	memset(cache, 0, sizeof(*cache));
+}
+
+/* the instruction at address as the cpu sees it now. the line stays valid
+ * until the next lookup of an address that maps to the same line */
+const struct disassemblyLine *disassemblyCacheLookup(struct disassemblyCache *cache, struct cpu8080 *cpu,
+		uint16_t address) {
+	struct disassemblyLine *line;
+	uint8_t bytes[3], length, i;
+
+	line = &cache->lines[address & (DISASSEMBLY_CACHE_SIZE - 1)];
+
+	bytes[0] = cpu->readMemory(cpu->memory, address);
+	bytes[1] = bytes[2] = 0;
+	length = opcodeTable[bytes[0]].length;
+
+	for(i = 1; i < length; i++)
+		bytes[i] = cpu->readMemory(cpu->memory, address + i);
+
+	if(line->valid && line->address == address && memcmp(line->bytes, bytes, sizeof(bytes)) == 0) {
+		cache->hits++;
+		return line;
+	}
+
+	cache->misses++;
+
+	line->address = address;
+	memcpy(line->bytes, bytes, sizeof(bytes));
+	line->length = length;
+	line->valid = true;
+
+	disassemble(bytes, line->text);
+
+	return line;
+}
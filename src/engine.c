@@ -0,0 +1,140 @@
+#include <string.h>
+
+#include "engine.h"
+#include "cpu_model.h"
+
+static void referenceRun(struct cpu8080 *cpu, size_t cycles);
+
+const struct cpuEngine referenceEngine = {
+	.name = "reference",
+	.step = cpuExecuteInstruction,
+	.run = referenceRun,
+};
+
+/* the reference without its hooks, see cpuExecute */
+const struct cpuEngine turboEngine = {
+	.name = "turbo",
+	.step = cpuTurboStep,
+	.run = cpuTurboRun,
+};
+
+#ifdef CPU_AOT
+/* turbo with the rom translated by i8080-aot built in, see cpuAotRun */
+static const struct cpuEngine aotEngine = {
+	.name = "aot",
+	.step = cpuTurboStep,
+	.run = cpuAotRun,
+};
+#endif
+
+/* every engine that can be selected by name, NULL terminated */
+static const struct cpuEngine *engines[] = {
+	&referenceEngine,
+	&modelEngine,
+	&turboEngine,
+#ifdef CPU_AOT
+	&aotEngine,
+#endif
+	NULL,
+};
+
+static void referenceRun(struct cpu8080 *cpu, size_t cycles) {
+	size_t target;
+
+	target = cpu->cycleCounter + cycles;
+
+	while(cpu->cycleCounter < target && cpu->signalBuffer == noSignal)
+		cpuExecuteInstruction(cpu);
+}
+
+const struct cpuEngine *cpuFindEngine(const char *name) {
+	size_t i;
+
+	for(i = 0; engines[i] != NULL; i++) {
+		if(strcmp(engines[i]->name, name) == 0)
+			return engines[i];
+	}
+
+	return NULL;
+}
+
+/* engines by index, 0 is always the reference, NULL past the last one */
+const struct cpuEngine *cpuEngineAt(size_t index) {
+	size_t i;
+
+	for(i = 0; i < index && engines[i] != NULL; i++)
+		;
+
+	return engines[i];
+}
+
+void cpuListEngines(FILE *stream) {
+	size_t i;
+
+	for(i = 0; engines[i] != NULL; i++)
+		fprintf(stream, "%s\n", engines[i]->name);
+}
+
+void engineSwitchInit(struct engineSwitch *engineSwitch, const struct cpuEngine *engine) {
+	engineSwitch->current = engine;
+	engineSwitch->switches = 0;
+
+	atomic_init(&engineSwitch->requested, 0);
+}
+
+/* the cpu moves to engine at the first instruction boundary at or after
+ * cycle, 0 is as soon as possible. a later request replaces this one.
+ * engine has to be one that can be selected by name, false if it isn't */
+bool engineSwitchRequest(struct engineSwitch *engineSwitch, const struct cpuEngine *engine, size_t cycle) {
+	uint64_t index;
+
+	for(index = 0; engines[index] != NULL && engines[index] != engine; index++)
+		;
+
+	if(engines[index] == NULL)
+		return false;
+
+	if(cycle > ENGINE_SWITCH_MAX_CYCLE)
+		cycle = ENGINE_SWITCH_MAX_CYCLE;
+
+	atomic_store(&engineSwitch->requested, (uint64_t)cycle << ENGINE_SWITCH_INDEX_BITS | (index + 1));
+
+	return true;
+}
+
+/* like the engines' run, whole instructions until at least cycles have
+ * passed or a signal is raised */
+void engineSwitchRun(struct engineSwitch *engineSwitch, struct cpu8080 *cpu, size_t cycles) {
+	uint64_t requested, cycle;
+	size_t target, slice;
+
+	target = cpu->cycleCounter + cycles;
+
+	while(cpu->cycleCounter < target && cpu->signalBuffer == noSignal) {
+		slice = target - cpu->cycleCounter;
+
+		requested = atomic_load(&engineSwitch->requested);
+
+		if(requested != 0) {
+			cycle = requested >> ENGINE_SWITCH_INDEX_BITS;
+
+			if(cpu->cycleCounter >= cycle) {
+				/* unless a newer request came in meanwhile */
+				if(atomic_compare_exchange_strong(&engineSwitch->requested, &requested, 0)) {
+					engineSwitch->current = engines[(requested & ((1 << ENGINE_SWITCH_INDEX_BITS) - 1)) - 1];
+					engineSwitch->switches++;
+				}
+
+				continue;
+			}
+
+			if(cycle - cpu->cycleCounter < slice)
+				slice = cycle - cpu->cycleCounter;
+		}
+
+		if(slice > ENGINE_SWITCH_QUANTUM)
+			slice = ENGINE_SWITCH_QUANTUM;
+
+		engineSwitch->current->run(cpu, slice);
+	}
+}
@@ -0,0 +1,751 @@
+#define _GNU_SOURCE
+
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "gdb_stub.h"
+
+/* signal numbers gdb knows */
+#define GDB_SIGINT	2
+#define GDB_SIGTRAP	5
+
+static const char gdbHexDigits[] = "0123456789abcdef";
+
+static int gdbHexValue(char digit) {
+	if(digit >= '0' && digit <= '9')
+		return digit - '0';
+
+	if(digit >= 'a' && digit <= 'f')
+		return digit - 'a' + 10;
+
+	if(digit >= 'A' && digit <= 'F')
+		return digit - 'A' + 10;
+
+	return -1;
+}
+
+/* hex number up to a character that isn't a digit, which end points to */
+static uint32_t gdbParseHex(const char *text, const char **end) {
+	uint32_t value;
+	int digit;
+
+	for(value = 0; (digit = gdbHexValue(*text)) >= 0; text++)
+		value = value << 4 | digit;
+
+	*end = text;
+
+	return value;
+}
+
+/* a hex encoded byte, -1 if it isn't one */
+static int gdbParseByte(const char *text) {
+	int high, low;
+
+	high = gdbHexValue(text[0]);
+	low = high < 0 ? -1 : gdbHexValue(text[1]);
+
+	return low < 0 ? -1 : high << 4 | low;
+}
+
+static char *gdbPutByte(char *out, uint8_t value) {
+	*out++ = gdbHexDigits[value >> 4];
+	*out++ = gdbHexDigits[value & 0xF];
+
+	return out;
+}
+
+static uint16_t gdbReadRegister(struct cpu8080 *cpu, uint8_t index) {
+	switch(index) {
+		case gdbRegisterAF:
+			return cpu->registers[rA] << 8 | cpu->registers[rSTATUS];
+		case gdbRegisterBC:
+			return cpu->registers[rB] << 8 | cpu->registers[rC];
+		case gdbRegisterDE:
+			return cpu->registers[rD] << 8 | cpu->registers[rE];
+		case gdbRegisterHL:
+			return cpu->registers[rH] << 8 | cpu->registers[rL];
+		case gdbRegisterSP:
+			return cpu->stackPointer;
+		default:
+			return cpu->programCounter;
+	}
+}
+
+static void gdbWriteRegister(struct cpu8080 *cpu, uint8_t index, uint16_t value) {
+	switch(index) {
+		case gdbRegisterSP:
+			cpu->stackPointer = value;
+			break;
+
+		case gdbRegisterPC:
+			cpu->programCounter = value;
+			break;
+
+		default:
+			/* AF, BC, DE and HL, the high byte is the first register */
+			cpu->registers[index == gdbRegisterAF ? rA : (index - gdbRegisterBC) * 2] = value >> 8;
+			cpu->registers[index == gdbRegisterAF ? rSTATUS : (index - gdbRegisterBC) * 2 + 1] = value;
+			break;
+	}
+}
+
+bool gdbStubInit(struct gdbStub *stub, struct cpu8080 *cpu, const struct cpuEngine *engine,
+		void (*service)(struct cpu8080 *, void *), void *serviceContext) {
+	stub->cpu = cpu;
+	stub->engine = engine;
+	stub->service = service;
+	stub->serviceContext = serviceContext;
+
+	stub->listenFd = stub->fd = -1;
+	stub->state = gdbStubDetached;
+	stub->inputOffset = stub->inputLength = 0;
+
+	/* the cpu's callbacks have to be set by now */
+	debuggerAttach(&stub->debugger, cpu);
+
+	return true;
+}
+
+/* address is [host:]port, the host defaults to the loopback address */
+bool gdbStubListen(struct gdbStub *stub, const char *address) {
+	struct sockaddr_in inet;
+	const char *colon;
+	char host[INET_ADDRSTRLEN];
+	int fd, on;
+
+	on = 1;
+
+	memset(&inet, 0, sizeof(inet));
+	inet.sin_family = AF_INET;
+
+	colon = strrchr(address, ':');
+
+	snprintf(host, sizeof(host), "%.*s", colon != NULL ? (int)(colon - address) : 0, address);
+	inet.sin_port = htons(strtoul(colon != NULL ? colon + 1 : address, NULL, 10));
+
+	if(inet_pton(AF_INET, host[0] != '\0' ? host : "127.0.0.1", &inet.sin_addr) != 1)
+		return false;
+
+	fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+	if(fd < 0)
+		return false;
+
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+	if(bind(fd, (struct sockaddr *)&inet, sizeof(inet)) != 0 || listen(fd, 1) != 0) {
+		close(fd);
+		return false;
+	}
+
+	stub->listenFd = fd;
+
+	return true;
+}
+
+static bool gdbReadable(int fd, int timeout) {
+	struct pollfd pollFd;
+
+	pollFd.fd = fd;
+	pollFd.events = POLLIN;
+
+	return poll(&pollFd, 1, timeout) > 0;
+}
+
+static void gdbAccept(struct gdbStub *stub) {
+	int on;
+
+	on = 1;
+
+	stub->fd = accept4(stub->listenFd, NULL, NULL, SOCK_CLOEXEC);
+
+	if(stub->fd < 0)
+		return;
+
+	/* packets are small and every one waits for an answer */
+	setsockopt(stub->fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+	stub->inputOffset = stub->inputLength = 0;
+	stub->state = gdbStubStopped;
+}
+
+/* blocks until gdb connects, the cpu stays where it is until gdb lets it
+ * go on */
+bool gdbStubWait(struct gdbStub *stub) {
+	while(stub->state == gdbStubDetached) {
+		if(gdbReadable(stub->listenFd, -1))
+			gdbAccept(stub);
+		else if(errno != EINTR)
+			return false;
+	}
+
+	return true;
+}
+
+/* takes every point out and lets the cpu run on */
+static void gdbDisconnect(struct gdbStub *stub) {
+	size_t i;
+
+	for(i = 0; i < DEBUGGER_MAX_POINTS; i++)
+		debuggerRemove(&stub->debugger, i);
+
+	debuggerResume(&stub->debugger);
+
+	close(stub->fd);
+	stub->fd = -1;
+	stub->state = gdbStubDetached;
+}
+
+/* the next received byte, -1 once the connection is gone */
+static int gdbGetByte(struct gdbStub *stub) {
+	ssize_t length;
+
+	if(stub->inputOffset == stub->inputLength) {
+		do
+			length = read(stub->fd, stub->input, sizeof(stub->input));
+		while(length < 0 && errno == EINTR);
+
+		if(length <= 0)
+			return -1;
+
+		stub->inputOffset = 0;
+		stub->inputLength = length;
+	}
+
+	return (uint8_t)stub->input[stub->inputOffset++];
+}
+
+static bool gdbWrite(struct gdbStub *stub, const char *data, size_t length) {
+	ssize_t written;
+
+	while(length != 0) {
+		written = write(stub->fd, data, length);
+
+		if(written < 0 && errno == EINTR)
+			continue;
+
+		if(written <= 0)
+			return false;
+
+		data += written;
+		length -= written;
+	}
+
+	return true;
+}
+
+/* sends reply as a packet and waits for gdb to acknowledge it */
+static bool gdbSendReply(struct gdbStub *stub) {
+	char frame[GDB_STUB_PACKET_SIZE + 4], *out;
+	uint8_t checksum;
+	size_t length, i;
+	int byte;
+
+	length = strlen(stub->reply);
+	checksum = 0;
+
+	for(i = 0; i < length; i++)
+		checksum += stub->reply[i];
+
+	frame[0] = '$';
+	memcpy(frame + 1, stub->reply, length);
+	out = frame + 1 + length;
+	*out++ = '#';
+	out = gdbPutByte(out, checksum);
+
+	do {
+		if(!gdbWrite(stub, frame, out - frame))
+			return false;
+
+		/* an interrupt racing the reply means nothing anymore */
+		while((byte = gdbGetByte(stub)) == '\x03')
+			;
+	} while(byte == '-');
+
+	/* gdb went on without acknowledging, the packet is left for later */
+	if(byte == '$')
+		stub->inputOffset--;
+
+	return byte >= 0;
+}
+
+/* receives a packet into packet and acknowledges it. '\x03' on its own is
+ * returned as a packet of that character. false once the connection is
+ * gone */
+static bool gdbReceivePacket(struct gdbStub *stub) {
+	char sent[2];
+	uint8_t checksum;
+	size_t length;
+	int byte;
+
+	for(;;) {
+		do {
+			byte = gdbGetByte(stub);
+
+			if(byte == '\x03') {
+				strcpy(stub->packet, "\x03");
+				return true;
+			}
+		} while(byte >= 0 && byte != '$');
+
+		if(byte < 0)
+			return false;
+
+		checksum = 0;
+
+		for(length = 0; (byte = gdbGetByte(stub)) >= 0 && byte != '#'; length++) {
+			if(length < GDB_STUB_PACKET_SIZE)
+				stub->packet[length] = byte;
+
+			checksum += byte;
+		}
+
+		if(byte < 0 || (byte = gdbGetByte(stub)) < 0)
+			return false;
+
+		sent[0] = byte;
+
+		if((byte = gdbGetByte(stub)) < 0)
+			return false;
+
+		sent[1] = byte;
+		stub->packet[length < GDB_STUB_PACKET_SIZE ? length : GDB_STUB_PACKET_SIZE] = '\0';
+
+		/* a packet too long for us is dropped like a broken one */
+		if(length < GDB_STUB_PACKET_SIZE && gdbParseByte(sent) == checksum)
+			return gdbWrite(stub, "+", 1);
+
+		if(!gdbWrite(stub, "-", 1))
+			return false;
+	}
+}
+
+/* why the cpu stopped, as gdb wants to hear it */
+static void gdbStopReply(struct gdbStub *stub, uint8_t signal) {
+	struct debugHit *hit;
+	uint8_t accesses;
+
+	hit = &stub->debugger.hit;
+
+	switch(stub->cpu->signalBuffer) {
+		case exitSignal:
+			strcpy(stub->reply, "W00");
+			return;
+
+		case breakpointSignal:
+			signal = GDB_SIGTRAP;
+
+			if(hit->point == DEBUGGER_MAX_POINTS || hit->access == debugExecute)
+				break;
+
+			accesses = stub->debugger.points[hit->point].accesses;
+
+			snprintf(stub->reply, sizeof(stub->reply), "T%02x%s:%04x;", signal,
+					accesses == (debugRead | debugWrite) ? "awatch"
+					: accesses == debugRead ? "rwatch" : "watch", hit->address);
+			return;
+	}
+
+	snprintf(stub->reply, sizeof(stub->reply), "S%02x", signal);
+}
+
+/* the accesses of a Z or z packet's type, 0 for types there are none of */
+static uint8_t gdbPointAccesses(char type) {
+	switch(type) {
+		case '0':
+		case '1':
+			return debugExecute;
+		case '2':
+			return debugWrite;
+		case '3':
+			return debugRead;
+		case '4':
+			return debugRead | debugWrite;
+		default:
+			return 0;
+	}
+}
+
+/* the point gdb set at first..last, -1 if there isn't one */
+static int gdbFindPoint(struct gdbStub *stub, uint8_t accesses, uint16_t first, uint16_t last) {
+	struct debugPoint *point;
+	size_t i;
+
+	for(i = 0; i < DEBUGGER_MAX_POINTS; i++) {
+		point = &stub->debugger.points[i];
+
+		if(point->used && point->accesses == accesses && point->first == first && point->last == last)
+			return i;
+	}
+
+	return -1;
+}
+
+/* Z and z packets: type,address,kind where kind is the length watched */
+static void gdbSetPoint(struct gdbStub *stub, bool insert) {
+	uint32_t address, length;
+	const char *text;
+	uint8_t accesses;
+	int point;
+
+	accesses = gdbPointAccesses(stub->packet[1]);
+	address = gdbParseHex(stub->packet + 3, &text);
+	length = *text == ',' ? gdbParseHex(text + 1, &text) : 1;
+
+	if(accesses == 0) {
+		stub->reply[0] = '\0';
+		return;
+	}
+
+	/* a breakpoint's kind is the size of the instruction, only its
+	 * first byte counts */
+	if(accesses == debugExecute || length == 0)
+		length = 1;
+
+	if(address + length > 0x10000) {
+		strcpy(stub->reply, "E01");
+		return;
+	}
+
+	point = gdbFindPoint(stub, accesses, address, address + length - 1);
+
+	if(insert && point < 0 && debuggerAdd(&stub->debugger, accesses, address, address + length - 1, NULL, 0) < 0) {
+		strcpy(stub->reply, "E02");
+		return;
+	}
+
+	if(!insert && point >= 0)
+		debuggerRemove(&stub->debugger, point);
+
+	strcpy(stub->reply, "OK");
+}
+
+/* gdb's own accesses don't go through the debugger's wrappers */
+static void gdbReadMemory(struct gdbStub *stub) {
+	uint32_t address, length, i;
+	const char *text;
+	char *out;
+
+	address = gdbParseHex(stub->packet + 1, &text);
+	length = *text == ',' ? gdbParseHex(text + 1, &text) : 0;
+
+	if(length > GDB_STUB_PACKET_SIZE / 2)
+		length = GDB_STUB_PACKET_SIZE / 2;
+
+	out = stub->reply;
+
+	for(i = 0; i < length; i++)
+		out = gdbPutByte(out, stub->debugger.readMemory(stub->cpu->memory, address + i));
+
+	*out = '\0';
+}
+
+static void gdbWriteMemory(struct gdbStub *stub) {
+	uint32_t address, length, i;
+	const char *text;
+	int byte;
+
+	address = gdbParseHex(stub->packet + 1, &text);
+	length = *text == ',' ? gdbParseHex(text + 1, &text) : 0;
+
+	if(*text != ':' || strlen(text + 1) != length * 2) {
+		strcpy(stub->reply, "E01");
+		return;
+	}
+
+	for(i = 0, text++; i < length; i++, text += 2) {
+		byte = gdbParseByte(text);
+
+		if(byte < 0) {
+			strcpy(stub->reply, "E01");
+			return;
+		}
+
+		stub->debugger.writeMemory(stub->cpu->memory, address + i, byte);
+	}
+
+	strcpy(stub->reply, "OK");
+}
+
+static void gdbReadRegisters(struct gdbStub *stub) {
+	uint16_t value;
+	char *out;
+	uint8_t i;
+
+	out = stub->reply;
+
+	for(i = 0; i < gdbRegisters; i++) {
+		value = gdbReadRegister(stub->cpu, i);
+
+		out = gdbPutByte(out, value);
+		out = gdbPutByte(out, value >> 8);
+	}
+
+	*out = '\0';
+}
+
+static void gdbWriteRegisters(struct gdbStub *stub) {
+	const char *text;
+	int low, high;
+	uint8_t i;
+
+	text = stub->packet + 1;
+
+	for(i = 0; i < gdbRegisters && strlen(text) >= 4; i++, text += 4) {
+		low = gdbParseByte(text);
+		high = gdbParseByte(text + 2);
+
+		if(low < 0 || high < 0)
+			break;
+
+		gdbWriteRegister(stub->cpu, i, high << 8 | low);
+	}
+
+	strcpy(stub->reply, "OK");
+}
+
+/* p and P packets. gdb's z80 has more registers than we do, they read
+ * as unavailable */
+static void gdbRegister(struct gdbStub *stub, bool write) {
+	const char *text;
+	uint32_t index;
+	uint16_t value;
+	char *out;
+	int low, high;
+
+	index = gdbParseHex(stub->packet + 1, &text);
+
+	if(write) {
+		low = *text == '=' ? gdbParseByte(text + 1) : -1;
+		high = low < 0 ? -1 : gdbParseByte(text + 3);
+
+		if(high < 0) {
+			strcpy(stub->reply, "E01");
+			return;
+		}
+
+		if(index < gdbRegisters)
+			gdbWriteRegister(stub->cpu, index, high << 8 | low);
+
+		strcpy(stub->reply, "OK");
+		return;
+	}
+
+	if(index >= gdbRegisters) {
+		strcpy(stub->reply, "xxxx");
+		return;
+	}
+
+	value = gdbReadRegister(stub->cpu, index);
+
+	out = gdbPutByte(stub->reply, value);
+	out = gdbPutByte(out, value >> 8);
+	*out = '\0';
+}
+
+/* c and s packets may come with an address to go on from */
+static void gdbResumeAt(struct gdbStub *stub) {
+	const char *text;
+	uint32_t address;
+
+	if(stub->packet[1] != '\0') {
+		address = gdbParseHex(stub->packet + 1, &text);
+		stub->cpu->programCounter = address;
+	}
+
+	debuggerResume(&stub->debugger);
+}
+
+/* the cpu is done for when it halted with nothing to wake it */
+static bool gdbCpuStuck(struct cpu8080 *cpu) {
+	return cpu->halted && !cpu->interruptEnable && !cpu->interruptPending;
+}
+
+static void gdbService(struct gdbStub *stub) {
+	if(stub->service != NULL)
+		stub->service(stub->cpu, stub->serviceContext);
+}
+
+/* answers one packet, false if gdb wants the stub gone */
+static bool gdbHandlePacket(struct gdbStub *stub) {
+	char *packet;
+
+	packet = stub->packet;
+	stub->reply[0] = '\0';
+
+	switch(packet[0]) {
+		case '?':
+			gdbStopReply(stub, GDB_SIGTRAP);
+			break;
+
+		case 'g':
+			gdbReadRegisters(stub);
+			break;
+
+		case 'G':
+			gdbWriteRegisters(stub);
+			break;
+
+		case 'p':
+		case 'P':
+			gdbRegister(stub, packet[0] == 'P');
+			break;
+
+		case 'm':
+			gdbReadMemory(stub);
+			break;
+
+		case 'M':
+			gdbWriteMemory(stub);
+			break;
+
+		case 'Z':
+		case 'z':
+			gdbSetPoint(stub, packet[0] == 'Z');
+			break;
+
+		case 'c':
+			gdbResumeAt(stub);
+			stub->state = gdbStubRunning;
+			return true;
+
+		case 's':
+			gdbResumeAt(stub);
+
+			/* the reference engine, so the step sees breakpoints */
+			if(stub->cpu->signalBuffer == noSignal) {
+				referenceEngine.step(stub->cpu);
+				gdbService(stub);
+			}
+
+			gdbStopReply(stub, GDB_SIGTRAP);
+			break;
+
+		case 'H':
+			strcpy(stub->reply, "OK");
+			break;
+
+		case 'q':
+			if(strncmp(packet, "qSupported", 10) == 0)
+				snprintf(stub->reply, sizeof(stub->reply), "PacketSize=%x", GDB_STUB_PACKET_SIZE);
+			else if(strcmp(packet, "qAttached") == 0)
+				strcpy(stub->reply, "1");
+			break;
+
+		case 'D':
+			strcpy(stub->reply, "OK");
+			gdbSendReply(stub);
+			gdbDisconnect(stub);
+			return true;
+
+		case 'k':
+			return false;
+
+		case '\x03':
+			/* already stopped */
+			return true;
+	}
+
+	if(!gdbSendReply(stub))
+		gdbDisconnect(stub);
+
+	return true;
+}
+
+/* looks for an interrupt from gdb while the cpu runs, false if the
+ * connection is gone */
+static bool gdbPollInterrupt(struct gdbStub *stub, bool *interrupted) {
+	int byte;
+
+	*interrupted = false;
+
+	while(stub->inputOffset != stub->inputLength || gdbReadable(stub->fd, 0)) {
+		byte = gdbGetByte(stub);
+
+		if(byte < 0)
+			return false;
+
+		if(byte == '\x03')
+			*interrupted = true;
+	}
+
+	return true;
+}
+
+/* runs the cpu and serves gdb until the cpu is done with no one connected,
+ * or gdb kills it */
+void gdbStubRun(struct gdbStub *stub) {
+	const struct cpuEngine *engine;
+	bool interrupted;
+
+	for(;;) {
+		switch(stub->state) {
+			case gdbStubDetached:
+				if(stub->cpu->signalBuffer != noSignal || gdbCpuStuck(stub->cpu))
+					return;
+
+				stub->engine->run(stub->cpu, GDB_STUB_SLICE);
+				gdbService(stub);
+
+				if(stub->listenFd >= 0 && gdbReadable(stub->listenFd, 0))
+					gdbAccept(stub);
+
+				break;
+
+			case gdbStubStopped:
+				if(!gdbReceivePacket(stub))
+					gdbDisconnect(stub);
+				else if(!gdbHandlePacket(stub)) {
+					close(stub->fd);
+					stub->fd = -1;
+					return;
+				}
+
+				break;
+
+			case gdbStubRunning:
+				engine = stub->debugger.armed[debugKindExecute] != 0 ? &referenceEngine : stub->engine;
+				engine->run(stub->cpu, GDB_STUB_SLICE);
+
+				if(stub->cpu->signalBuffer != noSignal || gdbCpuStuck(stub->cpu)) {
+					stub->state = gdbStubStopped;
+					gdbStopReply(stub, GDB_SIGTRAP);
+				}
+				else {
+					gdbService(stub);
+
+					if(!gdbPollInterrupt(stub, &interrupted)) {
+						gdbDisconnect(stub);
+						break;
+					}
+
+					if(!interrupted)
+						break;
+
+					stub->state = gdbStubStopped;
+					gdbStopReply(stub, GDB_SIGINT);
+				}
+
+				if(!gdbSendReply(stub))
+					gdbDisconnect(stub);
+
+				break;
+		}
+	}
+}
+
+void gdbStubDestroy(struct gdbStub *stub) {
+	if(stub->fd >= 0)
+		close(stub->fd);
+
+	if(stub->listenFd >= 0)
+		close(stub->listenFd);
+
+	debuggerDetach(&stub->debugger);
+}
@@ -0,0 +1,409 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "guest_memory.h"
+
+static int guestMemfd(void) {
+	int fd;
+
+	fd = memfd_create("i8080-guest", MFD_CLOEXEC);
+
+	if(fd < 0)
+		return -1;
+
+	if(ftruncate(fd, GUEST_MEMORY_SIZE) != 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/* maps one host page of fd at offset into both views */
+static bool guestMapPage(uint8_t *base, size_t offset, int fd, int protection) {
+	return mmap(base + offset, GUEST_HOST_PAGE_SIZE, protection, MAP_SHARED | MAP_FIXED, fd, offset) != MAP_FAILED
+		&& mmap(base + GUEST_MEMORY_SIZE + offset, GUEST_HOST_PAGE_SIZE, protection,
+			MAP_SHARED | MAP_FIXED, fd, offset) != MAP_FAILED;
+}
+
+/* reserves header, address space and mirror in one go so nothing else can
+ * end up between the two views */
+struct guestMemory *guestMemoryCreate(void) {
+	struct guestMemory *memory;
+	uint8_t *region, *base;
+	int fd;
+
+	fd = guestMemfd();
+
+	if(fd < 0)
+		return NULL;
+
+	region = mmap(NULL, GUEST_HEADER_SIZE + 2 * GUEST_MEMORY_SIZE, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if(region == MAP_FAILED) {
+		close(fd);
+		return NULL;
+	}
+
+	base = region + GUEST_HEADER_SIZE;
+
+	if(mmap(base, GUEST_MEMORY_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED
+			|| mmap(base + GUEST_MEMORY_SIZE, GUEST_MEMORY_SIZE, PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+		munmap(region, GUEST_HEADER_SIZE + 2 * GUEST_MEMORY_SIZE);
+		close(fd);
+		return NULL;
+	}
+
+	memory = (struct guestMemory *)region;
+	memory->base = base;
+	memory->fd = fd;
+	memory->image = NULL;
+
+	return memory;
+}
+
+void guestMemoryDestroy(struct guestMemory *memory) {
+	int fd;
+
+	fd = memory->fd;
+
+	munmap(memory, GUEST_HEADER_SIZE + 2 * GUEST_MEMORY_SIZE);
+	close(fd);
+}
+
+static bool guestPageIsZero(const uint8_t *page) {
+	size_t i;
+
+	for(i = 0; i < GUEST_HOST_PAGE_SIZE; i++) {
+		if(page[i] != 0)
+			return false;
+	}
+
+	return true;
+}
+
+/* rom and cow apply to the 256 byte pages a segment covers completely, the
+ * partial pages at its ends stay writable */
+static void guestImageMarkSegment(struct guestImage *image, struct loaderSegment *segment) {
+	size_t first, last;
+
+	first = (segment->address + (1 << GUEST_PAGE_SHIFT) - 1) >> GUEST_PAGE_SHIFT;
+	last = (segment->address + segment->length) >> GUEST_PAGE_SHIFT;
+
+	for(; first < last && first < GUEST_PAGES; first++)
+		image->policies[first] = segment->kind == segmentRom ? guestPageRom : guestPageCow;
+}
+
+/* loads the manifest into a memfd that every instance mapping the image
+ * shares. returns NULL and sets error if it can't */
+struct guestImage *guestImageCreate(struct loaderManifest *manifest, uint8_t *error) {
+	struct guestImage *image;
+	bool shareable;
+	uint8_t *data;
+	size_t i, j;
+
+	image = calloc(1, sizeof(*image));
+
+	if(image == NULL) {
+		*error = loaderOutOfMemory;
+		return NULL;
+	}
+
+	image->fd = guestMemfd();
+
+	if(image->fd < 0) {
+		free(image);
+		*error = loaderNoMemfd;
+		return NULL;
+	}
+
+	data = mmap(NULL, GUEST_MEMORY_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, image->fd, 0);
+
+	if(data == MAP_FAILED) {
+		close(image->fd);
+		free(image);
+		*error = loaderMapFailed;
+		return NULL;
+	}
+
+	*error = loaderLoadManifest(manifest, data, GUEST_MEMORY_SIZE);
+
+	if(*error != loaderOk) {
+		munmap(data, GUEST_MEMORY_SIZE);
+		close(image->fd);
+		free(image);
+		return NULL;
+	}
+
+	for(i = 0; i < manifest->nSegments; i++) {
+		if(manifest->segments[i].kind != segmentRam)
+			guestImageMarkSegment(image, &manifest->segments[i]);
+	}
+
+	/* sharing needs host pages as small as ours */
+	shareable = sysconf(_SC_PAGESIZE) == GUEST_HOST_PAGE_SIZE;
+
+	for(i = 0; i < GUEST_HOST_PAGES; i++) {
+		for(j = 0; j < GUEST_HOST_PAGE_SIZE >> GUEST_PAGE_SHIFT; j++) {
+			if(image->policies[i * (GUEST_HOST_PAGE_SIZE >> GUEST_PAGE_SHIFT) + j] == guestPageRam)
+				break;
+		}
+
+		if(shareable && j == GUEST_HOST_PAGE_SIZE >> GUEST_PAGE_SHIFT)
+			image->hostPages[i] = guestHostPageShared;
+		else if(guestPageIsZero(data + i * GUEST_HOST_PAGE_SIZE))
+			image->hostPages[i] = guestHostPageEmpty;
+		else
+			image->hostPages[i] = guestHostPagePrivate;
+	}
+
+	mprotect(data, GUEST_MEMORY_SIZE, PROT_READ);
+	image->data = data;
+
+	return image;
+}
+
+/* the image has to outlive every instance mapping it */
+void guestImageDestroy(struct guestImage *image) {
+	munmap((void *)image->data, GUEST_MEMORY_SIZE);
+	close(image->fd);
+	free(image);
+}
+
+/* cow pages in a private host page are plain ram */
+static void guestMemoryPrivatePolicies(struct guestMemory *memory, size_t hostPage) {
+	size_t i;
+
+	for(i = hostPage * (GUEST_HOST_PAGE_SIZE >> GUEST_PAGE_SHIFT);
+			i < (hostPage + 1) * (GUEST_HOST_PAGE_SIZE >> GUEST_PAGE_SHIFT); i++) {
+		if(memory->policies[i] == guestPageCow)
+			memory->policies[i] = guestPageRam;
+	}
+}
+
+/* replaces the contents of the address space with the image. the instance
+ * only pays for the private pages. mapping the image an instance already
+ * has only remaps the pages it unshared since */
+bool guestMemoryMapImage(struct guestMemory *memory, struct guestImage *image) {
+	bool mapped;
+	size_t i, offset;
+
+	if(fallocate(memory->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, 0, GUEST_MEMORY_SIZE) != 0)
+		return false;
+
+	mapped = memory->image == image;
+
+	memcpy(memory->policies, image->policies, sizeof(memory->policies));
+	memory->image = image;
+
+	for(i = 0; i < GUEST_HOST_PAGES; i++) {
+		offset = i * GUEST_HOST_PAGE_SIZE;
+
+		if(image->hostPages[i] == guestHostPageShared) {
+			if(!(mapped && memory->shared[i])
+					&& !guestMapPage(memory->base, offset, image->fd, PROT_READ))
+				return false;
+
+			memory->shared[i] = true;
+			continue;
+		}
+
+		if(!(mapped && !memory->shared[i])
+				&& !guestMapPage(memory->base, offset, memory->fd, PROT_READ | PROT_WRITE))
+			return false;
+
+		memory->shared[i] = false;
+
+		if(image->hostPages[i] == guestHostPagePrivate)
+			memcpy(memory->base + offset, image->data + offset, GUEST_HOST_PAGE_SIZE);
+
+		guestMemoryPrivatePolicies(memory, i);
+	}
+
+	memset(memory->dirty, 0, sizeof(memory->dirty));
+
+	return true;
+}
+
+/* back to the state after guestMemoryCreate or guestMemoryMapImage. only the
+ * dirty pages are cleared or copied from the image again, host pages the
+ * instance unshared are mapped from the image again */
+void guestMemoryReset(struct guestMemory *memory) {
+	struct guestImage *image;
+	size_t page, offset, hostPage;
+
+	image = memory->image;
+
+	for(page = 0; page < GUEST_PAGES; page++) {
+		if(!memory->dirty[page])
+			continue;
+
+		memory->dirty[page] = false;
+
+		offset = page << GUEST_PAGE_SHIFT;
+		hostPage = offset / GUEST_HOST_PAGE_SIZE;
+
+		if(image == NULL || image->hostPages[hostPage] == guestHostPageEmpty)
+			memset(memory->base + offset, 0, 1 << GUEST_PAGE_SHIFT);
+		else if(image->hostPages[hostPage] == guestHostPagePrivate)
+			memcpy(memory->base + offset, image->data + offset, 1 << GUEST_PAGE_SHIFT);
+	}
+
+	if(image == NULL)
+		return;
+
+	for(hostPage = 0; hostPage < GUEST_HOST_PAGES; hostPage++) {
+		if(image->hostPages[hostPage] != guestHostPageShared || memory->shared[hostPage])
+			continue;
+
+		offset = hostPage * GUEST_HOST_PAGE_SIZE;
+
+		if(!guestMapPage(memory->base, offset, image->fd, PROT_READ)) {
+			perror("can't share guest page");
+			abort();
+		}
+
+		memcpy(memory->policies + (offset >> GUEST_PAGE_SHIFT), image->policies + (offset >> GUEST_PAGE_SHIFT),
+				GUEST_HOST_PAGE_SIZE >> GUEST_PAGE_SHIFT);
+		memory->shared[hostPage] = true;
+	}
+}
+
+void guestMemoryMarkDirty(struct guestMemory *memory, size_t address, size_t length) {
+	size_t page;
+
+	if(length == 0)
+		return;
+
+	for(page = address >> GUEST_PAGE_SHIFT; page <= (address + length - 1) >> GUEST_PAGE_SHIFT && page < GUEST_PAGES; page++)
+		memory->dirty[page] = true;
+}
+
+/* gives the instance its own copy of a shared host page */
+static void guestMemoryUnshare(struct guestMemory *memory, size_t hostPage) {
+	size_t offset;
+
+	offset = hostPage * GUEST_HOST_PAGE_SIZE;
+
+	if(!guestMapPage(memory->base, offset, memory->fd, PROT_READ | PROT_WRITE)) {
+		perror("can't unshare guest page");
+		abort();
+	}
+
+	memcpy(memory->base + offset, memory->image->data + offset, GUEST_HOST_PAGE_SIZE);
+	guestMemoryPrivatePolicies(memory, hostPage);
+
+	memory->shared[hostPage] = false;
+}
+
+/* slow path of the write callbacks, false if the write has to be dropped */
+bool guestMemoryWritable(struct guestMemory *memory, uint16_t address) {
+	switch(memory->policies[address >> GUEST_PAGE_SHIFT]) {
+		case guestPageRom:
+			return false;
+
+		case guestPageCow:
+			guestMemoryUnshare(memory, address / GUEST_HOST_PAGE_SIZE);
+			return true;
+	}
+
+	return true;
+}
+
+/* writes from the host side, rom included */
+void guestMemoryPoke(struct guestMemory *memory, uint16_t address, uint8_t data) {
+	size_t hostPage;
+
+	hostPage = address / GUEST_HOST_PAGE_SIZE;
+
+	if(memory->shared[hostPage])
+		guestMemoryUnshare(memory, hostPage);
+
+	memory->base[address] = data;
+	memory->dirty[address >> GUEST_PAGE_SHIFT] = true;
+}
+
+/* bulk copies for host code, length is at most GUEST_MEMORY_SIZE and wraps
+ * at 64k. they aren't counted in the heatmap */
+void guestMemoryRead(struct guestMemory *memory, uint16_t address, void *destination, size_t length) {
+	/* the mirror takes care of the wrap */
+	memcpy(destination, memory->base + address, length);
+}
+
+/* a page at a time, rom pages drop their part like the write callbacks do */
+void guestMemoryWrite(struct guestMemory *memory, uint16_t address, const void *source, size_t length) {
+	const uint8_t *bytes;
+	size_t n;
+
+	for(bytes = source; length > 0; bytes += n, length -= n, address += n) {
+		n = (1 << GUEST_PAGE_SHIFT) - (address & ((1 << GUEST_PAGE_SHIFT) - 1));
+
+		if(n > length)
+			n = length;
+
+		if(memory->policies[address >> GUEST_PAGE_SHIFT] != guestPageRam
+				&& !guestMemoryWritable(memory, address))
+			continue;
+
+		memcpy(memory->base + address, bytes, n);
+		memory->dirty[address >> GUEST_PAGE_SHIFT] = true;
+	}
+}
+
+uint8_t guestReadMemory(uint8_t *memory, uint16_t address) {
+	HEATMAP_READ(guestMemoryFromBase(memory)->heatmap, address);
+
+	return memory[address];
+}
+
+/* words count as two byte accesses in the heatmap */
+uint16_t guestReadMemoryWord(uint8_t *memory, uint16_t address) {
+	HEATMAP_READ(guestMemoryFromBase(memory)->heatmap, address);
+	HEATMAP_READ(guestMemoryFromBase(memory)->heatmap, (uint16_t)(address + 1));
+
+	return guestLoadWord(memory, address);
+}
+
+void guestWriteMemory(uint8_t *memory, uint16_t address, uint8_t data) {
+	struct guestMemory *guest;
+
+	guest = guestMemoryFromBase(memory);
+
+	if(guest->policies[address >> GUEST_PAGE_SHIFT] != guestPageRam
+			&& !guestMemoryWritable(guest, address))
+		return;
+
+	memory[address] = data;
+	guest->dirty[address >> GUEST_PAGE_SHIFT] = true;
+
+	HEATMAP_WRITE(guest->heatmap, address);
+}
+
+/* a word crossing into a page that drops writes keeps its other half */
+void guestWriteMemoryWord(uint8_t *memory, uint16_t address, uint16_t data) {
+	struct guestMemory *guest;
+
+	guest = guestMemoryFromBase(memory);
+
+	if(guest->policies[address >> GUEST_PAGE_SHIFT] == guestPageRam
+			&& guest->policies[(uint16_t)(address + 1) >> GUEST_PAGE_SHIFT] == guestPageRam) {
+		guestStoreWord(memory, address, data);
+
+		guest->dirty[address >> GUEST_PAGE_SHIFT] = true;
+		guest->dirty[(uint16_t)(address + 1) >> GUEST_PAGE_SHIFT] = true;
+
+		HEATMAP_WRITE(guest->heatmap, address);
+		HEATMAP_WRITE(guest->heatmap, (uint16_t)(address + 1));
+		return;
+	}
+
+	guestWriteMemory(memory, address, data & 0xFF);
+	guestWriteMemory(memory, address + 1, data >> 8);
+}
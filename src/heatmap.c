@@ -0,0 +1,41 @@
+#include <string.h>
+
+#include "heatmap.h"
+#include "cpu.h"
+#include "guest_memory.h"
+
+/* the cpu has to run in guest memory, NULL detaches. does nothing unless
+ * built with CPU_HEATMAP */
+void heatmapAttach(struct heatmap *heatmap, struct cpu8080 *cpu) {
+#ifdef CPU_HEATMAP
+	cpu->heatmap = heatmap;
+	guestMemoryFromBase(cpu->memory)->heatmap = heatmap;
+#endif
+}
+
+void heatmapReset(struct heatmap *heatmap) {
+	memset(heatmap, 0, sizeof(*heatmap));
+}
+
+/* writes the counters of one interval, ending at cycle, and starts the next
+ * one. only pages that were touched are listed:
+ *
+ *	interval <cycle>
+ *	<page> <reads> <writes> <executes>
+ *	...
+ */
+void heatmapDump(struct heatmap *heatmap, FILE *stream, uint64_t cycle) {
+	size_t page;
+
+	fprintf(stream, "interval %lu\n", (unsigned long)cycle);
+
+	for(page = 0; page < HEATMAP_PAGES; page++) {
+		if(heatmap->reads[page] == 0 && heatmap->writes[page] == 0 && heatmap->executes[page] == 0)
+			continue;
+
+		fprintf(stream, "%02lX %lu %lu %lu\n", (unsigned long)page, (unsigned long)heatmap->reads[page],
+				(unsigned long)heatmap->writes[page], (unsigned long)heatmap->executes[page]);
+	}
+
+	heatmapReset(heatmap);
+}
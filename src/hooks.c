@@ -0,0 +1,222 @@
+#include <string.h>
+
+#include "hooks.h"
+#include "guest_memory.h"
+#include "opcodes.h"
+
+#define HOOK_FNV_OFFSET	0x811C9DC5
+#define HOOK_FNV_PRIME	0x01000193
+
+static void hookPush(struct cpu8080 *cpu, uint16_t data) {
+	cpu->stackPointer -= 2;
+	cpu->writeMemoryWord(cpu->memory, cpu->stackPointer, data);
+}
+
+static uint16_t hookPop(struct cpu8080 *cpu) {
+	uint16_t data;
+
+	data = cpu->readMemoryWord(cpu->memory, cpu->stackPointer);
+	cpu->stackPointer += 2;
+
+	return data;
+}
+
+static uint16_t hookPair(struct cpu8080 *cpu, uint8_t r) {
+	return cpu->registers[r] << 8 | cpu->registers[r + 1];
+}
+
+static void hookSetPair(struct cpu8080 *cpu, uint8_t r, uint16_t data) {
+	cpu->registers[r] = data >> 8;
+	cpu->registers[r + 1] = data & 0xFF;
+}
+
+/* cycles of the instructions from first up to end, offsets into code */
+static size_t hookCycles(const uint8_t *code, uint16_t first, uint16_t end) {
+	size_t cycles;
+
+	for(cycles = 0; first < end; first += opcodeTable[code[first]].length)
+		cycles += opcodeTable[code[first]].cycles;
+
+	return cycles;
+}
+
+/* 8080EXM's updcrc, the main cost of the exerciser: the byte in A goes
+ * into the crc-32 at HL, kept most significant byte first, through a table
+ * of 256 four byte entries. every register is saved on the stack and comes
+ * back off it.
+ *
+ *	00 PUSH PSW, PUSH B, PUSH D, PUSH H, PUSH H
+ *	05 LXI D,3 / DAD D / XRA M		A ^= the crc's low byte
+ *	0A MOV L,A / MVI H,0 / DAD H / DAD H
+ *	0F XCHG / LXI H,table / DAD D / XCHG	DE = table + A * 4
+ *	15 POP H / LXI B,4
+ *	19 LDAX D / XRA B / MOV B,M / MOV M,A	shift the crc a byte and add
+ *	1D INX D / INX H / DCR C / JNZ 19	the table entry
+ *	23 POP H, POP D, POP B, POP PSW, RET */
+static void hookCrc32Update(struct cpu8080 *cpu, const struct hook *hook) {
+	const uint8_t *code;
+	uint16_t address, entry;
+	uint8_t a, b, i;
+
+	code = hook->code;
+
+	hookPush(cpu, hookPair(cpu, rA));
+	hookPush(cpu, hookPair(cpu, rB));
+	hookPush(cpu, hookPair(cpu, rD));
+	hookPush(cpu, hookPair(cpu, rH));
+	hookPush(cpu, hookPair(cpu, rH));
+
+	address = hookPair(cpu, rH) + (code[0x06] | code[0x07] << 8);
+	a = cpu->registers[rA] ^ cpu->readMemory(cpu->memory, address);
+	entry = (code[0x11] | code[0x12] << 8) + ((code[0x0C] << 8 | a) << 2);
+
+	address = hookPop(cpu);
+	b = code[0x18];
+
+	for(i = 0; i < code[0x17]; i++, entry++, address++) {
+		a = cpu->readMemory(cpu->memory, entry) ^ b;
+		b = cpu->readMemory(cpu->memory, address);
+		cpu->writeMemory(cpu->memory, address, a);
+	}
+
+	hookSetPair(cpu, rH, hookPop(cpu));
+	hookSetPair(cpu, rD, hookPop(cpu));
+	hookSetPair(cpu, rB, hookPop(cpu));
+	hookSetPair(cpu, rA, (hookPop(cpu) & 0xFFD7) | 0x0002);
+	cpu->programCounter = hookPop(cpu);
+
+	cpu->cycleCounter += hook->cycles;
+}
+
+/* the loop runs as many times as LXI B puts in C */
+static size_t hookCrc32UpdateCycles(const uint8_t *code) {
+	return hookCycles(code, 0x00, 0x19) + code[0x17] * hookCycles(code, 0x19, 0x23)
+		+ hookCycles(code, 0x23, 0x28);
+}
+
+static const struct hookRoutine crc32Update = {
+	.name = "crc32 update (8080EXM updcrc)",
+	.length = 0x28,
+	.signature = 0xF6227BCE,
+	.run = hookCrc32Update,
+	.cycles = hookCrc32UpdateCycles,
+};
+
+const struct hookRoutine *hookLibrary[] = {
+	&crc32Update,
+	NULL,
+};
+
+void hooksInit(struct hooks *hooks) {
+	memset(hooks, 0, sizeof(*hooks));
+}
+
+/* hooks routine at address if the code there in memory is the routine */
+bool hooksAdd(struct hooks *hooks, const uint8_t *memory, uint16_t address, const struct hookRoutine *routine) {
+	struct hook *hook;
+
+	if(hooks->nHooks == HOOKS_MAX || routine->length > HOOK_MAX_LENGTH
+			|| hookSignature(memory + address, address, routine->length) != routine->signature)
+		return false;
+
+	hook = &hooks->hooks[hooks->nHooks++];
+
+	hook->routine = routine;
+	hook->address = address;
+	memcpy(hook->code, memory + address, routine->length);
+	hook->cycles = routine->cycles != NULL ? routine->cycles(hook->code) : 0;
+	hook->calls = hook->misses = 0;
+
+	hooks->pages[address >> HOOKS_PAGE_SHIFT]++;
+
+	return true;
+}
+
+/* hooks every routine of the library found in the first size bytes of
+ * memory, returns how many were */
+size_t hooksScan(struct hooks *hooks, const uint8_t *memory, size_t size) {
+	const struct hookRoutine *routine;
+	size_t i, address, found;
+
+	found = 0;
+
+	for(i = 0; (routine = hookLibrary[i]) != NULL; i++) {
+		for(address = 0; address + routine->length <= size && address < 0x10000; address++) {
+			if(hooksAdd(hooks, memory, address, routine))
+				found++;
+		}
+	}
+
+	return found;
+}
+
+void hooksPrint(struct hooks *hooks, FILE *stream) {
+	struct hook *hook;
+	size_t i;
+
+	for(i = 0; i < hooks->nHooks; i++) {
+		hook = &hooks->hooks[i];
+
+		fprintf(stream, "hook %04X %s: %lu calls, %lu misses\n", hook->address, hook->routine->name,
+				hook->calls, hook->misses);
+	}
+}
+
+/* fnv-1a over the code, the target of every jump and call as an offset
+ * from address */
+uint32_t hookSignature(const uint8_t *code, uint16_t address, uint16_t length) {
+	const struct opcodeInfo *info;
+	uint16_t i, n, j, target;
+	uint8_t bytes[3];
+	uint32_t hash;
+
+	hash = HOOK_FNV_OFFSET;
+
+	for(i = 0; i < length; i += n) {
+		info = &opcodeTable[code[i]];
+		n = info->length < length - i ? info->length : length - i;
+
+		memcpy(bytes, code + i, n);
+
+		if(n == 3 && (info->flow == opcodeJump || info->flow == opcodeJumpIf
+				|| info->flow == opcodeCall || info->flow == opcodeCallIf)) {
+			target = (bytes[1] | bytes[2] << 8) - address;
+			bytes[1] = target & 0xFF;
+			bytes[2] = target >> 8;
+		}
+
+		for(j = 0; j < n; j++)
+			hash = (hash ^ bytes[j]) * HOOK_FNV_PRIME;
+	}
+
+	return hash;
+}
+
+/* the cpu is at a hooked address, runs the routine if the code there is
+ * still the routine */
+bool hooksRun(struct hooks *hooks, struct cpu8080 *cpu) {
+	struct hook *hook;
+	size_t i;
+
+	if(cpu->readMemory != guestReadMemory)
+		return false;
+
+	for(i = 0; i < hooks->nHooks; i++) {
+		hook = &hooks->hooks[i];
+
+		if(hook->address != cpu->programCounter)
+			continue;
+
+		if(memcmp(cpu->memory + hook->address, hook->code, hook->routine->length) != 0) {
+			hook->misses++;
+			continue;
+		}
+
+		hook->calls++;
+		hook->routine->run(cpu, hook);
+
+		return true;
+	}
+
+	return false;
+}
@@ -0,0 +1,415 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "loader.h"
+
+static struct romImage *imageCache = NULL;
+
+const char *loaderErrorString(uint8_t error) {
+	static const char *strings[] = {
+		[loaderOk] = "ok",
+		[loaderOpenFailed] = "can't open file",
+		[loaderMapFailed] = "can't map file",
+		[loaderOutOfBounds] = "image doesn't fit into memory",
+		[loaderBadManifest] = "malformed manifest",
+		[loaderBadHex] = "malformed intel hex file",
+		[loaderOutOfMemory] = "out of memory",
+		[loaderNoMemfd] = "can't create shared memory",
+		[loaderPathTooLong] = "path too long",
+	};
+
+	if(error >= sizeof(strings) / sizeof(*strings))
+		return "unknown error";
+
+	return strings[error];
+}
+
+/* maps the file read-only, or returns the mapping an earlier call made */
+uint8_t loaderMapImage(const char *path, struct romImage **image) {
+	struct romImage *cached;
+	struct stat status;
+	void *data;
+	int fd;
+
+	for(cached = imageCache; cached != NULL; cached = cached->next) {
+		if(strcmp(cached->path, path) == 0) {
+			cached->references++;
+			*image = cached;
+
+			return loaderOk;
+		}
+	}
+
+	if(strlen(path) >= LOADER_MAX_PATH)
+		return loaderPathTooLong;
+
+	fd = open(path, O_RDONLY);
+
+	if(fd < 0)
+		return loaderOpenFailed;
+
+	if(fstat(fd, &status) != 0) {
+		close(fd);
+		return loaderOpenFailed;
+	}
+
+	/* empty files can't be mapped but are valid images */
+	data = NULL;
+	if(status.st_size > 0) {
+		data = mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+		if(data == MAP_FAILED) {
+			close(fd);
+			return loaderMapFailed;
+		}
+	}
+
+	close(fd);
+
+	cached = malloc(sizeof(*cached));
+
+	if(cached == NULL) {
+		if(data != NULL)
+			munmap(data, status.st_size);
+
+		return loaderOutOfMemory;
+	}
+
+	strcpy(cached->path, path);
+	cached->data = data;
+	cached->size = status.st_size;
+	cached->references = 1;
+	cached->next = imageCache;
+
+	imageCache = cached;
+	*image = cached;
+
+	return loaderOk;
+}
+
+/* released images stay mapped until loaderFlushCache so the next instance
+ * loading them doesn't touch the file system */
+void loaderReleaseImage(struct romImage *image) {
+	if(image->references > 0)
+		image->references--;
+}
+
+void loaderFlushCache(void) {
+	struct romImage **link, *image;
+
+	for(link = &imageCache; *link != NULL; ) {
+		image = *link;
+
+		if(image->references != 0) {
+			link = &image->next;
+			continue;
+		}
+
+		*link = image->next;
+
+		if(image->data != NULL)
+			munmap((void *)image->data, image->size);
+
+		free(image);
+	}
+}
+
+static uint8_t loaderCopy(const uint8_t *data, size_t length, uint8_t *memory, size_t memorySize,
+		size_t address) {
+	if(address > memorySize || length > memorySize - address)
+		return loaderOutOfBounds;
+
+	memcpy(memory + address, data, length);
+
+	return loaderOk;
+}
+
+uint8_t loaderLoadBinary(const char *path, uint8_t *memory, size_t memorySize, uint16_t address) {
+	struct loaderSegment segment;
+
+	if(strlen(path) >= LOADER_MAX_PATH)
+		return loaderPathTooLong;
+
+	strcpy(segment.path, path);
+	segment.offset = 0;
+	segment.length = 0;
+	segment.address = address;
+	segment.kind = segmentRam;
+
+	return loaderLoadSegment(&segment, memory, memorySize);
+}
+
+static int loaderHexDigit(char c) {
+	if(c >= '0' && c <= '9')
+		return c - '0';
+
+	c = toupper((unsigned char)c);
+
+	if(c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+
+	return -1;
+}
+
+static bool loaderHexByte(const uint8_t *text, size_t length, size_t position, uint8_t *byte) {
+	int high, low;
+
+	if(position + 2 > length)
+		return false;
+
+	high = loaderHexDigit(text[position]);
+	low = loaderHexDigit(text[position + 1]);
+
+	if(high < 0 || low < 0)
+		return false;
+
+	*byte = high << 4 | low;
+
+	return true;
+}
+
+/* data (00) and end of file (01) records, base is added to every address.
+ * extended address records only make sense beyond 64k so anything but a
+ * zero base in them is out of bounds */
+static uint8_t loaderParseHex(const uint8_t *text, size_t length, uint8_t *memory, size_t memorySize,
+		size_t base) {
+	uint8_t count, high, low, type, checksum, byte, data[255];
+	size_t position, i;
+
+	for(position = 0; position < length; ) {
+		if(isspace(text[position])) {
+			position++;
+			continue;
+		}
+
+		if(text[position] != ':')
+			return loaderBadHex;
+
+		position++;
+
+		if(!loaderHexByte(text, length, position, &count)
+				|| !loaderHexByte(text, length, position + 2, &high)
+				|| !loaderHexByte(text, length, position + 4, &low)
+				|| !loaderHexByte(text, length, position + 6, &type))
+			return loaderBadHex;
+
+		checksum = count + high + low + type;
+		position += 8;
+
+		for(i = 0; i < count; i++, position += 2) {
+			if(!loaderHexByte(text, length, position, &data[i]))
+				return loaderBadHex;
+
+			checksum += data[i];
+		}
+
+		if(!loaderHexByte(text, length, position, &byte) || (uint8_t)(checksum + byte) != 0)
+			return loaderBadHex;
+
+		position += 2;
+
+		switch(type) {
+			case 0x00:
+				if(loaderCopy(data, count, memory, memorySize, base + (high << 8 | low)) != loaderOk)
+					return loaderOutOfBounds;
+				break;
+
+			case 0x01:
+				return loaderOk;
+
+			case 0x02:
+			case 0x04:
+				for(i = 0; i < count; i++) {
+					if(data[i] != 0)
+						return loaderOutOfBounds;
+				}
+				break;
+
+			/* start addresses */
+			case 0x03:
+			case 0x05:
+				break;
+
+			default:
+				return loaderBadHex;
+		}
+	}
+
+	return loaderOk;
+}
+
+uint8_t loaderLoadHex(const char *path, uint8_t *memory, size_t memorySize) {
+	struct romImage *image;
+	uint8_t error;
+
+	error = loaderMapImage(path, &image);
+
+	if(error != loaderOk)
+		return error;
+
+	error = loaderParseHex(image->data, image->size, memory, memorySize, 0);
+
+	loaderReleaseImage(image);
+
+	return error;
+}
+
+static bool loaderIsHex(const char *path) {
+	const char *extension;
+
+	extension = strrchr(path, '.');
+
+	return extension != NULL && (strcasecmp(extension, ".hex") == 0 || strcasecmp(extension, ".ihx") == 0);
+}
+
+/* copies a segment out of its (shared) mapping, intel hex files are parsed
+ * with the segment address as their base. a binary segment without a length
+ * gets the length that was loaded */
+uint8_t loaderLoadSegment(struct loaderSegment *segment, uint8_t *memory, size_t memorySize) {
+	struct romImage *image;
+	size_t length;
+	uint8_t error;
+
+	error = loaderMapImage(segment->path, &image);
+
+	if(error != loaderOk)
+		return error;
+
+	if(loaderIsHex(segment->path))
+		error = loaderParseHex(image->data, image->size, memory, memorySize, segment->address);
+	else if(segment->offset > image->size)
+		error = loaderOutOfBounds;
+	else {
+		length = segment->length != 0 ? segment->length : image->size - segment->offset;
+
+		if(length > image->size - segment->offset)
+			error = loaderOutOfBounds;
+		else
+			error = loaderCopy(image->data + segment->offset, length, memory, memorySize,
+					segment->address);
+
+		if(error == loaderOk)
+			segment->length = length;
+	}
+
+	loaderReleaseImage(image);
+
+	return error;
+}
+
+/* one segment per line:
+ *
+ *	file offset load-address rom|cow|ram [length]
+ *
+ * numbers may be decimal or 0x prefixed hex, files are relative to the
+ * manifest, '#' starts a comment. rom and cow in an intel hex file need the
+ * length, it isn't known before the file is parsed */
+uint8_t loaderReadManifest(const char *path, struct loaderManifest *manifest) {
+	char line[LOADER_MAX_PATH * 2], file[LOADER_MAX_PATH], kind[8], *comment;
+	long offset, address, length;
+	struct loaderSegment *segment;
+	const char *slash;
+	size_t directory;
+	FILE *stream;
+	int fields;
+
+	stream = fopen(path, "r");
+
+	if(stream == NULL)
+		return loaderOpenFailed;
+
+	manifest->nSegments = 0;
+	slash = strrchr(path, '/');
+
+	while(fgets(line, sizeof(line), stream) != NULL) {
+		comment = strchr(line, '#');
+		if(comment != NULL)
+			*comment = '\0';
+
+		length = 0;
+		fields = sscanf(line, "%255s %li %li %7s %li", file, &offset, &address, kind, &length);
+
+		if(fields <= 0)
+			continue;
+
+		if(fields < 4 || manifest->nSegments == LOADER_MAX_SEGMENTS || offset < 0 || length < 0
+				|| address < 0 || address > 0xFFFF
+				|| (strcmp(kind, "rom") != 0 && strcmp(kind, "cow") != 0
+					&& strcmp(kind, "ram") != 0)) {
+			fclose(stream);
+			return loaderBadManifest;
+		}
+
+		/* the manifest's directory up to and with the slash */
+		directory = file[0] == '/' || slash == NULL ? 0 : (size_t)(slash - path) + 1;
+
+		if(directory + strlen(file) >= LOADER_MAX_PATH) {
+			fclose(stream);
+			return loaderPathTooLong;
+		}
+
+		segment = &manifest->segments[manifest->nSegments++];
+
+		memcpy(segment->path, path, directory);
+		strcpy(segment->path + directory, file);
+
+		segment->offset = offset;
+		segment->length = length;
+		segment->address = address;
+		segment->kind = strcmp(kind, "rom") == 0 ? segmentRom
+			: strcmp(kind, "cow") == 0 ? segmentCow : segmentRam;
+	}
+
+	fclose(stream);
+
+	return loaderOk;
+}
+
+uint8_t loaderLoadManifest(struct loaderManifest *manifest, uint8_t *memory, size_t memorySize) {
+	uint8_t error;
+	size_t i;
+
+	for(i = 0; i < manifest->nSegments; i++) {
+		error = loaderLoadSegment(&manifest->segments[i], memory, memorySize);
+
+		if(error != loaderOk)
+			return error;
+	}
+
+	return loaderOk;
+}
+
+/* loads a manifest (.manifest), an intel hex file (.hex, .ihx) or a raw
+ * binary at address */
+uint8_t loaderLoad(const char *path, uint8_t *memory, size_t memorySize, uint16_t address) {
+	struct loaderManifest *manifest;
+	const char *extension;
+	uint8_t error;
+
+	extension = strrchr(path, '.');
+
+	if(extension == NULL || strcasecmp(extension, ".manifest") != 0)
+		return loaderIsHex(path) ? loaderLoadHex(path, memory, memorySize)
+			: loaderLoadBinary(path, memory, memorySize, address);
+
+	manifest = malloc(sizeof(*manifest));
+
+	if(manifest == NULL)
+		return loaderOutOfMemory;
+
+	error = loaderReadManifest(path, manifest);
+
+	if(error == loaderOk)
+		error = loaderLoadManifest(manifest, memory, memorySize);
+
+	free(manifest);
+
+	return error;
+}
@@ -0,0 +1,388 @@
+#include <string.h>
+
+#include "lockstep.h"
+#include "guest_memory.h"
+
+/* the memory callbacks only get the memory pointer so the harness has to be
+ * reachable from them, only one lockstep session can run at a time */
+static struct lockstep *activeLockstep = NULL;
+
+static struct lockstepSide *lockstepSideOfMemory(uint8_t *memory) {
+	if(activeLockstep->sides[0].cpu->memory == memory)
+		return &activeLockstep->sides[0];
+
+	return &activeLockstep->sides[1];
+}
+
+static struct lockstepSide *lockstepSideOfCpu(struct cpu8080 *cpu) {
+	if(activeLockstep->sides[0].cpu == cpu)
+		return &activeLockstep->sides[0];
+
+	return &activeLockstep->sides[1];
+}
+
+static void lockstepLogWrite(struct lockstepSide *side, uint16_t address, uint8_t data) {
+	if(side->nWrites == LOCKSTEP_MAX_WRITES) {
+		side->overflow = true;
+		return;
+	}
+
+	side->writes[side->nWrites].address = address;
+	side->writes[side->nWrites].data = data;
+	side->nWrites++;
+}
+
+static void lockstepWriteMemory(uint8_t *memory, uint16_t address, uint8_t data) {
+	struct lockstepSide *side;
+
+	side = lockstepSideOfMemory(memory);
+
+	lockstepLogWrite(side, address, data);
+	side->writeMemory(memory, address, data);
+}
+
+/* word writes are logged as two byte writes so an engine is free to split
+ * them up or to merge byte writes */
+static void lockstepWriteMemoryWord(uint8_t *memory, uint16_t address, uint16_t data) {
+	struct lockstepSide *side;
+
+	side = lockstepSideOfMemory(memory);
+
+	lockstepLogWrite(side, address, data & 0xFF);
+	lockstepLogWrite(side, address + 1, data >> 8);
+	side->writeMemoryWord(memory, address, data);
+}
+
+static bool lockstepRegistersEqual(struct lockstep *ls, const uint8_t *a, const uint8_t *b) {
+	return memcmp(a, b, rSTATUS) == 0 && ((a[rSTATUS] ^ b[rSTATUS]) & ls->statusMask) == 0;
+}
+
+static bool lockstepPortOutsEqual(struct lockstep *ls, const struct lockstepPortOut *a,
+		const struct lockstepPortOut *b) {
+	return a->port == b->port && a->data == b->data && a->signal == b->signal
+		&& lockstepRegistersEqual(ls, a->before, b->before)
+		&& lockstepRegistersEqual(ls, a->registers, b->registers);
+}
+
+static void lockstepPortOut(struct cpu8080 *cpu, uint8_t port, uint8_t data) {
+	struct lockstepSide *side, *reference;
+	struct lockstepPortOut *out, *replay;
+
+	side = lockstepSideOfCpu(cpu);
+
+	if(side->nPortOuts == LOCKSTEP_MAX_PORT_IO) {
+		side->overflow = true;
+		return;
+	}
+
+	out = &side->portOuts[side->nPortOuts++];
+	out->port = port;
+	out->data = data;
+	memcpy(out->before, cpu->registers, sizeof(out->before));
+
+	/* only the reference talks to the host */
+	if(side == &activeLockstep->sides[0]) {
+		if(side->portOut != NULL)
+			side->portOut(cpu, port, data);
+
+		out->signal = cpu->signalBuffer;
+		memcpy(out->registers, cpu->registers, sizeof(out->registers));
+	}
+	else {
+		reference = &activeLockstep->sides[0];
+
+		replay = &reference->portOuts[side->nPortOuts - 1];
+
+		/* a candidate that got here differently keeps its registers,
+		 * the comparison of the logs reports it */
+		if(side->nPortOuts <= reference->nPortOuts && replay->port == port && replay->data == data
+				&& lockstepRegistersEqual(activeLockstep, replay->before, out->before)) {
+			cpu->signalBuffer = replay->signal;
+			memcpy(cpu->registers, replay->registers, sizeof(cpu->registers));
+		}
+
+		out->signal = cpu->signalBuffer;
+		memcpy(out->registers, cpu->registers, sizeof(out->registers));
+	}
+}
+
+static uint8_t lockstepPortIn(struct cpu8080 *cpu, uint8_t port) {
+	struct lockstepSide *side;
+	uint8_t data;
+
+	side = lockstepSideOfCpu(cpu);
+
+	if(side == &activeLockstep->sides[1]) {
+		if(activeLockstep->portInsReplayed == activeLockstep->nPortIns) {
+			side->overflow = true;
+			return 0;
+		}
+
+		return activeLockstep->portIns[activeLockstep->portInsReplayed++];
+	}
+
+	data = side->portIn != NULL ? side->portIn(cpu, port) : 0;
+
+	if(activeLockstep->nPortIns == LOCKSTEP_MAX_PORT_IO)
+		side->overflow = true;
+	else
+		activeLockstep->portIns[activeLockstep->nPortIns++] = data;
+
+	return data;
+}
+
+static void lockstepWrapSide(struct lockstepSide *side,
+		const struct cpuEngine *engine, struct cpu8080 *cpu) {
+	side->engine = engine;
+	side->cpu = cpu;
+
+	side->writeMemory = cpu->writeMemory;
+	side->writeMemoryWord = cpu->writeMemoryWord;
+	side->portOut = cpu->portOut;
+	side->portIn = cpu->portIn;
+
+	cpu->writeMemory = lockstepWriteMemory;
+	cpu->writeMemoryWord = lockstepWriteMemoryWord;
+	cpu->portOut = lockstepPortOut;
+	cpu->portIn = lockstepPortIn;
+
+	side->nWrites = 0;
+	side->nPortOuts = 0;
+	side->overflow = false;
+}
+
+static void lockstepUnwrapSide(struct lockstepSide *side) {
+	side->cpu->writeMemory = side->writeMemory;
+	side->cpu->writeMemoryWord = side->writeMemoryWord;
+	side->cpu->portOut = side->portOut;
+	side->cpu->portIn = side->portIn;
+}
+
+/* both cpus must start out in the same state with separate memory buffers
+ * holding the same image */
+void lockstepInit(struct lockstep *ls,
+		const struct cpuEngine *reference, struct cpu8080 *referenceCpu,
+		const struct cpuEngine *candidate, struct cpu8080 *candidateCpu) {
+	lockstepWrapSide(&ls->sides[0], reference, referenceCpu);
+	lockstepWrapSide(&ls->sides[1], candidate, candidateCpu);
+
+	ls->blockCycles = 0;
+	ls->memoryCheckInterval = 0;
+	ls->memorySize = 0x10000;
+	ls->statusMask = 0xFF;
+	ls->comparisons = 0;
+	ls->nPortIns = 0;
+	ls->portInsReplayed = 0;
+	ls->result = lockstepRunning;
+
+	activeLockstep = ls;
+}
+
+void lockstepDestroy(struct lockstep *ls) {
+	lockstepUnwrapSide(&ls->sides[0]);
+	lockstepUnwrapSide(&ls->sides[1]);
+
+	if(activeLockstep == ls)
+		activeLockstep = NULL;
+}
+
+static bool lockstepStatesEqual(struct lockstep *ls, struct cpu8080 *a, struct cpu8080 *b) {
+	return memcmp(a->registers, b->registers, rSTATUS) == 0
+		&& ((a->registers[rSTATUS] ^ b->registers[rSTATUS]) & ls->statusMask) == 0
+		&& a->programCounter == b->programCounter
+		&& a->stackPointer == b->stackPointer
+		&& a->cycleCounter == b->cycleCounter
+		&& a->interruptEnable == b->interruptEnable
+		&& a->halted == b->halted;
+}
+
+/* whether the step was a PUSH PSW with bits of the status left out of
+ * the comparison, and where it stored the status */
+static bool lockstepPushesStatus(struct lockstep *ls, uint16_t *address) {
+	struct cpu8080 *before;
+
+	before = &ls->before;
+	*address = before->stackPointer - 2;
+
+	if(ls->blockCycles != 0 || ls->statusMask == 0xFF
+			|| before->readMemory(before->memory, before->programCounter) != 0xF5)
+		return false;
+
+	return true;
+}
+
+static bool lockstepLogsEqual(struct lockstep *ls) {
+	struct lockstepSide *a, *b;
+	uint16_t status;
+	uint8_t difference;
+	bool masked;
+	size_t i;
+
+	a = &ls->sides[0];
+	b = &ls->sides[1];
+
+	if(a->overflow || b->overflow)
+		return false;
+
+	if(ls->portInsReplayed != ls->nPortIns)
+		return false;
+
+	if(a->nWrites != b->nWrites)
+		return false;
+
+	masked = lockstepPushesStatus(ls, &status);
+
+	for(i = 0; i < a->nWrites; i++) {
+		difference = a->writes[i].data ^ b->writes[i].data;
+
+		if(masked && a->writes[i].address == status)
+			difference &= ls->statusMask;
+
+		if(a->writes[i].address != b->writes[i].address || difference != 0)
+			return false;
+	}
+
+	if(a->nPortOuts != b->nPortOuts)
+		return false;
+
+	for(i = 0; i < a->nPortOuts; i++) {
+		if(!lockstepPortOutsEqual(ls, &a->portOuts[i], &b->portOuts[i]))
+			return false;
+	}
+
+	return true;
+}
+
+/* the first address the memories of the sides differ at, memorySize if
+ * they don't. flat guest memories are compared in place, any other memory
+ * through the callbacks */
+static size_t lockstepMemoryDifference(struct lockstep *ls) {
+	struct cpu8080 *reference, *candidate;
+	size_t i;
+
+	reference = ls->sides[0].cpu;
+	candidate = ls->sides[1].cpu;
+
+	if(reference->readMemory == guestReadMemory && candidate->readMemory == guestReadMemory) {
+		if(memcmp(reference->memory, candidate->memory, ls->memorySize) == 0)
+			return ls->memorySize;
+
+		for(i = 0; reference->memory[i] == candidate->memory[i]; i++)
+			;
+
+		return i;
+	}
+
+	for(i = 0; i < ls->memorySize; i++) {
+		if(reference->readMemory(reference->memory, i) != candidate->readMemory(candidate->memory, i))
+			break;
+	}
+
+	return i;
+}
+
+static void lockstepExecute(struct lockstep *ls, struct lockstepSide *side) {
+	if(ls->blockCycles == 0)
+		side->engine->step(side->cpu);
+	else
+		side->engine->run(side->cpu, ls->blockCycles);
+}
+
+/* executes one instruction (or block) on both engines and compares them */
+uint8_t lockstepStep(struct lockstep *ls) {
+	uint16_t status;
+	size_t i;
+
+	if(ls->result != lockstepRunning)
+		return ls->result;
+
+	activeLockstep = ls;
+
+	for(i = 0; i < 2; i++) {
+		ls->sides[i].nWrites = 0;
+		ls->sides[i].nPortOuts = 0;
+		ls->sides[i].overflow = false;
+	}
+	ls->nPortIns = 0;
+	ls->portInsReplayed = 0;
+
+	ls->before = *ls->sides[0].cpu;
+
+	lockstepExecute(ls, &ls->sides[0]);
+	lockstepExecute(ls, &ls->sides[1]);
+
+	ls->comparisons++;
+
+	if(!lockstepStatesEqual(ls, ls->sides[0].cpu, ls->sides[1].cpu) || !lockstepLogsEqual(ls))
+		return ls->result = lockstepDiverged;
+
+	/* the bits left out aren't carried into memory */
+	if(lockstepPushesStatus(ls, &status))
+		ls->sides[1].writeMemory(ls->sides[1].cpu->memory, status,
+				ls->sides[0].cpu->readMemory(ls->sides[0].cpu->memory, status));
+
+	if(ls->memoryCheckInterval != 0 && ls->comparisons % ls->memoryCheckInterval == 0
+			&& lockstepMemoryDifference(ls) != ls->memorySize)
+		return ls->result = lockstepDiverged;
+
+	if(ls->sides[0].cpu->signalBuffer != noSignal)
+		return ls->result = lockstepFinished;
+
+	return lockstepRunning;
+}
+
+/* runs until the engines diverge, the reference raises a signal or maxSteps
+ * comparisons were done (0 means no limit) */
+uint8_t lockstepRun(struct lockstep *ls, size_t maxSteps) {
+	size_t i;
+
+	for(i = 0; maxSteps == 0 || i < maxSteps; i++) {
+		if(lockstepStep(ls) != lockstepRunning)
+			break;
+	}
+
+	return ls->result;
+}
+
+static void lockstepPrintSide(struct lockstepSide *side) {
+	size_t i;
+
+	printf("%s:\n\t", side->engine->name);
+	printCpuState(*side->cpu);
+
+	for(i = 0; i < side->nWrites; i++)
+		printf("\twrite %04X <- %02X\n", side->writes[i].address, side->writes[i].data);
+
+	for(i = 0; i < side->nPortOuts; i++)
+		printf("\tout %02X <- %02X\n", side->portOuts[i].port, side->portOuts[i].data);
+
+	if(side->overflow)
+		printf("\ti/o log overflowed\n");
+}
+
+void lockstepPrintDivergence(struct lockstep *ls) {
+	size_t i;
+
+	if(ls->result != lockstepDiverged) {
+		printf("no divergence after %lu comparisons\n", ls->comparisons);
+		return;
+	}
+
+	printf("engines diverged at comparison %lu, state before:\n\t", ls->comparisons);
+	printCpuState(ls->before);
+
+	lockstepPrintSide(&ls->sides[0]);
+	lockstepPrintSide(&ls->sides[1]);
+
+	if(ls->portInsReplayed != ls->nPortIns)
+		printf("port inputs: %lu read by %s, %lu by %s\n",
+				ls->nPortIns, ls->sides[0].engine->name,
+				ls->portInsReplayed, ls->sides[1].engine->name);
+
+	i = lockstepMemoryDifference(ls);
+
+	if(i != ls->memorySize)
+		printf("first memory difference at %04lX: %02X != %02X\n", i,
+				ls->sides[0].cpu->readMemory(ls->sides[0].cpu->memory, i),
+				ls->sides[1].cpu->readMemory(ls->sides[1].cpu->memory, i));
+}
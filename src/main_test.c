@@ -3,80 +3,180 @@
 #include "cpu.h"
 #include "util.h"
 #include "memory.h"
-
-void testPortOut(struct cpu8080 *cpu, uint8_t port) {
-	if(cpu->readMemory(cpu->memory, cpu->programCounter) == 0) {
-		cpu->signalBuffer = exitSignal;
-	}
-	else if(cpu->readMemory(cpu->memory, cpu->programCounter) == 1) {
-		if(cpu->registers[rC] == 2)
-			printf("%c", cpu->registers[rE]);
-		if(cpu->registers[rC] == 9) {
-			uint16_t i = 
-				(cpu->registers[rD] << 8 | cpu->registers[rE] & 0x00FF);
-			while(cpu->readMemory(cpu->memory, i) != '$')
-				printf("%c", cpu->readMemory(cpu->memory, i++));
-		}
+#include "test_machine.h"
+#include "loader.h"
+#include "pool.h"
+#include "coverage.h"
+#include "heatmap.h"
+#include "debugger.h"
+#include "hooks.h"
+
+#ifdef CPU_COVERAGE
+/* writes <rom>.info, functions come from <rom>.sym if there is one */
+static void writeCoverage(struct coverage *coverage, const char *testPath) {
+	struct coverageSymbol *symbols;
+	size_t nSymbols;
+	char path[FILENAME_MAX];
+	FILE *stream;
+
+	snprintf(path, sizeof(path), "%s.sym", testPath);
+	nSymbols = coverageReadSymbols(path, &symbols);
+
+	snprintf(path, sizeof(path), "%s.info", testPath);
+	stream = fopen(path, "w");
+
+	if(stream != NULL) {
+		coverageWriteLcov(coverage, stream, testPath, symbols, nSymbols);
+		fclose(stream);
 	}
 
+	printf("coverage: %lu addresses, %lu edges -> %s\n",
+			coverageCountExecuted(coverage), coverageCountEdges(coverage), path);
+
+	free(symbols);
+}
+#endif /* #ifdef CPU_COVERAGE */
+
+#ifdef CPU_HEATMAP
+/* cycles per heatmap interval */
+#ifndef HEATMAP_INTERVAL
+#define HEATMAP_INTERVAL	(1 << 20)
+#endif
+
+/* intervals go to <rom>.heat */
+static FILE *openHeatmap(const char *testPath) {
+	char path[FILENAME_MAX];
+	FILE *stream;
+
+	snprintf(path, sizeof(path), "%s.heat", testPath);
+	stream = fopen(path, "w");
+
+	if(stream == NULL)
+		perror(path);
+
+	return stream;
 }
+#endif /* #ifdef CPU_HEATMAP */
+
+void runTest(struct instancePool *pool, const char *testPath) {
+	struct testMachine *machine;
+	struct console console;
+	struct debugger debugger;
+	struct hooks hooks;
 
-void runTest(const char *testPath) {
-	struct cpu8080 cpu;
+	uint8_t error;
 
-	cpu.memory = calloc(0xffff, sizeof(*(cpu.memory)));
+#ifdef CPU_HEATMAP
+	struct heatmap *heatmap;
+	FILE *heatmapStream;
+	size_t nextInterval;
+#endif
 
-	if(cpu.memory == NULL) {
+	machine = instancePoolAcquire(pool);
+
+	if(machine == NULL || !consoleInitStream(&console, stdout)) {
 		exit(1);
 	}
 
-	loadRom(cpu.memory, testPath, 0x100);
-	
-	cpu.memory[0x0000] = 0xD3;
-        cpu.memory[0x0001] = 0x00;
+	error = testMachineInit(machine, guestMemoryFromBase(machine->cpu.memory), testPath, &console);
 
-        cpu.memory[0x0005] = 0xD3;
-        cpu.memory[0x0006] = 0x01;
-        cpu.memory[0x0007] = 0xC9;
+	if(error != loaderOk) {
+		fprintf(stderr, "%s: %s\n", testPath, loaderErrorString(error));
+		exit(1);
+	}
 
-	cpu.readMemory = testReadMemory;
-	cpu.readMemoryWord = testReadMemoryWord;
-	cpu.writeMemory = testWriteMemory;
-	cpu.writeMemoryWord = testWriteMemoryWord;
+#ifdef CPU_COVERAGE
+	machine->cpu.coverage = calloc(1, sizeof(*machine->cpu.coverage));
+#endif
 
-	cpu.portOut = testPortOut;
+#ifdef CPU_HEATMAP
+	heatmap = calloc(1, sizeof(*heatmap));
+	heatmapStream = openHeatmap(testPath);
+	nextInterval = HEATMAP_INTERVAL;
 
-	cpu.programCounter = 0x100;
+	if(heatmap != NULL && heatmapStream != NULL)
+		heatmapAttach(heatmap, &machine->cpu);
+#endif
 
-	cpu.registers[rSTATUS] = (0 << 5) | (0 << 3) | (1 << 1);
+	debuggerAttach(&debugger, &machine->cpu);
 
-	cpu.cycleCounter = 0;
-	
-	cpu.signalBuffer = noSignal;
+#ifdef SINGLE_STEP
+	debuggerStep(&debugger, true);
+#endif
+
+	hooksInit(&hooks);
+	hooksScan(&hooks, machine->cpu.memory, TEST_MEMORY_SIZE);
+	machine->cpu.hooks = &hooks;
 
 	for(;;) {
-		cpuExecuteInstruction(&cpu);
+		if(!testMachineTrap(machine))
+			cpuExecuteInstruction(&machine->cpu);
 
-		if(cpu.signalBuffer == exitSignal) {
+		if(machine->cpu.signalBuffer == exitSignal) {
+			testMachineFinish(machine);
 			printf("\ntest finished. cpu's final state:\n");
-			printCpuState(cpu);
+			printCpuState(machine->cpu);
 			puts("exiting loop...");
 			break;
 		}
 
-#ifdef SINGLE_STEP 
-#warning "single stepping is not recommended for debugging"
-		fgetc(stdin);
+#ifdef CPU_HEATMAP
+		if(machine->cpu.cycleCounter >= nextInterval && heatmapStream != NULL) {
+			heatmapDump(heatmap, heatmapStream, machine->cpu.cycleCounter);
+			nextInterval += HEATMAP_INTERVAL;
+		}
+#endif
+
+#ifdef DEBUG
+		/* keep guest output in order with the trace */
+		consoleFlush(&console);
 #endif
+
+		if(machine->cpu.signalBuffer == breakpointSignal) {
+			/* guest output up to the stop goes before the prompt */
+			portTableFlush(&machine->ports);
+			consoleFlush(&console);
+			debuggerPrompt(&debugger, stdin, stdout);
+		}
 	}
 
-	free(cpu.memory);
+	debuggerDetach(&debugger);
+
+	hooksPrint(&hooks, stdout);
+	machine->cpu.hooks = NULL;
+
+#ifdef CPU_COVERAGE
+	writeCoverage(machine->cpu.coverage, testPath);
+	free(machine->cpu.coverage);
+#endif
+
+#ifdef CPU_HEATMAP
+	if(heatmapStream != NULL) {
+		heatmapDump(heatmap, heatmapStream, machine->cpu.cycleCounter);
+		fclose(heatmapStream);
+	}
+
+	/* the pool doesn't know about it */
+	heatmapAttach(NULL, &machine->cpu);
+	free(heatmap);
+#endif
+
+	consoleDestroy(&console);
+	instancePoolRelease(pool, machine);
 }
 
 int main(void) {
-	//runTest("cpu_tests/8080EXM.COM");
-	runTest("cpu_tests/CPUTEST.COM");
-	runTest("cpu_tests/TST8080.COM");
+	struct instancePool pool;
+
+	/* the tests run one after the other in the same instance */
+	if(!instancePoolInit(&pool, 1, sizeof(struct testMachine), NULL))
+		exit(1);
+
+	//runTest(&pool, "cpu_tests/8080EXM.COM");
+	runTest(&pool, "cpu_tests/CPUTEST.COM");
+	runTest(&pool, "cpu_tests/TST8080.COM");
+
+	instancePoolDestroy(&pool);
 	
 	return EXIT_SUCCESS;
 }
@@ -0,0 +1,8 @@
+#include "opcodes.h"
+
+const struct opcodeInfo opcodeTable[256] = {
+#define OPCODE(opcode, mnemonic, length, cycles, cyclesNotTaken, flags, flow, undocumented) \
+	[opcode] = { mnemonic, sizeof(mnemonic) - 1, length, cycles, cyclesNotTaken, flags, flow, undocumented },
+#include "opcodes.def"
+#undef OPCODE
+};
@@ -0,0 +1,136 @@
+#include <stdlib.h>
+#include <strings.h>
+#include <errno.h>
+
+#include "pacer.h"
+
+static uint64_t pacerNow(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t)now.tv_sec * PACER_NS + now.tv_nsec;
+}
+
+static uint64_t pacerStart(struct pacer *pacer) {
+	return (uint64_t)pacer->start.tv_sec * PACER_NS + pacer->start.tv_nsec;
+}
+
+static void pacerSetStart(struct pacer *pacer, uint64_t start) {
+	pacer->start.tv_sec = start / PACER_NS;
+	pacer->start.tv_nsec = start % PACER_NS;
+}
+
+/* the wall time cycle stands for, relative to start. split so it doesn't
+ * overflow for hours of guest time */
+static uint64_t pacerDeadline(struct pacer *pacer, uint64_t cycle) {
+	uint64_t elapsed;
+
+	elapsed = cycle - pacer->startCycle;
+
+	return elapsed / pacer->hz * PACER_NS + elapsed % pacer->hz * PACER_NS / pacer->hz;
+}
+
+/* cycle is the cycle counter now, quantumNs 0 takes PACER_QUANTUM_NS */
+void pacerInit(struct pacer *pacer, uint64_t hz, uint64_t quantumNs, uint64_t cycle) {
+	if(quantumNs == 0)
+		quantumNs = PACER_QUANTUM_NS;
+
+	pacer->hz = hz;
+	pacer->quantum = hz * quantumNs / PACER_NS;
+
+	if(pacer->quantum == 0)
+		pacer->quantum = 1;
+
+	pacer->spin = PACER_SPIN_NS;
+	pacer->maxLag = PACER_MAX_LAG_NS;
+
+	pacer->waits = pacer->late = pacer->dropped = pacer->maxLateness = 0;
+
+	pacerRebase(pacer, cycle);
+}
+
+/* starts over from now, for when the cpu was stopped on purpose */
+void pacerRebase(struct pacer *pacer, uint64_t cycle) {
+	pacerSetStart(pacer, pacerNow());
+	pacer->startCycle = cycle;
+}
+
+/* waits until the wall clock catches up with cycle. most of the wait is
+ * slept on an absolute deadline, the last spin ns are spun */
+void pacerWait(struct pacer *pacer, uint64_t cycle) {
+	uint64_t start, deadline, now, lateness;
+	struct timespec wake;
+
+	pacer->waits++;
+
+	start = pacerStart(pacer);
+	deadline = start + pacerDeadline(pacer, cycle);
+	now = pacerNow();
+
+	if(now >= deadline) {
+		lateness = now - deadline;
+
+		if(lateness != 0)
+			pacer->late++;
+
+		if(lateness > pacer->maxLateness)
+			pacer->maxLateness = lateness;
+
+		/* the time past maxLag is given up, the rest is caught up by
+		 * not waiting on the next quanta */
+		if(lateness > pacer->maxLag) {
+			pacer->dropped += lateness - pacer->maxLag;
+			pacerSetStart(pacer, start + lateness - pacer->maxLag);
+		}
+
+		return;
+	}
+
+	if(deadline - now > pacer->spin) {
+		wake.tv_sec = (deadline - pacer->spin) / PACER_NS;
+		wake.tv_nsec = (deadline - pacer->spin) % PACER_NS;
+
+		while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL) == EINTR)
+			;
+	}
+
+	while(pacerNow() < deadline)
+		;
+}
+
+/* a clock rate in hz, with an optional k, M or G and "Hz". 0 if it isn't
+ * one or isn't between 1 and PACER_MAX_RATE */
+uint64_t pacerParseRate(const char *text) {
+	double rate;
+	char *end;
+
+	rate = strtod(text, &end);
+
+	switch(*end) {
+		case 'k':
+		case 'K':
+			rate *= 1e3;
+			end++;
+			break;
+
+		case 'M':
+			rate *= 1e6;
+			end++;
+			break;
+
+		case 'G':
+			rate *= 1e9;
+			end++;
+			break;
+	}
+
+	if(*end != '\0' && strcasecmp(end, "hz") != 0)
+		return 0;
+
+	/* nan fails both comparisons, infinity the second */
+	if(!(rate >= 1 && rate <= PACER_MAX_RATE))
+		return 0;
+
+	return rate + 0.5;
+}
@@ -0,0 +1,101 @@
+#include <string.h>
+#include <stdlib.h>
+
+#include "pool.h"
+
+static void *poolInstance(struct instancePool *pool, size_t index) {
+	return pool->arena + index * pool->instanceSize;
+}
+
+/* zeroes the instance and points it at its memory, the address space has
+ * been reset already */
+static void poolPrepare(struct instancePool *pool, size_t index) {
+	struct cpu8080 *cpu;
+
+	cpu = poolInstance(pool, index);
+	memset(cpu, 0, pool->instanceSize);
+
+	cpu->memory = pool->memories[index]->base;
+
+	cpu->readMemory = guestReadMemory;
+	cpu->readMemoryWord = guestReadMemoryWord;
+	cpu->writeMemory = guestWriteMemory;
+	cpu->writeMemoryWord = guestWriteMemoryWord;
+
+	/* bit 1 of the status register always reads as 1 */
+	cpu->registers[rSTATUS] = 1 << 1;
+}
+
+bool instancePoolInit(struct instancePool *pool, size_t capacity, size_t instanceSize,
+		struct guestImage *image) {
+	size_t i;
+
+	pool->instanceSize = (instanceSize + POOL_ALIGNMENT - 1) & ~(size_t)(POOL_ALIGNMENT - 1);
+	pool->capacity = capacity;
+	pool->image = image;
+
+	pool->arena = aligned_alloc(POOL_ALIGNMENT, pool->instanceSize * capacity);
+	pool->memories = calloc(capacity, sizeof(*pool->memories));
+	pool->free = malloc(capacity * sizeof(*pool->free));
+	pool->nFree = 0;
+
+	if(pool->arena == NULL || pool->memories == NULL || pool->free == NULL) {
+		instancePoolDestroy(pool);
+		return false;
+	}
+
+	/* handed out lowest index first */
+	for(i = capacity; i-- > 0; ) {
+		pool->memories[i] = guestMemoryCreate();
+
+		if(pool->memories[i] == NULL
+				|| (image != NULL && !guestMemoryMapImage(pool->memories[i], image))) {
+			instancePoolDestroy(pool);
+			return false;
+		}
+
+		poolPrepare(pool, i);
+		pool->free[pool->nFree++] = i;
+	}
+
+	return true;
+}
+
+void instancePoolDestroy(struct instancePool *pool) {
+	size_t i;
+
+	if(pool->memories != NULL) {
+		for(i = 0; i < pool->capacity; i++) {
+			if(pool->memories[i] != NULL)
+				guestMemoryDestroy(pool->memories[i]);
+		}
+	}
+
+	free(pool->arena);
+	free(pool->memories);
+	free(pool->free);
+
+	pool->arena = NULL;
+	pool->memories = NULL;
+	pool->free = NULL;
+	pool->nFree = 0;
+}
+
+/* NULL when every instance is in use */
+void *instancePoolAcquire(struct instancePool *pool) {
+	if(pool->nFree == 0)
+		return NULL;
+
+	return poolInstance(pool, pool->free[--pool->nFree]);
+}
+
+/* resets the instance right away so the next acquire is free */
+void instancePoolRelease(struct instancePool *pool, void *instance) {
+	size_t index;
+
+	index = ((uint8_t *)instance - pool->arena) / pool->instanceSize;
+
+	guestMemoryReset(pool->memories[index]);
+	poolPrepare(pool, index);
+	pool->free[pool->nFree++] = index;
+}
@@ -0,0 +1,102 @@
+#include "ports.h"
+
+/* used when a table is set up without a default device */
+static struct portDevice openBus = {
+	.name = "open bus",
+};
+
+/* unmapped may be NULL */
+void portTableInit(struct portTable *table, struct portDevice *unmapped) {
+	unsigned i;
+
+	table->unmapped = unmapped != NULL ? unmapped : &openBus;
+
+	for(i = 0; i < PORTS; i++)
+		table->devices[i] = table->unmapped;
+
+	table->batchDevice = NULL;
+	table->batchLength = 0;
+}
+
+/* hands the open batch to its device */
+void portTableFlush(struct portTable *table) {
+	struct portDevice *device;
+
+	device = table->batchDevice;
+
+	if(device == NULL)
+		return;
+
+	table->batchDevice = NULL;
+	device->outBatch(device, table->batchCpu, table->batchPort, table->batch, table->batchLength);
+	table->batchLength = 0;
+}
+
+/* hands the open batch over once it's PORT_BATCH_CYCLES old at cycle */
+void portTableAge(struct portTable *table, size_t cycle) {
+	if(table->batchDevice != NULL && cycle - table->batchStart >= PORT_BATCH_CYCLES)
+		portTableFlush(table);
+}
+
+void portTableMap(struct portTable *table, uint8_t port, struct portDevice *device) {
+	portTableFlush(table);
+
+	table->devices[port] = device != NULL ? device : table->unmapped;
+}
+
+void portTableMapRange(struct portTable *table, uint8_t first, unsigned count, struct portDevice *device) {
+	unsigned i;
+
+	for(i = 0; i < count && first + i < PORTS; i++)
+		portTableMap(table, first + i, device);
+}
+
+void portTableUnmap(struct portTable *table, uint8_t port) {
+	portTableMap(table, port, NULL);
+}
+
+uint8_t portTableIn(struct cpu8080 *cpu, uint8_t port) {
+	struct portDevice *device;
+
+	portTableFlush(cpu->ports);
+
+	device = cpu->ports->devices[port];
+
+	if(device->in == NULL)
+		return 0xFF;
+
+	return device->in(device, cpu, port);
+}
+
+void portTableOut(struct cpu8080 *cpu, uint8_t port, uint8_t data) {
+	struct portDevice *device;
+	struct portTable *table;
+
+	table = cpu->ports;
+	device = table->devices[port];
+
+	if(device->outBatch == NULL) {
+		portTableFlush(table);
+
+		if(device->out != NULL)
+			device->out(device, cpu, port, data);
+
+		return;
+	}
+
+	if(table->batchDevice != NULL && (table->batchPort != port || table->batchCpu != cpu
+			|| cpu->cycleCounter - table->batchStart >= PORT_BATCH_CYCLES))
+		portTableFlush(table);
+
+	if(table->batchDevice == NULL) {
+		table->batchDevice = device;
+		table->batchCpu = cpu;
+		table->batchPort = port;
+		table->batchStart = cpu->cycleCounter;
+	}
+
+	table->batch[table->batchLength++] = data;
+
+	if(table->batchLength == PORT_BATCH_SIZE)
+		portTableFlush(table);
+}
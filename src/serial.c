@@ -0,0 +1,177 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+
+#include "serial.h"
+
+static uint8_t serialStatusIn(struct portDevice *device, struct cpu8080 *cpu, uint8_t port) {
+	struct serialDevice *serial;
+	uint8_t status;
+
+	serial = device->context;
+	status = 0;
+
+	if(!spscEmpty(serial->input)) {
+		status |= serialRxReady;
+
+		if(serial->control & SERIAL_CONTROL_RX_INTERRUPT)
+			status |= serialInterruptRequest;
+	}
+
+	if(!spscFull(serial->output))
+		status |= serialTxEmpty;
+
+	/* a guest waiting to send isn't waiting for input */
+	if(status == serialTxEmpty)
+		serial->emptyPolls++;
+
+	return status;
+}
+
+static void serialStatusOut(struct portDevice *device, struct cpu8080 *cpu, uint8_t port, uint8_t data) {
+	struct serialDevice *serial;
+
+	serial = device->context;
+
+	/* a master reset leaves the interrupt off until the next control word */
+	if((data & SERIAL_CONTROL_RESET) == SERIAL_CONTROL_RESET)
+		serial->control = 0;
+	else
+		serial->control = data;
+}
+
+/* with nothing received the data register still holds the last byte */
+static uint8_t serialDataIn(struct portDevice *device, struct cpu8080 *cpu, uint8_t port) {
+	struct serialDevice *serial;
+
+	serial = device->context;
+
+	if(spscPopByte(serial->input, &serial->received))
+		serial->transfers++;
+
+	return serial->received;
+}
+
+static void serialDataOutBatch(struct portDevice *device, struct cpu8080 *cpu, uint8_t port,
+		const uint8_t *data, size_t length) {
+	struct serialDevice *serial;
+	size_t written;
+
+	serial = device->context;
+
+	written = spscPush(serial->output, data, length);
+
+	if(written != 0 && spscWakeNeeded(serial->output))
+		serial->wake(serial->wakeContext);
+
+	serial->transfers += written;
+	serial->dropped += length - written;
+}
+
+static void serialWakeThread(void *context) {
+	deviceThreadWake(context);
+}
+
+static bool serialRaw(int fd) {
+	struct termios attributes;
+
+	if(tcgetattr(fd, &attributes) != 0)
+		return false;
+
+	cfmakeraw(&attributes);
+
+	return tcsetattr(fd, TCSANOW, &attributes) == 0;
+}
+
+/* the device isn't on any port until serialMap */
+void serialInit(struct serialDevice *serial, struct spscQueue *input, struct spscQueue *output,
+		void (*wake)(void *), void *wakeContext, uint8_t vector) {
+	memset(serial, 0, sizeof(*serial));
+
+	serial->input = input;
+	serial->output = output;
+	serial->wake = wake;
+	serial->wakeContext = wakeContext;
+
+	serial->vector = vector;
+	serial->master = serial->slave = -1;
+
+	serial->status = (struct portDevice){ .name = "serial status", .in = serialStatusIn,
+		.out = serialStatusOut, .context = serial };
+	serial->data = (struct portDevice){ .name = "serial data", .in = serialDataIn,
+		.outBatch = serialDataOutBatch, .context = serial };
+}
+
+/* opens a pseudo-terminal for the host side, its name is in serial->name */
+bool serialOpenPty(struct serialDevice *serial, uint8_t vector) {
+	const char *name;
+
+	serialInit(serial, &serial->thread.input, &serial->thread.output, serialWakeThread,
+			&serial->thread, vector);
+
+	serial->master = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+
+	if(serial->master < 0)
+		return false;
+
+	if(grantpt(serial->master) != 0 || unlockpt(serial->master) != 0
+			|| (name = ptsname(serial->master)) == NULL)
+		goto fail;
+
+	snprintf(serial->name, sizeof(serial->name), "%s", name);
+
+	serial->slave = open(serial->name, O_RDWR | O_NOCTTY | O_CLOEXEC);
+
+	/* bytes go through untouched, the terminal on the other end echoes */
+	if(serial->slave < 0 || !serialRaw(serial->slave))
+		goto fail;
+
+	if(!deviceThreadStart(&serial->thread, serial->master, serial->master, SERIAL_QUEUE_SIZE))
+		goto fail;
+
+	return true;
+
+fail:
+	if(serial->slave >= 0)
+		close(serial->slave);
+
+	close(serial->master);
+
+	return false;
+}
+
+/* closes a pty opened by serialOpenPty. output the guest queued is written
+ * out first, unmap the device before.
+ * without the slave held open, output nobody reads is dropped instead of
+ * waiting for a reader */
+void serialClose(struct serialDevice *serial) {
+	close(serial->slave);
+
+	deviceThreadStop(&serial->thread);
+
+	close(serial->master);
+}
+
+void serialMap(struct serialDevice *serial, struct portTable *table, uint8_t statusPort, uint8_t dataPort) {
+	portTableMap(table, statusPort, &serial->status);
+	portTableMap(table, dataPort, &serial->data);
+}
+
+/* the interrupt line is level triggered: it's raised while a byte waits and
+ * the guest enabled the interrupt, and a request that wasn't taken yet is
+ * withdrawn once the byte was read */
+void serialPoll(struct serialDevice *serial, struct cpu8080 *cpu) {
+	/* output the guest stopped adding to goes out once it's old */
+	if(cpu->ports != NULL)
+		portTableAge(cpu->ports, cpu->cycleCounter);
+
+	if((serial->control & SERIAL_CONTROL_RX_INTERRUPT) && !spscEmpty(serial->input))
+		cpuInterrupt(cpu, serial->vector);
+	else if(cpu->interruptPending && cpu->interruptOpcode == serial->vector)
+		cpu->interruptPending = false;
+}
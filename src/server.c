@@ -0,0 +1,635 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "server.h"
+#include "loader.h"
+
+#define SERVER_EVENTS		64
+
+/* the run queue, workers take sessions from the head */
+static void serverEnqueue(struct server *server, struct serverSession *session) {
+	pthread_mutex_lock(&server->lock);
+
+	session->next = NULL;
+
+	if(server->runTail != NULL)
+		server->runTail->next = session;
+	else
+		server->runHead = session;
+
+	server->runTail = session;
+
+	pthread_cond_signal(&server->runnable);
+	pthread_mutex_unlock(&server->lock);
+}
+
+/* queues an idle session, any other is queued or running already */
+static void serverSchedule(struct serverSession *session) {
+	int idle;
+
+	idle = sessionIdle;
+
+	if(atomic_compare_exchange_strong(&session->state, &idle, sessionQueued))
+		serverEnqueue(session->server, session);
+}
+
+/* the socket is edge triggered, modifying it reports whatever it's ready
+ * for again. that's how workers get the i/o thread to look at a session */
+static void serverKick(void *context) {
+	struct serverSession *session;
+	struct epoll_event event;
+
+	session = context;
+
+	event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+	event.data.ptr = session;
+
+	epoll_ctl(session->server->epollFd, EPOLL_CTL_MOD, session->fd, &event);
+}
+
+/* a one segment manifest for a binary or intel hex file, binaries are
+ * shared copy on write */
+static uint8_t serverReadImage(const char *rom, uint16_t address, struct loaderManifest *manifest) {
+	const char *extension;
+	struct loaderSegment *segment;
+
+	extension = strrchr(rom, '.');
+
+	if(extension != NULL && strcasecmp(extension, ".manifest") == 0)
+		return loaderReadManifest(rom, manifest);
+
+	if(strlen(rom) >= LOADER_MAX_PATH)
+		return loaderPathTooLong;
+
+	manifest->nSegments = 1;
+	segment = &manifest->segments[0];
+
+	strcpy(segment->path, rom);
+	segment->offset = 0;
+	segment->length = 0;
+	segment->address = address;
+	segment->kind = extension != NULL && (strcasecmp(extension, ".hex") == 0
+			|| strcasecmp(extension, ".ihx") == 0) ? segmentRam : segmentCow;
+
+	return loaderOk;
+}
+
+/* sessions run rom (a binary or intel hex file, or a manifest) from entry,
+ * at most maxSessions at a time. a loader error is left in error */
+bool serverInit(struct server *server, const char *rom, uint16_t entry, size_t maxSessions,
+		const struct cpuEngine *engine, uint8_t *error) {
+	struct loaderManifest *manifest;
+
+	memset(server, 0, sizeof(*server));
+
+	server->engine = engine;
+	server->entry = entry;
+	server->listenFd = server->wakeFd = server->epollFd = -1;
+
+	pthread_mutex_init(&server->lock, NULL);
+	pthread_cond_init(&server->runnable, NULL);
+
+	atomic_init(&server->stop, false);
+	atomic_init(&server->sessions, 0);
+
+	manifest = malloc(sizeof(*manifest));
+
+	if(manifest == NULL) {
+		*error = loaderOutOfMemory;
+		return false;
+	}
+
+	*error = serverReadImage(rom, entry, manifest);
+
+	if(*error == loaderOk)
+		server->image = guestImageCreate(manifest, error);
+
+	free(manifest);
+
+	if(server->image == NULL) {
+		serverDestroy(server);
+		return false;
+	}
+
+	*error = loaderOk;
+
+	if(!instancePoolInit(&server->pool, maxSessions, sizeof(struct serverSession), server->image)) {
+		guestImageDestroy(server->image);
+		server->image = NULL;
+		serverDestroy(server);
+		return false;
+	}
+
+	server->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	server->epollFd = epoll_create1(EPOLL_CLOEXEC);
+
+	if(server->wakeFd < 0 || server->epollFd < 0) {
+		serverDestroy(server);
+		return false;
+	}
+
+	return true;
+}
+
+static bool serverWatch(struct server *server, int fd, void *pointer, uint32_t events) {
+	struct epoll_event event;
+
+	event.events = events;
+	event.data.ptr = pointer;
+
+	return epoll_ctl(server->epollFd, EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+/* address is a path for a unix socket, otherwise [host:]port with the host
+ * defaulting to the loopback address */
+bool serverListen(struct server *server, const char *address) {
+	struct sockaddr_un local;
+	struct sockaddr_in inet;
+	const char *colon;
+	char host[INET_ADDRSTRLEN];
+	int fd, on;
+
+	on = 1;
+
+	if(strchr(address, '/') != NULL) {
+		if(strlen(address) >= sizeof(local.sun_path))
+			return false;
+
+		memset(&local, 0, sizeof(local));
+		local.sun_family = AF_UNIX;
+		strcpy(local.sun_path, address);
+
+		fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+		if(fd < 0)
+			return false;
+
+		unlink(address);
+
+		if(bind(fd, (struct sockaddr *)&local, sizeof(local)) != 0) {
+			close(fd);
+			return false;
+		}
+
+		server->unixSocket = true;
+		strcpy(server->path, address);
+	}
+	else {
+		memset(&inet, 0, sizeof(inet));
+		inet.sin_family = AF_INET;
+
+		colon = strrchr(address, ':');
+
+		snprintf(host, sizeof(host), "%.*s", colon != NULL ? (int)(colon - address) : 0, address);
+		inet.sin_port = htons(strtoul(colon != NULL ? colon + 1 : address, NULL, 10));
+
+		if(inet_pton(AF_INET, host[0] != '\0' ? host : "127.0.0.1", &inet.sin_addr) != 1)
+			return false;
+
+		fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+		if(fd < 0)
+			return false;
+
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+		if(bind(fd, (struct sockaddr *)&inet, sizeof(inet)) != 0) {
+			close(fd);
+			return false;
+		}
+	}
+
+	if(listen(fd, SOMAXCONN) != 0 || !serverWatch(server, fd, &server->listenFd, EPOLLIN)) {
+		close(fd);
+		return false;
+	}
+
+	server->listenFd = fd;
+
+	return true;
+}
+
+/* a fresh machine for a connection, NULL if the server is full */
+static struct serverSession *serverOpenSession(struct server *server, int fd) {
+	struct serverSession *session;
+	struct cpu8080 *cpu;
+
+	pthread_mutex_lock(&server->lock);
+	session = instancePoolAcquire(&server->pool);
+	pthread_mutex_unlock(&server->lock);
+
+	if(session == NULL)
+		return NULL;
+
+	if(!spscInit(&session->input, SERVER_QUEUE_SIZE))
+		goto fail;
+
+	if(!spscInit(&session->output, SERVER_QUEUE_SIZE)) {
+		spscDestroy(&session->input);
+		goto fail;
+	}
+
+	session->server = server;
+	session->fd = fd;
+
+	atomic_init(&session->state, sessionIdle);
+	atomic_init(&session->closed, false);
+	atomic_init(&session->inputStalled, false);
+	atomic_init(&session->arrivals, 0);
+
+	cpu = &session->cpu;
+	cpu->programCounter = server->entry;
+	cpu->registers[rSTATUS] = 1 << 1;
+	cpu->signalBuffer = noSignal;
+
+	serialInit(&session->serial, &session->input, &session->output, serverKick, session, SERIAL_VECTOR);
+
+	portTableInit(&session->ports, NULL);
+	serialMap(&session->serial, &session->ports, SERIAL_STATUS_PORT, SERIAL_DATA_PORT);
+
+	cpu->ports = &session->ports;
+	cpu->portOut = portTableOut;
+	cpu->portIn = portTableIn;
+
+	pthread_mutex_lock(&server->lock);
+
+	session->previousLive = NULL;
+	session->nextLive = server->live;
+
+	if(server->live != NULL)
+		server->live->previousLive = session;
+
+	server->live = session;
+
+	pthread_mutex_unlock(&server->lock);
+
+	atomic_fetch_add(&server->sessions, 1);
+
+	return session;
+
+fail:
+	pthread_mutex_lock(&server->lock);
+	instancePoolRelease(&server->pool, session);
+	pthread_mutex_unlock(&server->lock);
+
+	return NULL;
+}
+
+/* the connection has to be out of the epoll set */
+static void serverCloseSession(struct server *server, struct serverSession *session) {
+	close(session->fd);
+
+	spscDestroy(&session->input);
+	spscDestroy(&session->output);
+
+	pthread_mutex_lock(&server->lock);
+
+	if(session->previousLive != NULL)
+		session->previousLive->nextLive = session->nextLive;
+	else
+		server->live = session->nextLive;
+
+	if(session->nextLive != NULL)
+		session->nextLive->previousLive = session->previousLive;
+
+	instancePoolRelease(&server->pool, session);
+
+	pthread_mutex_unlock(&server->lock);
+
+	atomic_fetch_sub(&server->sessions, 1);
+}
+
+static void serverAccept(struct server *server) {
+	struct serverSession *session;
+	int fd;
+
+	for(;;) {
+		fd = accept4(server->listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+		if(fd < 0) {
+			if(errno == EINTR || errno == ECONNABORTED)
+				continue;
+
+			return;
+		}
+
+		session = serverOpenSession(server, fd);
+
+		if(session == NULL) {
+			send(fd, "server full\r\n", 13, MSG_NOSIGNAL | MSG_DONTWAIT);
+			close(fd);
+			continue;
+		}
+
+		if(!serverWatch(server, fd, session, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET)) {
+			serverCloseSession(server, session);
+			continue;
+		}
+
+		serverSchedule(session);
+	}
+}
+
+/* writes queued output until the socket doesn't take more, output to a
+ * connection that failed is dropped */
+static void serverWriteOutput(struct serverSession *session) {
+	ssize_t length;
+
+	for(;;) {
+		if(session->pendingLength == 0) {
+			session->pendingOffset = 0;
+			session->pendingLength = spscPop(&session->output, session->pending, sizeof(session->pending));
+
+			/* the worker kicks the session for output queued from now on */
+			if(session->pendingLength == 0) {
+				if(spscSleep(&session->output))
+					return;
+
+				continue;
+			}
+		}
+
+		length = send(session->fd, session->pending + session->pendingOffset, session->pendingLength,
+				MSG_NOSIGNAL);
+
+		if(length < 0) {
+			if(errno == EINTR)
+				continue;
+
+			if(errno == EAGAIN)
+				return;
+
+			session->pendingLength = 0;
+			continue;
+		}
+
+		session->pendingOffset += length;
+		session->pendingLength -= length;
+	}
+}
+
+/* reads until the socket is drained or the input queue is full, a full
+ * queue is left for the worker to report once the guest read from it.
+ * false at the end of the connection */
+static bool serverReadInput(struct serverSession *session) {
+	uint8_t buffer[SERVER_QUEUE_SIZE];
+	size_t space;
+	ssize_t length;
+	bool queued;
+
+	queued = false;
+
+	for(;;) {
+		space = spscSpace(&session->input);
+
+		if(space == 0) {
+			atomic_store(&session->inputStalled, true);
+
+			/* the guest may have read in between and missed the flag */
+			if(spscSpace(&session->input) == 0)
+				break;
+
+			atomic_store(&session->inputStalled, false);
+			continue;
+		}
+
+		length = recv(session->fd, buffer, space < sizeof(buffer) ? space : sizeof(buffer), 0);
+
+		if(length > 0) {
+			spscPush(&session->input, buffer, length);
+			queued = true;
+			continue;
+		}
+
+		if(length < 0 && errno == EINTR)
+			continue;
+
+		if(length < 0 && errno == EAGAIN)
+			break;
+
+		return false;
+	}
+
+	if(queued) {
+		atomic_fetch_add(&session->arrivals, 1);
+		serverSchedule(session);
+	}
+
+	return true;
+}
+
+/* the worker that takes the session next closes it */
+static void serverHangUp(struct server *server, struct serverSession *session) {
+	epoll_ctl(server->epollFd, EPOLL_CTL_DEL, session->fd, NULL);
+
+	atomic_store(&session->closed, true);
+	serverSchedule(session);
+}
+
+static void *serverIoThread(void *argument) {
+	struct epoll_event events[SERVER_EVENTS];
+	struct serverSession *session;
+	struct server *server;
+	uint64_t wake;
+	int i, n;
+
+	server = argument;
+
+	while(!atomic_load(&server->stop)) {
+		n = epoll_wait(server->epollFd, events, SERVER_EVENTS, -1);
+
+		for(i = 0; i < n; i++) {
+			if(events[i].data.ptr == &server->listenFd) {
+				serverAccept(server);
+				continue;
+			}
+
+			if(events[i].data.ptr == &server->wakeFd) {
+				while(read(server->wakeFd, &wake, sizeof(wake)) > 0)
+					;
+				continue;
+			}
+
+			session = events[i].data.ptr;
+
+			serverWriteOutput(session);
+
+			if(!serverReadInput(session)) {
+				/* whatever the guest said last still goes out */
+				serverWriteOutput(session);
+				serverHangUp(server, session);
+			}
+		}
+	}
+
+	return NULL;
+}
+
+/* runs a slice, true if the session has more to do without new input */
+static bool serverRunSlice(struct server *server, struct serverSession *session) {
+	struct cpu8080 *cpu;
+	uint64_t emptyPolls, transfers;
+
+	cpu = &session->cpu;
+
+	emptyPolls = session->serial.emptyPolls;
+	transfers = session->serial.transfers;
+
+	server->engine->run(cpu, SERVER_SLICE);
+
+	serialPoll(&session->serial, cpu);
+
+	/* the session may not run again for a while */
+	portTableFlush(&session->ports);
+
+	if(atomic_exchange(&session->inputStalled, false))
+		serverKick(session);
+
+	/* a guest that stopped gets its connection closed, the i/o thread sees
+	 * the end of input and hangs up */
+	if(cpu->signalBuffer != noSignal) {
+		shutdown(session->fd, SHUT_RD);
+		return false;
+	}
+
+	if(cpu->halted && !cpu->interruptPending)
+		return false;
+
+	return session->serial.transfers != transfers
+		|| session->serial.emptyPolls - emptyPolls < SERVER_IDLE_POLLS;
+}
+
+static void *serverWorker(void *argument) {
+	struct serverSession *session;
+	struct server *server;
+	size_t arrivals;
+
+	server = argument;
+
+	for(;;) {
+		pthread_mutex_lock(&server->lock);
+
+		while(server->runHead == NULL && !atomic_load(&server->stop))
+			pthread_cond_wait(&server->runnable, &server->lock);
+
+		session = server->runHead;
+
+		if(atomic_load(&server->stop)) {
+			pthread_mutex_unlock(&server->lock);
+			break;
+		}
+
+		server->runHead = session->next;
+
+		if(server->runHead == NULL)
+			server->runTail = NULL;
+
+		pthread_mutex_unlock(&server->lock);
+
+		atomic_store(&session->state, sessionRunning);
+
+		if(atomic_load(&session->closed)) {
+			serverCloseSession(server, session);
+			continue;
+		}
+
+		arrivals = atomic_load(&session->arrivals);
+
+		if(session->cpu.signalBuffer == noSignal && serverRunSlice(server, session)) {
+			atomic_store(&session->state, sessionQueued);
+			serverEnqueue(server, session);
+			continue;
+		}
+
+		atomic_store(&session->state, sessionIdle);
+
+		/* input or a hang up that came while it was running */
+		if(atomic_load(&session->closed) || atomic_load(&session->arrivals) != arrivals)
+			serverSchedule(session);
+	}
+
+	return NULL;
+}
+
+bool serverStart(struct server *server, size_t nWorkers) {
+	if(nWorkers == 0 || nWorkers > SERVER_MAX_WORKERS)
+		return false;
+
+	if(!serverWatch(server, server->wakeFd, &server->wakeFd, EPOLLIN))
+		return false;
+
+	if(pthread_create(&server->ioThread, NULL, serverIoThread, server) != 0)
+		return false;
+
+	for(server->nWorkers = 0; server->nWorkers < nWorkers; server->nWorkers++) {
+		if(pthread_create(&server->workers[server->nWorkers], NULL, serverWorker, server) != 0) {
+			serverStop(server);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/* sessions stay where they are, serverDestroy closes them */
+void serverStop(struct server *server) {
+	uint64_t wake;
+	size_t i;
+
+	wake = 1;
+
+	pthread_mutex_lock(&server->lock);
+	atomic_store(&server->stop, true);
+	pthread_cond_broadcast(&server->runnable);
+	pthread_mutex_unlock(&server->lock);
+
+	write(server->wakeFd, &wake, sizeof(wake));
+
+	pthread_join(server->ioThread, NULL);
+
+	for(i = 0; i < server->nWorkers; i++)
+		pthread_join(server->workers[i], NULL);
+
+	server->nWorkers = 0;
+}
+
+/* after serverStop, or when serverInit failed */
+void serverDestroy(struct server *server) {
+	while(server->live != NULL) {
+		epoll_ctl(server->epollFd, EPOLL_CTL_DEL, server->live->fd, NULL);
+		serverCloseSession(server, server->live);
+	}
+
+	if(server->listenFd >= 0)
+		close(server->listenFd);
+
+	if(server->unixSocket)
+		unlink(server->path);
+
+	if(server->wakeFd >= 0)
+		close(server->wakeFd);
+
+	if(server->epollFd >= 0)
+		close(server->epollFd);
+
+	if(server->image != NULL) {
+		instancePoolDestroy(&server->pool);
+		guestImageDestroy(server->image);
+	}
+
+	pthread_mutex_destroy(&server->lock);
+	pthread_cond_destroy(&server->runnable);
+}
@@ -0,0 +1,92 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "spsc.h"
+
+/* capacity is rounded up to a power of two */
+bool spscInit(struct spscQueue *queue, size_t capacity) {
+	size_t size;
+
+	for(size = 1; size < capacity; size <<= 1)
+		;
+
+	queue->buffer = malloc(size);
+
+	if(queue->buffer == NULL)
+		return false;
+
+	queue->mask = size - 1;
+
+	atomic_init(&queue->head, 0);
+	atomic_init(&queue->tail, 0);
+	queue->cachedHead = 0;
+	queue->cachedTail = 0;
+
+	/* nothing was consumed yet, the first push wakes the consumer */
+	atomic_init(&queue->sleeping, true);
+
+	return true;
+}
+
+void spscDestroy(struct spscQueue *queue) {
+	free(queue->buffer);
+	queue->buffer = NULL;
+}
+
+/* producer side, returns how much fit */
+size_t spscPush(struct spscQueue *queue, const uint8_t *data, size_t length) {
+	size_t tail, space, offset, first;
+
+	tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+	space = queue->mask + 1 - (tail - queue->cachedHead);
+
+	if(space < length) {
+		queue->cachedHead = atomic_load_explicit(&queue->head, memory_order_acquire);
+		space = queue->mask + 1 - (tail - queue->cachedHead);
+	}
+
+	if(length > space)
+		length = space;
+
+	offset = tail & queue->mask;
+	first = queue->mask + 1 - offset;
+
+	if(first > length)
+		first = length;
+
+	memcpy(queue->buffer + offset, data, first);
+	memcpy(queue->buffer, data + first, length - first);
+
+	atomic_store_explicit(&queue->tail, tail + length, memory_order_release);
+
+	return length;
+}
+
+/* consumer side, returns how much was there */
+size_t spscPop(struct spscQueue *queue, uint8_t *data, size_t length) {
+	size_t head, available, offset, first;
+
+	head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+	available = queue->cachedTail - head;
+
+	if(available < length) {
+		queue->cachedTail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+		available = queue->cachedTail - head;
+	}
+
+	if(length > available)
+		length = available;
+
+	offset = head & queue->mask;
+	first = queue->mask + 1 - offset;
+
+	if(first > length)
+		first = length;
+
+	memcpy(data, queue->buffer + offset, first);
+	memcpy(data + first, queue->buffer, length - first);
+
+	atomic_store_explicit(&queue->head, head + length, memory_order_release);
+
+	return length;
+}
@@ -0,0 +1,279 @@
+#include <string.h>
+
+#include "statelog.h"
+#include "guest_memory.h"
+
+#define HASH_MULTIPLIER	0x9E3779B97F4A7C15ULL
+
+static uint64_t hashMix(uint64_t hash, uint64_t value) {
+	hash = (hash ^ value) * HASH_MULTIPLIER;
+
+	return hash ^ (hash >> 32);
+}
+
+uint64_t cpuStateHash(struct cpu8080 *cpu) {
+	uint64_t registers, interrupts;
+
+	memcpy(&registers, cpu->registers, sizeof(registers));
+
+	interrupts = (uint64_t)cpu->interruptEnable | (uint64_t)cpu->interruptDelay << 1
+		| (uint64_t)cpu->interruptPending << 2 | (uint64_t)cpu->halted << 3
+		| (uint64_t)cpu->interruptOpcode << 8;
+
+	return hashMix(hashMix(hashMix(hashMix(0, registers),
+			(uint64_t)cpu->programCounter << 16 | cpu->stackPointer),
+			interrupts), cpu->cycleCounter);
+}
+
+static void memoryHashChunk(uint64_t *lanes, const uint8_t *chunk) {
+	uint64_t word;
+	size_t j;
+
+	for(j = 0; j < 4; j++) {
+		memcpy(&word, chunk + j * sizeof(word), sizeof(word));
+		lanes[j] = (lanes[j] ^ word) * HASH_MULTIPLIER;
+	}
+}
+
+/* four independent lanes over 64 bit words, size has to be a multiple of 32 */
+uint64_t memoryHash(const uint8_t *memory, size_t size) {
+	uint64_t lanes[4] = { 1, 2, 3, 4 };
+	size_t i;
+
+	for(i = 0; i < size; i += 4 * sizeof(uint64_t))
+		memoryHashChunk(lanes, memory + i);
+
+	return hashMix(hashMix(hashMix(lanes[0], lanes[1]), lanes[2]), lanes[3]);
+}
+
+/* memoryHash of the cpu's address space. a flat guest memory is hashed in
+ * place, any other memory is read through the callbacks */
+static uint64_t cpuMemoryHash(struct cpu8080 *cpu) {
+	uint64_t lanes[4] = { 1, 2, 3, 4 };
+	uint8_t chunk[4 * sizeof(uint64_t)];
+	size_t i, j;
+
+	if(cpu->readMemory == guestReadMemory)
+		return memoryHash(cpu->memory, STATELOG_MEMORY_SIZE);
+
+	for(i = 0; i < STATELOG_MEMORY_SIZE; i += sizeof(chunk)) {
+		for(j = 0; j < sizeof(chunk); j++)
+			chunk[j] = cpu->readMemory(cpu->memory, i + j);
+
+		memoryHashChunk(lanes, chunk);
+	}
+
+	return hashMix(hashMix(hashMix(lanes[0], lanes[1]), lanes[2]), lanes[3]);
+}
+
+/* checkpointPath may be NULL when no checkpoints are wanted */
+bool stateLogOpen(struct stateLog *log, const char *path, const char *checkpointPath,
+		size_t interval, size_t checkpointInterval) {
+	log->log = fopen(path, "wb");
+	log->checkpoints = NULL;
+
+	if(log->log == NULL)
+		return false;
+
+	if(checkpointPath != NULL) {
+		log->checkpoints = fopen(checkpointPath, "wb");
+
+		if(log->checkpoints == NULL) {
+			fclose(log->log);
+			return false;
+		}
+	}
+
+	log->interval = interval;
+	log->checkpointInterval = checkpointInterval;
+	log->nextCycle = 0;
+	log->records = 0;
+	log->rollingHash = 0;
+	log->bdos = NULL;
+
+	return true;
+}
+
+void stateLogClose(struct stateLog *log) {
+	fclose(log->log);
+
+	if(log->checkpoints != NULL)
+		fclose(log->checkpoints);
+}
+
+/* has to be called at instruction boundaries, writes a record (and maybe a
+ * checkpoint) once the next interval is reached */
+void stateLogUpdate(struct stateLog *log, struct cpu8080 *cpu) {
+	struct stateLogRecord record;
+	struct stateCheckpoint *checkpoint;
+
+	if(cpu->cycleCounter < log->nextCycle)
+		return;
+
+	if(log->checkpoints != NULL && log->checkpointInterval != 0
+			&& log->records % log->checkpointInterval == 0) {
+		checkpoint = malloc(sizeof(*checkpoint));
+
+		if(checkpoint != NULL) {
+			stateCheckpointSave(checkpoint, cpu, log->bdos);
+			fwrite(checkpoint, sizeof(*checkpoint), 1, log->checkpoints);
+			free(checkpoint);
+		}
+	}
+
+	record.cycle = cpu->cycleCounter;
+	record.cpuHash = cpuStateHash(cpu);
+	record.memoryHash = cpuMemoryHash(cpu);
+
+	log->rollingHash = hashMix(hashMix(log->rollingHash, record.cpuHash), record.memoryHash);
+	record.rollingHash = log->rollingHash;
+
+	fwrite(&record, sizeof(record), 1, log->log);
+
+	log->records++;
+	log->nextCycle = cpu->cycleCounter + log->interval;
+}
+
+/* runs the engine in blocks that end on the logging interval until the cpu
+ * raises a signal */
+void stateLogRun(struct stateLog *log, const struct cpuEngine *engine, struct cpu8080 *cpu) {
+	stateLogUpdate(log, cpu);
+
+	while(cpu->signalBuffer == noSignal) {
+		engine->run(cpu, log->nextCycle - cpu->cycleCounter);
+		stateLogUpdate(log, cpu);
+	}
+}
+
+/* reads a whole log, the caller frees *records */
+size_t stateLogRead(const char *path, struct stateLogRecord **records) {
+	FILE *file;
+	long size;
+
+	*records = NULL;
+
+	file = fopen(path, "rb");
+
+	if(file == NULL)
+		return 0;
+
+	fseek(file, 0, SEEK_END);
+	size = ftell(file);
+	rewind(file);
+
+	*records = malloc(size > 0 ? size : 1);
+
+	if(*records == NULL) {
+		fclose(file);
+		return 0;
+	}
+
+	size = fread(*records, sizeof(**records), size / sizeof(**records), file);
+
+	fclose(file);
+
+	return size;
+}
+
+/* index of the first record that differs, the hashes roll so a binary search
+ * finds it, returns the shorter length if one log is a prefix */
+size_t stateLogFirstDifference(struct stateLogRecord *a, size_t nA,
+		struct stateLogRecord *b, size_t nB) {
+	size_t low, high, middle;
+
+	low = 0;
+	high = nA < nB ? nA : nB;
+
+	while(low < high) {
+		middle = low + (high - low) / 2;
+
+		if(a[middle].rollingHash == b[middle].rollingHash)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	return low;
+}
+
+/* loads the last checkpoint taken at or before cycle */
+bool stateCheckpointFind(const char *path, uint64_t cycle, struct stateCheckpoint *checkpoint) {
+	FILE *file;
+	bool found;
+	uint64_t checkpointCycle;
+
+	file = fopen(path, "rb");
+
+	if(file == NULL)
+		return false;
+
+	found = false;
+
+	while(fread(&checkpointCycle, sizeof(checkpointCycle), 1, file) == 1) {
+		if(checkpointCycle > cycle)
+			break;
+
+		fseek(file, -(long)sizeof(checkpointCycle), SEEK_CUR);
+
+		if(fread(checkpoint, sizeof(*checkpoint), 1, file) != 1)
+			break;
+
+		found = true;
+	}
+
+	fclose(file);
+
+	return found;
+}
+
+/* memory goes through the cpu's callbacks both ways, so a restore leaves
+ * rom alone and marks what it wrote dirty. bdos may be NULL */
+void stateCheckpointSave(struct stateCheckpoint *checkpoint, struct cpu8080 *cpu, struct bdos *bdos) {
+	size_t i;
+
+	checkpoint->cycle = cpu->cycleCounter;
+	memcpy(checkpoint->registers, cpu->registers, sizeof(checkpoint->registers));
+	checkpoint->programCounter = cpu->programCounter;
+	checkpoint->stackPointer = cpu->stackPointer;
+
+	checkpoint->interruptEnable = cpu->interruptEnable;
+	checkpoint->interruptDelay = cpu->interruptDelay;
+	checkpoint->interruptPending = cpu->interruptPending;
+	checkpoint->halted = cpu->halted;
+	checkpoint->interruptOpcode = cpu->interruptOpcode;
+
+	checkpoint->dma = bdos != NULL ? bdos->dma : BDOS_DEFAULT_DMA;
+	checkpoint->drive = bdos != NULL ? bdos->drive : 0;
+	checkpoint->user = bdos != NULL ? bdos->user : 0;
+	checkpoint->hostState = bdos != NULL && bdosHostState(bdos);
+
+	for(i = 0; i < STATELOG_MEMORY_SIZE; i++)
+		checkpoint->memory[i] = cpu->readMemory(cpu->memory, i);
+}
+
+/* the caller checks hostState, that part of the machine can't be restored */
+void stateCheckpointRestore(struct stateCheckpoint *checkpoint, struct cpu8080 *cpu, struct bdos *bdos) {
+	size_t i;
+
+	cpu->cycleCounter = checkpoint->cycle;
+	memcpy(cpu->registers, checkpoint->registers, sizeof(cpu->registers));
+	cpu->programCounter = checkpoint->programCounter;
+	cpu->stackPointer = checkpoint->stackPointer;
+
+	cpu->interruptEnable = checkpoint->interruptEnable;
+	cpu->interruptDelay = checkpoint->interruptDelay;
+	cpu->interruptPending = checkpoint->interruptPending;
+	cpu->halted = checkpoint->halted;
+	cpu->interruptOpcode = checkpoint->interruptOpcode;
+
+	if(bdos != NULL) {
+		bdos->dma = checkpoint->dma;
+		bdos->drive = checkpoint->drive;
+		bdos->user = checkpoint->user;
+	}
+
+	for(i = 0; i < STATELOG_MEMORY_SIZE; i++)
+		cpu->writeMemory(cpu->memory, i, checkpoint->memory[i]);
+
+	cpu->signalBuffer = noSignal;
+}
@@ -0,0 +1,111 @@
+#ifdef _CPU_TEST
+
+#include <string.h>
+
+#include "test_machine.h"
+#include "util.h"
+#include "guest_memory.h"
+#include "bdos.h"
+#include "loader.h"
+#include "ports.h"
+
+/* OUT 0 at address 0 ends the test (a jump to the warm boot vector) */
+static void testExitOut(struct portDevice *device, struct cpu8080 *cpu, uint8_t port, uint8_t data) {
+	struct testMachine *machine;
+
+	machine = device->context;
+
+	bdosFlush(&machine->bdos);
+	cpu->signalBuffer = exitSignal;
+}
+
+/* OUT 1 in the bdos stub */
+static void testBdosOut(struct portDevice *device, struct cpu8080 *cpu, uint8_t port, uint8_t data) {
+	struct testMachine *machine;
+
+	machine = device->context;
+
+	bdosCall(&machine->bdos, cpu);
+}
+
+/* handles calls to the bdos without running the stub in the guest */
+bool testMachineTrap(struct testMachine *machine) {
+	return bdosTrap(&machine->bdos, &machine->cpu);
+}
+
+/* delivers pending port output, flushes guest output and closes the files
+ * the guest left open */
+void testMachineFinish(struct testMachine *machine) {
+	portTableFlush(&machine->ports);
+	bdosDestroy(&machine->bdos);
+}
+
+/* sets up a machine that runs the test at testPath, guest output goes to
+ * console. returns a loader error if the test can't be loaded */
+uint8_t testMachineInit(struct testMachine *machine, struct guestMemory *memory, const char *testPath,
+		struct console *console) {
+	struct cpu8080 *cpu;
+	uint8_t error;
+
+	cpu = &machine->cpu;
+	cpu->memory = memory->base;
+
+	error = loaderLoad(testPath, cpu->memory, TEST_MEMORY_SIZE, 0x100);
+
+	if(error != loaderOk)
+		return error;
+
+	/* the loader writes to memory directly, anywhere it was allowed to */
+	guestMemoryMarkDirty(memory, 0, TEST_MEMORY_SIZE);
+
+	cpu->readMemory = guestReadMemory;
+	cpu->readMemoryWord = guestReadMemoryWord;
+	cpu->writeMemory = guestWriteMemory;
+	cpu->writeMemoryWord = guestWriteMemoryWord;
+
+	cpu->writeMemory(cpu->memory, 0x0000, 0xD3);
+	cpu->writeMemory(cpu->memory, 0x0001, 0x00);
+
+	bdosInit(&machine->bdos, ".", stdin, console);
+	bdosInstall(&machine->bdos, cpu);
+
+	machine->exitDevice = (struct portDevice){ .name = "exit", .out = testExitOut, .context = machine };
+	machine->bdosDevice = (struct portDevice){ .name = "bdos", .out = testBdosOut, .context = machine };
+
+	portTableInit(&machine->ports, NULL);
+	portTableMap(&machine->ports, 0x00, &machine->exitDevice);
+	portTableMap(&machine->ports, 0x01, &machine->bdosDevice);
+
+	cpu->ports = &machine->ports;
+	cpu->portOut = portTableOut;
+	cpu->portIn = portTableIn;
+
+	cpu->programCounter = 0x100;
+	cpu->stackPointer = 0;
+
+	memset(cpu->registers, 0, sizeof(cpu->registers));
+	cpu->registers[rSTATUS] = (0 << 5) | (0 << 3) | (1 << 1);
+
+	cpu->cycleCounter = 0;
+	
+	cpu->signalBuffer = noSignal;
+
+	cpu->interruptEnable = false;
+	cpu->interruptDelay = false;
+	cpu->interruptPending = false;
+	cpu->halted = false;
+	cpu->debugger = NULL;
+	cpu->hooks = NULL;
+
+#ifdef CPU_COVERAGE
+	cpu->coverage = NULL;
+#endif
+
+#ifdef CPU_HEATMAP
+	cpu->heatmap = NULL;
+#endif
+
+	return loaderOk;
+}
+
+#endif /* #ifdef _CPU_TEST */
@@ -1,4 +1,5 @@
 #include "util.h"
+#include "loader.h"
 #include <stdio.h>
 
 bool isBitSet(uint8_t number, uint8_t bit) {
@@ -32,16 +33,7 @@ char *byteToBitString(uint8_t byte) {
         return str;
 }
 
-void loadRom(uint8_t *memory, const char *path, const uint16_t start) {
-        FILE *romFile;
-
-        size_t i, fileSize;
-
-        romFile = fopen(path, "rb");
-
-        fseek(romFile, 0, SEEK_END);
-        fileSize = ftell(romFile);
-        rewind(romFile);
-
-        fread(memory + start, fileSize, sizeof(uint8_t), romFile);
+/* loads a raw binary into a 64k address space, returns a loader error */
+uint8_t loadRom(uint8_t *memory, const char *path, const uint16_t start) {
+        return loaderLoadBinary(path, memory, 0x10000, start);
 }
@@ -0,0 +1,317 @@
+#ifdef _CPU_TEST
+
+#include <string.h>
+
+#include "cfg.h"
+#include "disassembler.h"
+#include "loader.h"
+
+/* recovers the code of a rom statically and writes it out either as a
+ * listing that tells code from data (map) or as C for the aot engine (c):
+ *
+ *	i8080-aot c rom.bin 0x100 > rom_aot.c
+ *	cc ... -DCPU_AOT='"rom_aot.c"'
+ *
+ * the rom is loaded at address like the emulator does (manifests and hex
+ * files place themselves). without entry points the load address and the
+ * restart vectors that were loaded are followed. code that is only reached
+ * through RET or PCHL to a computed address isn't found, it runs on the
+ * interpreter unless its address is given as one more entry point */
+
+#define AOT_MAX_ENTRIES	64
+
+static void usage(const char *name) {
+	fprintf(stderr, "usage: %s c|map rom [address] [entry...]\n", name);
+}
+
+/* the instruction at address, which may wrap around */
+static void aotFetch(const uint8_t *memory, uint16_t address, uint8_t *bytes) {
+	uint8_t i;
+
+	for(i = 0; i < 3; i++)
+		bytes[i] = memory[(uint16_t)(address + i)];
+}
+
+/* whether an instruction can write to memory, a block has to be checked
+ * again after one in case it wrote over itself */
+static bool aotStores(uint8_t opcode) {
+	switch(opcode) {
+		case 0x02: case 0x12: case 0x22: case 0x32:	/* STAX B, STAX D, SHLD, STA */
+		case 0x34: case 0x35: case 0x36:		/* INR M, DCR M, MVI M */
+		case 0xC5: case 0xD5: case 0xE5: case 0xF5:	/* PUSH */
+		case 0xE3:					/* XTHL */
+			return true;
+
+		default:
+			/* MOV M,r but HLT */
+			return (opcode & 0xF8) == 0x70 && opcode != 0x76;
+	}
+}
+
+static bool aotIsBlock(struct cfg *cfg, uint16_t address) {
+	return (cfg->marks[address] & (cfgInstruction | cfgLeader)) == (cfgInstruction | cfgLeader);
+}
+
+/* jumps to a known block if the cpu went there and can go on. a block
+ * that loops to itself without a store in it is still what it was checked
+ * to be and skips the check */
+static void aotEmitChain(struct cfg *cfg, uint16_t address, uint16_t leader, bool unchanged) {
+	if(aotIsBlock(cfg, address))
+		printf("\t\tif(cpu->programCounter == 0x%04X && AOT_GO_ON(cpu, target))\n\t\t\tgoto aot%04X%s;\n",
+				address, address, address == leader && unchanged ? "Checked" : "");
+}
+
+/* whether the block at leader jumps back to itself without a store */
+static bool aotLoopsUnchanged(const uint8_t *memory, uint16_t leader, uint16_t end) {
+	const struct opcodeInfo *info;
+	uint16_t address, last, target;
+
+	address = leader;
+
+	do {
+		info = &opcodeTable[memory[address]];
+		last = address;
+
+		if(aotStores(memory[address]))
+			return false;
+
+		address += info->length;
+	} while(address != end);
+
+	target = memory[(uint16_t)(last + 1)] | memory[(uint16_t)(last + 2)] << 8;
+
+	return (info->flow == opcodeJump || info->flow == opcodeJumpIf) && target == leader;
+}
+
+static void aotEmitBlock(struct cfg *cfg, const uint8_t *memory, uint16_t leader, size_t offset) {
+	const struct opcodeInfo *info;
+	char text[DISASSEMBLY_TEXT_SIZE];
+	uint16_t address, end, next, target;
+	uint8_t bytes[3];
+	bool unchanged;
+
+	end = cfgBlockEnd(cfg, memory, leader);
+	unchanged = aotLoopsUnchanged(memory, leader, end);
+
+	printf("\taot%04X:\n", leader);
+	printf("\t\tif(memcmp(cpu->memory + 0x%04X, aotCode + %lu, %u) != 0) {\n", leader, offset,
+			(uint16_t)(end - leader));
+	printf("\t\t\tAOT_STEP(cpu);\n\t\t\tcontinue;\n\t\t}\n\n");
+
+	if(unchanged)
+		printf("\taot%04XChecked:\n", leader);
+
+	for(address = leader;; address = next) {
+		aotFetch(memory, address, bytes);
+		disassemble(bytes, text);
+
+		info = &opcodeTable[bytes[0]];
+		next = address + info->length;
+
+		printf("\t\tAOT_EXECUTE(cpu, 0x%02X);\t/* %04X %s */\n", bytes[0], address, text);
+
+		if(next == end)
+			break;
+
+		if(aotStores(bytes[0]))
+			printf("\t\tif(AOT_LEFT(cpu, target) || memcmp(cpu->memory + 0x%04X, aotCode + %lu, %u) != 0)\n",
+					next, offset + (uint16_t)(next - leader), (uint16_t)(end - next));
+		else
+			printf("\t\tif(AOT_LEFT(cpu, target))\n");
+
+		printf("\t\t\tcontinue;\n");
+	}
+
+	target = bytes[1] | bytes[2] << 8;
+
+	switch(info->flow) {
+		case opcodeSequential:
+		case opcodeReturnIf:
+			aotEmitChain(cfg, next, leader, unchanged);
+			break;
+
+		case opcodeJump:
+		case opcodeCall:
+			aotEmitChain(cfg, target, leader, unchanged);
+			break;
+
+		case opcodeJumpIf:
+		case opcodeCallIf:
+			aotEmitChain(cfg, target, leader, unchanged);
+			aotEmitChain(cfg, next, leader, unchanged);
+			break;
+
+		case opcodeRestart:
+			aotEmitChain(cfg, bytes[0] & 0x38, leader, unchanged);
+			break;
+	}
+
+	printf("\t\tcontinue;\n\n");
+}
+
+static void aotEmitC(struct cfg *cfg, const uint8_t *memory, const char *name) {
+	size_t offset, column, length;
+	size_t i, j;
+
+	printf("/* translated by i8080-aot from %s, %lu blocks of %lu instructions. generated, don't edit */\n\n",
+			name, cfg->nBlocks, cfg->nInstructions);
+
+	/* the bytes every block was translated from, one after the other */
+	printf("static const uint8_t aotCode[] = {");
+
+	for(i = 0, column = 0; i < CFG_ADDRESSES; i++) {
+		if(!aotIsBlock(cfg, i))
+			continue;
+
+		length = (uint16_t)(cfgBlockEnd(cfg, memory, i) - i);
+
+		for(j = 0; j < length; j++, column++)
+			printf(column % 12 == 0 ? "\n\t0x%02X," : " 0x%02X,", memory[(uint16_t)(i + j)]);
+	}
+
+	/* an array can't be empty */
+	if(column == 0)
+		printf(" 0x00");
+
+	printf("\n};\n\n");
+
+	printf("static void aotRun(struct cpu8080 *cpu, size_t cycles) {\n"
+			"\tsize_t target;\n\n"
+			"\ttarget = cpu->cycleCounter + cycles;\n\n"
+			"\twhile(cpu->cycleCounter < target && cpu->signalBuffer == noSignal) {\n"
+			"\t\tif(cpu->interruptPending || cpu->interruptDelay || cpu->halted) {\n"
+			"\t\t\tAOT_STEP(cpu);\n"
+			"\t\t\tcontinue;\n"
+			"\t\t}\n\n"
+			"\t\tswitch(cpu->programCounter) {\n");
+
+	for(i = 0; i < CFG_ADDRESSES; i++) {
+		if(aotIsBlock(cfg, i))
+			printf("\t\t\tcase 0x%04lX: goto aot%04lX;\n", i, i);
+	}
+
+	printf("\t\t\tdefault:\n"
+			"\t\t\t\tAOT_STEP(cpu);\n"
+			"\t\t\t\tcontinue;\n"
+			"\t\t}\n\n");
+
+	for(i = 0, offset = 0; i < CFG_ADDRESSES; i++) {
+		if(!aotIsBlock(cfg, i))
+			continue;
+
+		aotEmitBlock(cfg, memory, i, offset);
+		offset += (uint16_t)(cfgBlockEnd(cfg, memory, i) - i);
+	}
+
+	printf("\t}\n}\n");
+}
+
+/* every loaded byte, code as instructions and the rest as data */
+static void aotEmitMap(struct cfg *cfg, const uint8_t *memory) {
+	char text[DISASSEMBLY_TEXT_SIZE];
+	uint8_t bytes[3], marks;
+	size_t i;
+
+	for(i = 0; i < CFG_ADDRESSES;) {
+		marks = cfg->marks[i];
+
+		if(!(marks & cfgLoaded)) {
+			i++;
+			continue;
+		}
+
+		if(!(marks & cfgInstruction)) {
+			printf("%04lX\tDB %s%02XH%s\n", i, memory[i] > 0x9F ? "0" : "", memory[i],
+					marks & cfgCode ? "\t; inside an instruction" : "");
+			i++;
+			continue;
+		}
+
+		if(marks & cfgLeader)
+			printf("%s\n", marks & cfgEntry ? "; entry" : marks & cfgCallTarget ? "; called" : "");
+
+		aotFetch(memory, i, bytes);
+		disassemble(bytes, text);
+
+		printf("%04lX\t%s%s%s\n", i, text, marks & cfgIndirect ? "\t; leaves indirectly" : "",
+				marks & cfgOverlap ? "\t; overlaps another instruction" : "");
+
+		i += opcodeTable[bytes[0]].length;
+	}
+}
+
+int main(int argc, char **argv) {
+	uint16_t entries[AOT_MAX_ENTRIES], address;
+	uint8_t *memory, *probe, error;
+	size_t nEntries, i;
+	struct cfg *cfg;
+	int k;
+
+	if(argc < 3 || (strcmp(argv[1], "c") != 0 && strcmp(argv[1], "map") != 0)
+			|| argc > 4 + AOT_MAX_ENTRIES) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	address = argc > 3 ? strtoul(argv[3], NULL, 0) : 0;
+
+	memory = calloc(0x10000, 1);
+	probe = malloc(0x10000);
+	cfg = malloc(sizeof(*cfg));
+
+	if(memory == NULL || probe == NULL || cfg == NULL)
+		exit(1);
+
+	/* loaded once over zeros and once over ones, what the image didn't
+	 * write differs */
+	memset(probe, 0xFF, 0x10000);
+
+	error = loaderLoad(argv[2], memory, 0x10000, address);
+
+	if(error == loaderOk)
+		error = loaderLoad(argv[2], probe, 0x10000, address);
+
+	if(error != loaderOk) {
+		fprintf(stderr, "%s: %s\n", argv[2], loaderErrorString(error));
+		return EXIT_FAILURE;
+	}
+
+	cfgInit(cfg);
+
+	for(i = 0; i < CFG_ADDRESSES; i++) {
+		if(memory[i] == probe[i])
+			cfgMarkLoaded(cfg, i, 1);
+	}
+
+	nEntries = 0;
+
+	for(k = 4; k < argc; k++)
+		entries[nEntries++] = strtoul(argv[k], NULL, 0);
+
+	if(nEntries == 0) {
+		entries[nEntries++] = address;
+
+		for(i = 0; i < 0x40; i += 8) {
+			if(i != address && cfg->marks[i] & cfgLoaded)
+				entries[nEntries++] = i;
+		}
+	}
+
+	cfgRecover(cfg, memory, entries, nEntries);
+
+	fprintf(stderr, "%s: %lu of %lu loaded bytes are code, %lu instructions in %lu blocks, %lu called\n",
+			argv[2], cfg->nCode, cfg->nLoaded, cfg->nInstructions, cfg->nBlocks, cfg->nCallTargets);
+
+	if(strcmp(argv[1], "c") == 0)
+		aotEmitC(cfg, memory, argv[2]);
+	else
+		aotEmitMap(cfg, memory);
+
+	free(cfg);
+	free(probe);
+	free(memory);
+
+	return EXIT_SUCCESS;
+}
+
+#endif /* #ifdef _CPU_TEST */
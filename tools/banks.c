@@ -0,0 +1,222 @@
+#ifdef _CPU_TEST
+
+#include <string.h>
+
+#include "banked_memory.h"
+#include "bdos.h"
+#include "console.h"
+#include "engine.h"
+#include "loader.h"
+#include "ports.h"
+
+/* runs a guest that switches banks through the select port on banked
+ * memory and checks every bank kept what was written to it, then runs a
+ * cp/m program (a cpu test) out of bank 0 with the bdos on top:
+ *
+ *	i8080-banks [rom] [banks] [engine]
+ *
+ * the lower 48k are banked, the upper 16k are common memory and hold the
+ * check and the bdos stub */
+
+#define BANKS_DEFAULT		4
+/* the sign of B ends the check's loops */
+#define BANKS_MAX		128
+#define BANKS_FIRST_BANKED	0
+#define BANKS_BANKED		12
+
+#define BANKS_CHECK		0xC000
+#define BANKS_COUNTER		0xC800
+#define BANKS_LOW		0x1000
+#define BANKS_HIGH		0xBFFF
+
+/* cycles between looks at the signal */
+#define BANKS_SLICE		0x10000
+
+/* every bank from the last down to 0 gets its number at both ends of its
+ * banked memory and counts itself in common memory. then every bank is
+ * selected again, read back through the select port and checked. A is 0
+ * at the OUT to port 0 when everything matched, the failed bank plus one
+ * otherwise. B is patched to the last bank */
+static const uint8_t bankCheck[] = {
+	0x06, 0x00,		/* C000	MVI B,last */
+	0x78,			/* C002	MOV A,B */
+	0xD3, BANK_SELECT_PORT,	/* C003	OUT select */
+	0x32, 0x00, 0x10,	/* C005	STA 1000H */
+	0x32, 0xFF, 0xBF,	/* C008	STA 0BFFFH */
+	0x3A, 0x00, 0xC8,	/* C00B	LDA 0C800H */
+	0x3C,			/* C00E	INR A */
+	0x32, 0x00, 0xC8,	/* C00F	STA 0C800H */
+	0x05,			/* C012	DCR B */
+	0xF2, 0x02, 0xC0,	/* C013	JP 0C002H */
+	0x06, 0x00,		/* C016	MVI B,last */
+	0x78,			/* C018	MOV A,B */
+	0xD3, BANK_SELECT_PORT,	/* C019	OUT select */
+	0xDB, BANK_SELECT_PORT,	/* C01B	IN select */
+	0xB8,			/* C01D	CMP B */
+	0xC2, 0x36, 0xC0,	/* C01E	JNZ 0C036H */
+	0x3A, 0x00, 0x10,	/* C021	LDA 1000H */
+	0xB8,			/* C024	CMP B */
+	0xC2, 0x36, 0xC0,	/* C025	JNZ 0C036H */
+	0x3A, 0xFF, 0xBF,	/* C028	LDA 0BFFFH */
+	0xB8,			/* C02B	CMP B */
+	0xC2, 0x36, 0xC0,	/* C02C	JNZ 0C036H */
+	0x05,			/* C02F	DCR B */
+	0xF2, 0x18, 0xC0,	/* C030	JP 0C018H */
+	0xAF,			/* C033	XRA A */
+	0xD3, 0x00,		/* C034	OUT 0 */
+	0x78,			/* C036	MOV A,B */
+	0x3C,			/* C037	INR A */
+	0xD3, 0x00,		/* C038	OUT 0 */
+};
+
+static struct bdos bdos;
+
+static void usage(const char *name) {
+	fprintf(stderr, "usage: %s [rom] [banks] [engine]\n", name);
+	fprintf(stderr, "engines:\n");
+	cpuListEngines(stderr);
+}
+
+static void exitOut(struct portDevice *device, struct cpu8080 *cpu, uint8_t port, uint8_t data) {
+	bdosFlush(&bdos);
+	cpu->signalBuffer = exitSignal;
+}
+
+static void bdosOut(struct portDevice *device, struct cpu8080 *cpu, uint8_t port, uint8_t data) {
+	bdosCall(&bdos, cpu);
+}
+
+static void run(const struct cpuEngine *engine, struct cpu8080 *cpu, uint16_t address) {
+	cpu->programCounter = address;
+	cpu->stackPointer = 0;
+	cpu->cycleCounter = 0;
+	cpu->signalBuffer = noSignal;
+
+	memset(cpu->registers, 0, sizeof(cpu->registers));
+	cpu->registers[rSTATUS] = 1 << 1;
+
+	while(cpu->signalBuffer == noSignal)
+		engine->run(cpu, BANKS_SLICE);
+}
+
+/* what the check left in storage, seen from the host */
+static bool checkStorage(struct bankedMemory *banked, uint8_t nBanks) {
+	size_t offset;
+	uint8_t bank;
+
+	for(bank = 0; bank < nBanks; bank++) {
+		offset = bankedMemoryBankOffset(banked, bank) - BANKS_FIRST_BANKED * BANK_WINDOW_SIZE;
+
+		if(banked->storage[offset + BANKS_LOW] != bank || banked->storage[offset + BANKS_HIGH] != bank) {
+			printf("bank %u doesn't hold its number\n", bank);
+			return false;
+		}
+	}
+
+	if(banked->storage[BANKS_COUNTER] != nBanks) {
+		printf("common memory was counted to %u\n", banked->storage[BANKS_COUNTER]);
+		return false;
+	}
+
+	return true;
+}
+
+int main(int argc, char **argv) {
+	const struct cpuEngine *engine;
+	struct bankedMemory *banked;
+	struct portDevice exitDevice, bdosDevice;
+	struct portTable ports;
+	struct console console;
+	struct cpu8080 cpu;
+	unsigned long nBanks;
+	uint8_t error;
+	size_t i;
+
+	nBanks = argc > 2 ? strtoul(argv[2], NULL, 0) : BANKS_DEFAULT;
+	engine = cpuFindEngine(argc > 3 ? argv[3] : "reference");
+
+	if(argc > 4 || nBanks < 2 || nBanks > BANKS_MAX || engine == NULL) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	banked = bankedMemoryCreate(nBanks, BANKS_FIRST_BANKED, BANKS_BANKED);
+
+	if(banked == NULL || !consoleInitStream(&console, stdout))
+		exit(1);
+
+	bdosInit(&bdos, ".", stdin, &console);
+
+	exitDevice = (struct portDevice){ .name = "exit", .out = exitOut };
+	bdosDevice = (struct portDevice){ .name = "bdos", .out = bdosOut };
+
+	portTableInit(&ports, NULL);
+	portTableMap(&ports, 0x00, &exitDevice);
+	portTableMap(&ports, 0x01, &bdosDevice);
+	bankedMemoryMapPort(banked, &ports, BANK_SELECT_PORT);
+
+	memset(&cpu, 0, sizeof(cpu));
+
+	cpu.memory = (uint8_t *)banked;
+	cpu.readMemory = bankedReadMemory;
+	cpu.readMemoryWord = bankedReadMemoryWord;
+	cpu.writeMemory = bankedWriteMemory;
+	cpu.writeMemoryWord = bankedWriteMemoryWord;
+
+	cpu.ports = &ports;
+	cpu.portOut = portTableOut;
+	cpu.portIn = portTableIn;
+
+	for(i = 0; i < sizeof(bankCheck); i++)
+		cpu.writeMemory(cpu.memory, BANKS_CHECK + i, bankCheck[i]);
+
+	cpu.writeMemory(cpu.memory, BANKS_CHECK + 0x01, nBanks - 1);
+	cpu.writeMemory(cpu.memory, BANKS_CHECK + 0x17, nBanks - 1);
+
+	run(engine, &cpu, BANKS_CHECK);
+
+	if(cpu.registers[rA] != 0) {
+		printf("bank %u reads back wrong\n", cpu.registers[rA] - 1);
+		return EXIT_FAILURE;
+	}
+
+	if(!checkStorage(banked, nBanks))
+		return EXIT_FAILURE;
+
+	printf("%lu banks of %uk switched and checked on %s\n", nBanks,
+			BANKS_BANKED * BANK_WINDOW_SIZE / 1024, engine->name);
+
+	if(argc < 2) {
+		bdosDestroy(&bdos);
+		consoleDestroy(&console);
+		bankedMemoryDestroy(banked);
+		return EXIT_SUCCESS;
+	}
+
+	/* the check left bank 0 selected, which is the first 64k of storage */
+	error = loaderLoad(argv[1], banked->storage, 0x10000, 0x100);
+
+	if(error != loaderOk) {
+		fprintf(stderr, "%s: %s\n", argv[1], loaderErrorString(error));
+		return EXIT_FAILURE;
+	}
+
+	cpu.writeMemory(cpu.memory, 0x0000, 0xD3);
+	cpu.writeMemory(cpu.memory, 0x0001, 0x00);
+
+	bdosInstall(&bdos, &cpu);
+
+	run(engine, &cpu, 0x100);
+
+	portTableFlush(&ports);
+	bdosDestroy(&bdos);
+	consoleDestroy(&console);
+
+	printf("\n%s ran in bank %u, %lu cycles\n", argv[1], banked->bank, cpu.cycleCounter);
+
+	bankedMemoryDestroy(banked);
+
+	return EXIT_SUCCESS;
+}
+
+#endif /* #ifdef _CPU_TEST */
@@ -0,0 +1,187 @@
+#ifdef _CPU_TEST
+
+#include <string.h>
+
+#include "cpu.h"
+#include "engine.h"
+#include "lockstep.h"
+#include "statelog.h"
+#include "test_machine.h"
+#include "loader.h"
+
+/* records state logs of long runs and bisects two of them down to the first
+ * diverging instruction:
+ *
+ *	record rom engine log checkpoints interval checkpoint-interval
+ *	bisect rom engine-a log-a checkpoints-a engine-b log-b
+ */
+
+static void usage(const char *name) {
+	fprintf(stderr, "usage: %s record rom engine log checkpoints interval checkpoint-interval\n", name);
+	fprintf(stderr, "       %s bisect rom engine-a log-a checkpoints-a engine-b log-b\n", name);
+	fprintf(stderr, "engines:\n");
+	cpuListEngines(stderr);
+}
+
+static int record(char **argv) {
+	const struct cpuEngine *engine;
+	struct testMachine machine;
+	struct console console;
+	struct stateLog log;
+	struct guestMemory *memory;
+	uint8_t error;
+
+	engine = cpuFindEngine(argv[1]);
+
+	if(engine == NULL)
+		return EXIT_FAILURE;
+
+	memory = guestMemoryCreate();
+
+	if(memory == NULL || !consoleInitStream(&console, stdout))
+		exit(1);
+
+	if(!stateLogOpen(&log, argv[2], argv[3], strtoul(argv[4], NULL, 0), strtoul(argv[5], NULL, 0))) {
+		perror("can't open state log");
+		return EXIT_FAILURE;
+	}
+
+	error = testMachineInit(&machine, memory, argv[0], &console);
+
+	if(error != loaderOk) {
+		fprintf(stderr, "%s: %s\n", argv[0], loaderErrorString(error));
+		return EXIT_FAILURE;
+	}
+
+	log.bdos = &machine.bdos;
+	stateLogRun(&log, engine, &machine.cpu);
+
+	testMachineFinish(&machine);
+	consoleDestroy(&console);
+
+	printf("\n%lu records written\n", log.records);
+
+	stateLogClose(&log);
+	guestMemoryDestroy(memory);
+
+	return EXIT_SUCCESS;
+}
+
+static int bisect(char **argv) {
+	const struct cpuEngine *engineA, *engineB;
+	struct stateLogRecord *recordsA, *recordsB;
+	struct stateCheckpoint *checkpoint;
+	struct testMachine machineA, machineB;
+	struct console consoleA, consoleB;
+	struct lockstep *ls;
+	struct guestMemory *memoryA, *memoryB;
+	uint8_t error;
+	size_t nA, nB, first;
+	uint64_t cycle;
+	int status;
+
+	engineA = cpuFindEngine(argv[1]);
+	engineB = cpuFindEngine(argv[4]);
+
+	if(engineA == NULL || engineB == NULL)
+		return EXIT_FAILURE;
+
+	nA = stateLogRead(argv[2], &recordsA);
+	nB = stateLogRead(argv[5], &recordsB);
+
+	first = stateLogFirstDifference(recordsA, nA, recordsB, nB);
+
+	if(first == nA && nA == nB) {
+		printf("logs agree on all %lu records\n", nA);
+		return EXIT_SUCCESS;
+	}
+
+	printf("first differing record: %lu of %lu/%lu", first, nA, nB);
+	if(first < nA && first < nB)
+		printf(" (cycle %lu/%lu, cpu %s, memory %s)",
+				recordsA[first].cycle, recordsB[first].cycle,
+				recordsA[first].cpuHash == recordsB[first].cpuHash ? "same" : "differs",
+				recordsA[first].memoryHash == recordsB[first].memoryHash ? "same" : "differs");
+	printf("\n");
+
+	/* the state at the previous record still agreed */
+	cycle = first == 0 ? 0 : recordsA[first - 1].cycle;
+
+	free(recordsA);
+	free(recordsB);
+
+	checkpoint = malloc(sizeof(*checkpoint));
+	memoryA = guestMemoryCreate();
+	memoryB = guestMemoryCreate();
+	ls = malloc(sizeof(*ls));
+
+	if(checkpoint == NULL || memoryA == NULL || memoryB == NULL || ls == NULL
+			|| !consoleInitStream(&consoleA, stdout) || !consoleInitCapture(&consoleB))
+		exit(1);
+
+	error = testMachineInit(&machineA, memoryA, argv[0], &consoleA);
+
+	if(error == loaderOk)
+		error = testMachineInit(&machineB, memoryB, argv[0], &consoleB);
+
+	if(error != loaderOk) {
+		fprintf(stderr, "%s: %s\n", argv[0], loaderErrorString(error));
+		return EXIT_FAILURE;
+	}
+
+	if(!stateCheckpointFind(argv[3], cycle, checkpoint))
+		printf("no checkpoint before cycle %lu, restarting from the beginning\n", cycle);
+	else if(checkpoint->hostState)
+		printf("the guest had files open or took console input by the checkpoint at cycle %lu,"
+				" restarting from the beginning\n", checkpoint->cycle);
+	else {
+		printf("restarting from checkpoint at cycle %lu\n", checkpoint->cycle);
+
+		stateCheckpointRestore(checkpoint, &machineA.cpu, &machineA.bdos);
+		stateCheckpointRestore(checkpoint, &machineB.cpu, &machineB.bdos);
+	}
+
+	lockstepInit(ls, engineA, &machineA.cpu, engineB, &machineB.cpu);
+	ls->memorySize = TEST_MEMORY_SIZE;
+
+	lockstepRun(ls, 0);
+	consoleFlush(&consoleA);
+
+	if(ls->result == lockstepDiverged) {
+		printf("\n");
+		lockstepPrintDivergence(ls);
+		status = EXIT_FAILURE;
+	}
+	else {
+		printf("\nno divergence found in lockstep from the checkpoint on, the run isn't deterministic\n");
+		status = EXIT_SUCCESS;
+	}
+
+	lockstepDestroy(ls);
+
+	testMachineFinish(&machineB);
+	testMachineFinish(&machineA);
+	consoleDestroy(&consoleB);
+	consoleDestroy(&consoleA);
+
+	free(ls);
+	guestMemoryDestroy(memoryB);
+	guestMemoryDestroy(memoryA);
+	free(checkpoint);
+
+	return status;
+}
+
+int main(int argc, char **argv) {
+	if(argc == 8 && strcmp(argv[1], "record") == 0)
+		return record(argv + 2);
+
+	if(argc == 8 && strcmp(argv[1], "bisect") == 0)
+		return bisect(argv + 2);
+
+	usage(argv[0]);
+
+	return EXIT_FAILURE;
+}
+
+#endif /* #ifdef _CPU_TEST */
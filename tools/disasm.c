@@ -0,0 +1,78 @@
+#ifdef _CPU_TEST
+
+#include <string.h>
+#include <time.h>
+
+#include "disassembler.h"
+#include "loader.h"
+
+/* lists a rom, loaded at the given address, as one instruction per line.
+ * with bench the listing is timed instead of written */
+
+#define DISASM_BENCH_ROUNDS	64
+
+static void usage(const char *name) {
+	fprintf(stderr, "usage: %s rom [address] [bench]\n", name);
+}
+
+int main(int argc, char **argv) {
+	struct timespec start, end;
+	uint8_t *memory, error;
+	size_t size, length, i;
+	uint16_t origin;
+	double seconds;
+	char *listing;
+
+	if(argc < 2 || (argc > 3 && strcmp(argv[3], "bench") != 0)) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	origin = argc > 2 ? strtoul(argv[2], NULL, 0) : 0;
+
+	memory = calloc(0x10000, 1);
+
+	if(memory == NULL)
+		exit(1);
+
+	error = loaderLoadBinary(argv[1], memory, 0x10000, origin);
+
+	if(error != loaderOk) {
+		fprintf(stderr, "%s: %s\n", argv[1], loaderErrorString(error));
+		return EXIT_FAILURE;
+	}
+
+	/* what was loaded, up to the last byte that isn't zero */
+	for(size = 0x10000 - origin; size != 0 && memory[origin + size - 1] == 0; size--)
+		;
+
+	listing = malloc(size * DISASSEMBLY_LINE_SIZE + 1);
+
+	if(listing == NULL)
+		exit(1);
+
+	if(argc <= 3) {
+		length = disassembleBlock(memory + origin, size, origin, listing);
+		fwrite(listing, 1, length, stdout);
+	}
+	else {
+		clock_gettime(CLOCK_MONOTONIC, &start);
+
+		for(i = 0, length = 0; i < DISASM_BENCH_ROUNDS; i++)
+			length += disassembleBlock(memory + origin, size, origin, listing);
+
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		seconds = end.tv_sec - start.tv_sec + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+		printf("%lu bytes to %lu bytes of listing in %.3fms, %.1f MB/s in\n", size, length / DISASM_BENCH_ROUNDS,
+				seconds * 1e3 / DISASM_BENCH_ROUNDS, size * DISASM_BENCH_ROUNDS / seconds / 1e6);
+	}
+
+	free(listing);
+	free(memory);
+
+	return EXIT_SUCCESS;
+}
+
+#endif /* #ifdef _CPU_TEST */
@@ -0,0 +1,280 @@
+#ifdef _CPU_TEST
+
+#include <string.h>
+#include <time.h>
+
+#include "cpu.h"
+#include "engine.h"
+#include "lockstep.h"
+#include "memory.h"
+#include "opcodes.h"
+
+/* in-process fuzz target for the instruction core. every input is turned
+ * into a register state, a memory image and an instruction stream at 0x0100
+ * which is then run on the reference interpreter and, in lockstep, on every
+ * other registered engine. every engine is also held to opcodes.def one
+ * instruction at a time: cycles, length and the flags left alone. any
+ * divergence or departure from the spec aborts so the fuzzer keeps the
+ * input.
+ *
+ * built with -DFUZZ_LIBFUZZER (and -fsanitize=fuzzer) this is a libFuzzer
+ * target, otherwise main() feeds it random inputs or replays files.
+ *
+ * input layout:
+ *	0-7	B C D E H L A and the status register
+ *	8-9	stack pointer
+ *	10-11	seed of the memory image
+ *	12-	instruction stream, at most FUZZ_MAX_STREAM bytes
+ */
+
+#define FUZZ_HEADER_SIZE	12
+#define FUZZ_MAX_STREAM		256
+#define FUZZ_MAX_STEPS		256
+#define FUZZ_ORIGIN		0x0100
+#define FUZZ_MEMORY_SIZE	0x10000
+
+/* persistent buffers, every input resets them instead of allocating */
+static uint8_t referenceMemory[FUZZ_MEMORY_SIZE];
+static uint8_t candidateMemory[FUZZ_MEMORY_SIZE];
+static uint8_t image[FUZZ_MEMORY_SIZE];
+static struct lockstep ls;
+
+static uint16_t portSeed;
+
+/* divergences abort unless they are only being collected, then each
+ * opcode is reported once */
+static bool collect = false;
+static bool divergenceSeen[256];
+static bool specSeen[256];
+
+static void fuzzPortOut(struct cpu8080 *cpu, uint8_t port, uint8_t data) {
+}
+
+static uint8_t fuzzPortIn(struct cpu8080 *cpu, uint8_t port) {
+	return port ^ portSeed ^ cpu->cycleCounter;
+}
+
+/* xorshift, the image only has to be cheap and reproducible */
+static void fuzzFillImage(uint16_t seed) {
+	uint32_t state;
+	size_t i;
+
+	state = seed | (uint32_t)seed << 16 | 1;
+
+	for(i = 0; i < FUZZ_MEMORY_SIZE; i += sizeof(state)) {
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+
+		memcpy(image + i, &state, sizeof(state));
+	}
+}
+
+static void fuzzResetCpu(struct cpu8080 *cpu, uint8_t *memory, const uint8_t *data) {
+	memcpy(memory, image, FUZZ_MEMORY_SIZE);
+
+	cpu->memory = memory;
+
+	cpu->readMemory = testReadMemory;
+	cpu->readMemoryWord = testReadMemoryWord;
+	cpu->writeMemory = testWriteMemory;
+	cpu->writeMemoryWord = testWriteMemoryWord;
+
+	cpu->portOut = fuzzPortOut;
+	cpu->portIn = fuzzPortIn;
+	cpu->ports = NULL;
+
+	memcpy(cpu->registers, data, totalR);
+	/* bit 1 of the status register always reads as 1, 3 and 5 as 0 */
+	cpu->registers[rSTATUS] = (cpu->registers[rSTATUS] & 0xD5) | 0x02;
+
+	cpu->stackPointer = data[8] | data[9] << 8;
+	cpu->programCounter = FUZZ_ORIGIN;
+	cpu->cycleCounter = 0;
+	cpu->signalBuffer = noSignal;
+
+	cpu->interruptEnable = false;
+	cpu->interruptDelay = false;
+	cpu->interruptPending = false;
+	cpu->halted = false;
+	cpu->debugger = NULL;
+	cpu->hooks = NULL;
+
+#ifdef CPU_COVERAGE
+	cpu->coverage = NULL;
+#endif
+
+#ifdef CPU_HEATMAP
+	cpu->heatmap = NULL;
+#endif
+}
+
+static void fuzzReportDivergence(void) {
+	uint8_t opcode;
+
+	opcode = image[ls.before.programCounter];
+
+	if(divergenceSeen[opcode])
+		return;
+
+	divergenceSeen[opcode] = true;
+	lockstepPrintDivergence(&ls);
+
+	if(!collect) {
+		fflush(stdout);
+		abort();
+	}
+}
+
+static void fuzzReportSpec(const struct cpuEngine *engine, const struct cpu8080 *before,
+		const struct cpu8080 *after) {
+	const struct opcodeInfo *info;
+	uint8_t opcode;
+
+	opcode = image[before->programCounter];
+	info = &opcodeTable[opcode];
+
+	if(specSeen[opcode])
+		return;
+
+	specSeen[opcode] = true;
+	printf("%s departs from the spec of %02X (%s, %d bytes, %d/%d cycles, flags %02X):\n", engine->name,
+			opcode, info->mnemonic, info->length, info->cycles, info->cyclesNotTaken, info->flags);
+	printf("\t");
+	printCpuState(*before);
+	printf("\t");
+	printCpuState(*after);
+
+	if(!collect) {
+		fflush(stdout);
+		abort();
+	}
+}
+
+/* runs the input on engine one instruction at a time and checks each one
+ * against opcodes.def */
+static void fuzzCheckSpec(const struct cpuEngine *engine, const uint8_t *data) {
+	const struct opcodeInfo *info;
+	struct cpu8080 cpu, before;
+	size_t i, cycles;
+	bool sequential;
+
+	fuzzResetCpu(&cpu, candidateMemory, data);
+
+	for(i = 0; i < FUZZ_MAX_STEPS && cpu.signalBuffer == noSignal && !cpu.halted; i++) {
+		before = cpu;
+		info = &opcodeTable[cpu.memory[cpu.programCounter]];
+
+		engine->step(&cpu);
+
+		cycles = cpu.cycleCounter - before.cycleCounter;
+		sequential = info->flow == opcodeSequential || info->flow == opcodeHalt;
+
+		if((cycles != info->cycles && cycles != info->cyclesNotTaken)
+				|| ((before.registers[rSTATUS] ^ cpu.registers[rSTATUS]) & ~info->flags & OPCODE_FLAGS_ALL)
+				|| (sequential && cpu.programCounter != (uint16_t)(before.programCounter + info->length)))
+			fuzzReportSpec(engine, &before, &cpu);
+	}
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+	const struct cpuEngine *candidate;
+	struct cpu8080 reference, other;
+	size_t i, streamSize;
+	uint8_t result;
+
+	if(size < FUZZ_HEADER_SIZE + 1)
+		return 0;
+
+	streamSize = size - FUZZ_HEADER_SIZE;
+	if(streamSize > FUZZ_MAX_STREAM)
+		streamSize = FUZZ_MAX_STREAM;
+
+	portSeed = data[10] | data[11] << 8;
+
+	fuzzFillImage(portSeed);
+	memcpy(image + FUZZ_ORIGIN, data + FUZZ_HEADER_SIZE, streamSize);
+
+	for(i = 0; (candidate = cpuEngineAt(i)) != NULL; i++)
+		fuzzCheckSpec(candidate, data);
+
+	for(i = 1; (candidate = cpuEngineAt(i)) != NULL; i++) {
+		fuzzResetCpu(&reference, referenceMemory, data);
+		fuzzResetCpu(&other, candidateMemory, data);
+
+		lockstepInit(&ls, &referenceEngine, &reference, candidate, &other);
+		ls.memorySize = FUZZ_MEMORY_SIZE;
+		ls.memoryCheckInterval = FUZZ_MAX_STEPS;
+
+		result = lockstepRun(&ls, FUZZ_MAX_STEPS);
+
+		lockstepDestroy(&ls);
+
+		if(result == lockstepDiverged
+				|| memcmp(referenceMemory, candidateMemory, FUZZ_MEMORY_SIZE) != 0)
+			fuzzReportDivergence();
+	}
+
+	return 0;
+}
+
+#ifndef FUZZ_LIBFUZZER
+
+static void fuzzReplay(const char *path) {
+	uint8_t data[FUZZ_HEADER_SIZE + FUZZ_MAX_STREAM];
+	size_t size;
+	FILE *file;
+
+	file = fopen(path, "rb");
+
+	if(file == NULL) {
+		perror(path);
+		return;
+	}
+
+	size = fread(data, 1, sizeof(data), file);
+	fclose(file);
+
+	LLVMFuzzerTestOneInput(data, size);
+}
+
+/* with -n random inputs are generated and every diverging or off spec
+ * opcode is listed once, otherwise the files given are replayed */
+int main(int argc, char **argv) {
+	uint8_t data[FUZZ_HEADER_SIZE + FUZZ_MAX_STREAM];
+	unsigned long iterations, i;
+	size_t j;
+	int k;
+
+	if(argc < 2) {
+		fprintf(stderr, "usage: %s -n [iterations] | input...\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if(strcmp(argv[1], "-n") != 0) {
+		for(k = 1; k < argc; k++)
+			fuzzReplay(argv[k]);
+
+		return EXIT_SUCCESS;
+	}
+
+	iterations = argc > 2 ? strtoul(argv[2], NULL, 0) : 100000;
+
+	collect = true;
+	srand(time(NULL));
+
+	for(i = 0; i < iterations; i++) {
+		for(j = 0; j < sizeof(data); j++)
+			data[j] = rand();
+
+		LLVMFuzzerTestOneInput(data, sizeof(data));
+	}
+
+	printf("%lu inputs done\n", iterations);
+
+	return EXIT_SUCCESS;
+}
+
+#endif /* #ifndef FUZZ_LIBFUZZER */
+
+#endif /* #ifdef _CPU_TEST */
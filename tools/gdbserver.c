@@ -0,0 +1,144 @@
+#ifdef _CPU_TEST
+
+#include <string.h>
+#include <unistd.h>
+
+#include "cpu.h"
+#include "engine.h"
+#include "gdb_stub.h"
+#include "guest_memory.h"
+#include "loader.h"
+#include "ports.h"
+#include "serial.h"
+
+/* runs a rom like i8080-terminal, with a gdb stub on a local tcp port:
+ *
+ *	gdb -ex "set architecture z80" -ex "target remote localhost:1234"
+ *
+ * the cpu runs flat out until gdb connects, or waits for it at the entry
+ * point when asked to. gdb only knows AF, BC, DE, HL, SP and PC of its
+ * z80 target, the rest reads as unavailable */
+
+#define GDBSERVER_DEFAULT_ADDRESS	"1234"
+/* how long a halted cpu sleeps before it checks for input again */
+#define GDBSERVER_HALT_US		1000
+
+struct gdbServerMachine {
+	struct serialDevice	serial;
+	struct portTable	ports;
+};
+
+static void service(struct cpu8080 *cpu, void *context) {
+	struct gdbServerMachine *machine;
+
+	machine = context;
+
+	serialPoll(&machine->serial, cpu);
+
+	if(cpu->halted && !cpu->interruptPending) {
+		portTableFlush(&machine->ports);
+
+		if(cpu->interruptEnable)
+			usleep(GDBSERVER_HALT_US);
+	}
+}
+
+static void usage(const char *name) {
+	fprintf(stderr, "usage: %s rom [address] [listen] [engine] [wait]\n", name);
+	fprintf(stderr, "listen is [host:]port, default %s. with wait the cpu doesn't start before gdb\n"
+			"connects\n", GDBSERVER_DEFAULT_ADDRESS);
+	fprintf(stderr, "engines:\n");
+	cpuListEngines(stderr);
+}
+
+int main(int argc, char **argv) {
+	const struct cpuEngine *engine;
+	struct gdbServerMachine machine;
+	struct guestMemory *memory;
+	struct gdbStub *stub;
+	struct cpu8080 cpu;
+	const char *address;
+	uint16_t entry;
+	uint8_t error;
+
+	if(argc < 2) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	entry = argc > 2 ? strtoul(argv[2], NULL, 0) : 0;
+	address = argc > 3 ? argv[3] : GDBSERVER_DEFAULT_ADDRESS;
+	engine = cpuFindEngine(argc > 4 ? argv[4] : "turbo");
+
+	if(engine == NULL || (argc > 5 && strcmp(argv[5], "wait") != 0)) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	memory = guestMemoryCreate();
+	stub = malloc(sizeof(*stub));
+
+	if(memory == NULL || stub == NULL)
+		exit(1);
+
+	error = loaderLoad(argv[1], memory->base, GUEST_MEMORY_SIZE, entry);
+
+	if(error != loaderOk) {
+		fprintf(stderr, "%s: %s\n", argv[1], loaderErrorString(error));
+		return EXIT_FAILURE;
+	}
+
+	if(!serialOpenPty(&machine.serial, SERIAL_VECTOR)) {
+		perror("pseudo-terminal");
+		return EXIT_FAILURE;
+	}
+
+	portTableInit(&machine.ports, NULL);
+	serialMap(&machine.serial, &machine.ports, SERIAL_STATUS_PORT, SERIAL_DATA_PORT);
+
+	memset(&cpu, 0, sizeof(cpu));
+
+	cpu.memory = memory->base;
+	cpu.readMemory = guestReadMemory;
+	cpu.readMemoryWord = guestReadMemoryWord;
+	cpu.writeMemory = guestWriteMemory;
+	cpu.writeMemoryWord = guestWriteMemoryWord;
+
+	cpu.ports = &machine.ports;
+	cpu.portOut = portTableOut;
+	cpu.portIn = portTableIn;
+
+	cpu.programCounter = entry;
+	cpu.registers[rSTATUS] = 1 << 1;
+	cpu.signalBuffer = noSignal;
+
+	gdbStubInit(stub, &cpu, engine, service, &machine);
+
+	if(!gdbStubListen(stub, address)) {
+		perror(address);
+		return EXIT_FAILURE;
+	}
+
+	printf("serial port on %s, gdb stub on %s\n", machine.serial.name, address);
+	fflush(stdout);
+
+	if(argc > 5 && !gdbStubWait(stub)) {
+		perror("accept");
+		return EXIT_FAILURE;
+	}
+
+	gdbStubRun(stub);
+
+	portTableFlush(&machine.ports);
+	serialClose(&machine.serial);
+
+	printf("cpu stopped at %04X\n", cpu.programCounter);
+
+	gdbStubDestroy(stub);
+	free(stub);
+	guestMemoryDestroy(memory);
+
+	return EXIT_SUCCESS;
+}
+
+#endif /* #ifdef _CPU_TEST */
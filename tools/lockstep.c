@@ -0,0 +1,95 @@
+#ifdef _CPU_TEST
+
+#include <string.h>
+
+#include "cpu.h"
+#include "engine.h"
+#include "lockstep.h"
+#include "test_machine.h"
+#include "loader.h"
+
+/* runs a test rom on two engines at once and stops at the first instruction
+ * (or block) where they don't agree */
+
+static void usage(const char *name) {
+	fprintf(stderr, "usage: %s rom [reference engine] [candidate engine] [block cycles]\n", name);
+	fprintf(stderr, "engines:\n");
+	cpuListEngines(stderr);
+}
+
+int main(int argc, char **argv) {
+	const struct cpuEngine *reference, *candidate;
+	struct testMachine referenceMachine, candidateMachine;
+	struct console referenceConsole, candidateConsole;
+	struct lockstep *ls;
+	struct guestMemory *referenceMemory, *candidateMemory;
+	uint8_t result, error;
+
+	if(argc < 2) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	reference = cpuFindEngine(argc > 2 ? argv[2] : "reference");
+	candidate = cpuFindEngine(argc > 3 ? argv[3] : "reference");
+
+	if(reference == NULL || candidate == NULL) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	referenceMemory = guestMemoryCreate();
+	candidateMemory = guestMemoryCreate();
+	ls = malloc(sizeof(*ls));
+
+	if(referenceMemory == NULL || candidateMemory == NULL || ls == NULL
+			|| !consoleInitStream(&referenceConsole, stdout)
+			|| !consoleInitCapture(&candidateConsole))
+		exit(1);
+
+	/* only the reference's output reaches the host */
+	error = testMachineInit(&referenceMachine, referenceMemory, argv[1], &referenceConsole);
+
+	if(error == loaderOk)
+		error = testMachineInit(&candidateMachine, candidateMemory, argv[1], &candidateConsole);
+
+	if(error != loaderOk) {
+		fprintf(stderr, "%s: %s\n", argv[1], loaderErrorString(error));
+		return EXIT_FAILURE;
+	}
+
+	lockstepInit(ls, reference, &referenceMachine.cpu, candidate, &candidateMachine.cpu);
+
+	ls->memorySize = TEST_MEMORY_SIZE;
+	ls->memoryCheckInterval = 1 << 20;
+
+	if(argc > 4)
+		ls->blockCycles = strtoul(argv[4], NULL, 0);
+
+	result = lockstepRun(ls, 0);
+
+	consoleFlush(&referenceConsole);
+
+	if(result == lockstepDiverged) {
+		printf("\n");
+		lockstepPrintDivergence(ls);
+	}
+	else
+		printf("\n%s and %s agree after %lu comparisons\n",
+				reference->name, candidate->name, ls->comparisons);
+
+	lockstepDestroy(ls);
+
+	testMachineFinish(&candidateMachine);
+	testMachineFinish(&referenceMachine);
+	consoleDestroy(&candidateConsole);
+	consoleDestroy(&referenceConsole);
+
+	free(ls);
+	guestMemoryDestroy(candidateMemory);
+	guestMemoryDestroy(referenceMemory);
+
+	return result == lockstepDiverged ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#endif /* #ifdef _CPU_TEST */
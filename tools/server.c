@@ -0,0 +1,112 @@
+#ifdef _CPU_TEST
+
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "engine.h"
+#include "loader.h"
+#include "server.h"
+
+/* serves a rom to every connection on a local socket, each one gets its own
+ * machine with the serial port on the 88-2sio ports. runs until SIGINT or
+ * SIGTERM */
+
+#define SERVER_DEFAULT_ADDRESS	"8080"
+#define SERVER_DEFAULT_SESSIONS	1024
+
+static void usage(const char *name) {
+	fprintf(stderr, "usage: %s rom [address] [listen] [workers] [sessions] [engine]\n", name);
+	fprintf(stderr, "listen is [host:]port or the path of a unix socket, default %s\n",
+			SERVER_DEFAULT_ADDRESS);
+	fprintf(stderr, "engines:\n");
+	cpuListEngines(stderr);
+}
+
+/* every session holds a socket and a memfd */
+static void raiseFileLimit(void) {
+	struct rlimit limit;
+
+	if(getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+	}
+}
+
+int main(int argc, char **argv) {
+	const struct cpuEngine *engine;
+	const char *address;
+	struct server *server;
+	size_t nWorkers, maxSessions;
+	uint16_t entry;
+	sigset_t signals;
+	uint8_t error;
+	int signal;
+
+	if(argc < 2) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	entry = argc > 2 ? strtoul(argv[2], NULL, 0) : 0;
+	address = argc > 3 ? argv[3] : SERVER_DEFAULT_ADDRESS;
+	nWorkers = argc > 4 ? strtoul(argv[4], NULL, 0) : sysconf(_SC_NPROCESSORS_ONLN);
+	maxSessions = argc > 5 ? strtoul(argv[5], NULL, 0) : SERVER_DEFAULT_SESSIONS;
+	engine = cpuFindEngine(argc > 6 ? argv[6] : "reference");
+
+	if(engine == NULL) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if(nWorkers > SERVER_MAX_WORKERS)
+		nWorkers = SERVER_MAX_WORKERS;
+
+	raiseFileLimit();
+
+	/* every thread inherits the mask, only sigwait sees them */
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+	server = malloc(sizeof(*server));
+
+	if(server == NULL)
+		exit(1);
+
+	if(!serverInit(server, argv[1], entry, maxSessions, engine, &error)) {
+		fprintf(stderr, "%s: %s\n", argv[1], error != loaderOk ? loaderErrorString(error)
+				: "can't set up the sessions");
+		return EXIT_FAILURE;
+	}
+
+	if(!serverListen(server, address)) {
+		perror(address);
+		serverDestroy(server);
+		return EXIT_FAILURE;
+	}
+
+	if(!serverStart(server, nWorkers)) {
+		fprintf(stderr, "can't start %lu workers\n", nWorkers);
+		serverDestroy(server);
+		return EXIT_FAILURE;
+	}
+
+	printf("serving %s on %s, %lu workers, at most %lu sessions\n", argv[1], address, nWorkers,
+			maxSessions);
+	fflush(stdout);
+
+	sigwait(&signals, &signal);
+
+	printf("stopping with %lu sessions\n", atomic_load(&server->sessions));
+
+	serverStop(server);
+	serverDestroy(server);
+	free(server);
+
+	return EXIT_SUCCESS;
+}
+
+#endif /* #ifdef _CPU_TEST */
@@ -0,0 +1,147 @@
+#ifdef _CPU_TEST
+
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cpu.h"
+#include "engine.h"
+#include "guest_memory.h"
+#include "loader.h"
+#include "pacer.h"
+#include "ports.h"
+#include "serial.h"
+
+/* runs a rom with a serial port on a pseudo-terminal, connect to it with
+ * any terminal program (screen, picocom, minicom). the rom is loaded at
+ * address 0 unless given, the serial port sits where an altair 88-2sio has
+ * its first channel and interrupts with RST 7. with a clock rate (2M,
+ * 3.125MHz, 1000000) the cpu runs in real time, otherwise flat out.
+ * SIGUSR1 moves the running cpu to the reference engine, SIGUSR2 to the
+ * turbo engine */
+
+/* cycles between looks at the serial port, 1ms at 2MHz */
+#define TERMINAL_SLICE		2000
+/* how long a halted cpu sleeps before it checks for input again */
+#define TERMINAL_HALT_US	1000
+
+static struct engineSwitch engineSwitch;
+
+static void switchEngine(int signal) {
+	engineSwitchRequest(&engineSwitch, signal == SIGUSR1 ? &referenceEngine : &turboEngine, 0);
+}
+
+static void usage(const char *name) {
+	fprintf(stderr, "usage: %s rom [address] [engine] [clock rate]\n", name);
+	fprintf(stderr, "engines:\n");
+	cpuListEngines(stderr);
+}
+
+int main(int argc, char **argv) {
+	const struct cpuEngine *engine;
+	struct guestMemory *memory;
+	struct serialDevice serial;
+	struct portTable ports;
+	struct cpu8080 cpu;
+	struct pacer pacer;
+	uint64_t hz;
+	uint16_t address;
+	uint8_t error;
+
+	if(argc < 2) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	address = argc > 2 ? strtoul(argv[2], NULL, 0) : 0;
+	engine = cpuFindEngine(argc > 3 ? argv[3] : "reference");
+	hz = argc > 4 ? pacerParseRate(argv[4]) : 0;
+
+	if(engine == NULL || (argc > 4 && hz == 0)) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	memory = guestMemoryCreate();
+
+	if(memory == NULL)
+		exit(1);
+
+	error = loaderLoad(argv[1], memory->base, GUEST_MEMORY_SIZE, address);
+
+	if(error != loaderOk) {
+		fprintf(stderr, "%s: %s\n", argv[1], loaderErrorString(error));
+		return EXIT_FAILURE;
+	}
+
+	if(!serialOpenPty(&serial, SERIAL_VECTOR)) {
+		perror("pseudo-terminal");
+		return EXIT_FAILURE;
+	}
+
+	portTableInit(&ports, NULL);
+	serialMap(&serial, &ports, SERIAL_STATUS_PORT, SERIAL_DATA_PORT);
+
+	memset(&cpu, 0, sizeof(cpu));
+
+	cpu.memory = memory->base;
+	cpu.readMemory = guestReadMemory;
+	cpu.readMemoryWord = guestReadMemoryWord;
+	cpu.writeMemory = guestWriteMemory;
+	cpu.writeMemoryWord = guestWriteMemoryWord;
+
+	cpu.ports = &ports;
+	cpu.portOut = portTableOut;
+	cpu.portIn = portTableIn;
+
+	cpu.programCounter = address;
+	cpu.registers[rSTATUS] = 1 << 1;
+	cpu.signalBuffer = noSignal;
+
+	printf("serial port on %s\n", serial.name);
+	fflush(stdout);
+
+	if(hz != 0)
+		pacerInit(&pacer, hz, 0, cpu.cycleCounter);
+
+	engineSwitchInit(&engineSwitch, engine);
+	signal(SIGUSR1, switchEngine);
+	signal(SIGUSR2, switchEngine);
+
+	while(cpu.signalBuffer == noSignal) {
+		engineSwitchRun(&engineSwitch, &cpu, hz != 0 ? pacer.quantum : TERMINAL_SLICE);
+
+		serialPoll(&serial, &cpu);
+
+		/* nothing can wake it but the serial port. a batch of output
+		 * isn't closed by a halted cpu, so it's delivered here */
+		if(cpu.halted && !cpu.interruptPending) {
+			portTableFlush(&ports);
+
+			if(!cpu.interruptEnable)
+				break;
+
+			/* a paced cpu is slept by the pacer */
+			if(hz == 0)
+				usleep(TERMINAL_HALT_US);
+		}
+
+		if(hz != 0)
+			pacerWait(&pacer, cpu.cycleCounter);
+	}
+
+	portTableFlush(&ports);
+	serialClose(&serial);
+
+	printf("cpu halted at %04X\n", cpu.programCounter);
+
+	if(hz != 0)
+		printf("%lu quanta, %lu late by up to %luus, %luus dropped\n", pacer.waits, pacer.late,
+				pacer.maxLateness / 1000, pacer.dropped / 1000);
+
+	guestMemoryDestroy(memory);
+
+	return EXIT_SUCCESS;
+}
+
+#endif /* #ifdef _CPU_TEST */